@@ -8,7 +8,7 @@ Application::Application(HINSTANCE hInstance, const wchar_t* applicationName, co
                          const uint32_t clientHeight, uint8_t numFrames, bool useWarp, bool vSync)
 {
     Window::CreateInstance(hInstance, applicationName, clientWidth, clientHeight);
-    m_graphics = make_shared<Graphics>(useWarp, vSync, numFrames);
+    m_graphics = make_shared<D3D12Graphics>(useWarp, vSync, numFrames);
 }
 
 Application::~Application()
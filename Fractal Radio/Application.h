@@ -1,7 +1,7 @@
 #pragma once
 
 #include "Window.h"
-#include "Graphics.h"
+#include "D3D12Graphics.h"
 
 #include <memory>
 
@@ -17,7 +17,7 @@ public:
 
 private:
 
-    std::shared_ptr<Graphics> m_graphics{};
+    std::shared_ptr<D3D12Graphics> m_graphics{};
 };
 
 template <class T>
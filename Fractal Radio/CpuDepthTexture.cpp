@@ -0,0 +1,45 @@
+#include "pch.h"
+
+#include "CpuDepthTexture.h"
+
+#include <algorithm>
+
+using namespace std;
+
+CpuDepthTexture::CpuDepthTexture() :
+    m_width(0),
+    m_height(0)
+{
+}
+
+void CpuDepthTexture::Resize(const uint32_t width, const uint32_t height)
+{
+    m_width = width;
+    m_height = height;
+    m_pixels.assign(GetTiledSize(width, height), Float2{ 0.0f, 0.0f });
+}
+
+void CpuDepthTexture::Clear()
+{
+    fill(m_pixels.begin(), m_pixels.end(), Float2{ 0.0f, 0.0f });
+}
+
+void CpuDepthTexture::Store(const uint32_t x, const uint32_t y, const Float2& value)
+{
+    m_pixels[GetTiledIndex(x, y, m_width)] = value;
+}
+
+Float2 CpuDepthTexture::Load(const uint32_t x, const uint32_t y) const
+{
+    return m_pixels[GetTiledIndex(x, y, m_width)];
+}
+
+uint32_t CpuDepthTexture::GetWidth() const
+{
+    return m_width;
+}
+
+uint32_t CpuDepthTexture::GetHeight() const
+{
+    return m_height;
+}
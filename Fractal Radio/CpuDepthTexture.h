@@ -0,0 +1,31 @@
+#pragma once
+
+#include <cstdint>
+#include <vector>
+
+#include "CpuMath.h"
+
+// In-memory counterpart of the DXGI_FORMAT_R32G32_FLOAT depth textures of the ray marcher: for each pixel the distance
+// from the eye to the primary hit, zero for rays that hit nothing, and the step count its ambient occlusion uses.
+// The texels are stored tiled, see GetTiledIndex.
+class CpuDepthTexture
+{
+public:
+
+    CpuDepthTexture();
+
+    void                       Resize(uint32_t, uint32_t);
+    void                       Clear();
+
+    void                       Store(uint32_t, uint32_t, const Float2&);
+    Float2                     Load(uint32_t, uint32_t)                         const;
+
+    uint32_t                   GetWidth()                                       const;
+    uint32_t                   GetHeight()                                      const;
+
+private:
+
+    uint32_t            m_width;
+    uint32_t            m_height;
+    std::vector<Float2> m_pixels;
+};
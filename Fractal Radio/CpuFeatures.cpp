@@ -0,0 +1,84 @@
+#include "pch.h"
+
+#include "CpuFeatures.h"
+
+#if defined(_M_X64) || defined(_M_IX86) || defined(__x86_64__) || defined(__i386__)
+#define FRACTAL_RADIO_X86
+#if defined(_MSC_VER)
+#include <intrin.h>
+#else
+#include <cpuid.h>
+#endif
+#endif
+
+#if defined(FRACTAL_RADIO_X86)
+
+static void Cpuid(const int leaf, const int subleaf, unsigned int registers[4])
+{
+#if defined(_MSC_VER)
+    int values[4];
+    __cpuidex(values, leaf, subleaf);
+    for (int i = 0; i < 4; i++)
+        registers[i] = static_cast<unsigned int>(values[i]);
+#else
+    __cpuid_count(leaf, subleaf, registers[0], registers[1], registers[2], registers[3]);
+#endif
+}
+
+static unsigned long long ReadXcr0()
+{
+#if defined(_MSC_VER)
+    return _xgetbv(0);
+#else
+    unsigned int eax;
+    unsigned int edx;
+    __asm__ volatile("xgetbv" : "=a"(eax), "=d"(edx) : "c"(0));
+    return (static_cast<unsigned long long>(edx) << 32) | eax;
+#endif
+}
+
+static CpuFeatures DetectFeatures()
+{
+    CpuFeatures features{};
+
+    unsigned int registers[4];
+    Cpuid(0, 0, registers);
+    const unsigned int maxLeaf = registers[0];
+
+    Cpuid(1, 0, registers);
+    const unsigned int ecx1 = registers[2];
+    features.Sse41 = (ecx1 & (1u << 19)) != 0;
+
+    const bool osxsave = (ecx1 & (1u << 27)) != 0;
+    const bool avx = (ecx1 & (1u << 28)) != 0;
+    const bool fma = (ecx1 & (1u << 12)) != 0;
+    if (!osxsave || !avx || maxLeaf < 7)
+        return features;
+
+    // The OS must save the YMM (and for AVX-512 the opmask and ZMM) state on context switches.
+    const unsigned long long xcr0 = ReadXcr0();
+    const bool ymmState = (xcr0 & 0x6) == 0x6;
+    const bool zmmState = (xcr0 & 0xE6) == 0xE6;
+
+    Cpuid(7, 0, registers);
+    const unsigned int ebx7 = registers[1];
+    features.Avx2 = ymmState && fma && (ebx7 & (1u << 5)) != 0;
+    features.Avx512 = features.Avx2 && zmmState && (ebx7 & (1u << 16)) != 0;
+
+    return features;
+}
+
+#else
+
+static CpuFeatures DetectFeatures()
+{
+    return CpuFeatures{};
+}
+
+#endif
+
+const CpuFeatures& CpuFeatures::Get()
+{
+    static const CpuFeatures features = DetectFeatures();
+    return features;
+}
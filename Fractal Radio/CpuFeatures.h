@@ -0,0 +1,12 @@
+#pragma once
+
+// Instruction set extensions of the host CPU that the march kernels can use, as reported by cpuid and enabled by the
+// operating system (xgetbv).
+struct CpuFeatures
+{
+    bool Sse41;
+    bool Avx2;
+    bool Avx512;
+
+    static const CpuFeatures& Get();
+};
@@ -0,0 +1,45 @@
+#include "pch.h"
+
+#include "CpuFloat4Texture.h"
+
+#include <algorithm>
+
+using namespace std;
+
+CpuFloat4Texture::CpuFloat4Texture() :
+    m_width(0),
+    m_height(0)
+{
+}
+
+void CpuFloat4Texture::Resize(const uint32_t width, const uint32_t height)
+{
+    m_width = width;
+    m_height = height;
+    m_pixels.assign(GetTiledSize(width, height), Float4{ 0.0f, 0.0f, 0.0f, 0.0f });
+}
+
+void CpuFloat4Texture::Clear()
+{
+    fill(m_pixels.begin(), m_pixels.end(), Float4{ 0.0f, 0.0f, 0.0f, 0.0f });
+}
+
+void CpuFloat4Texture::Store(const uint32_t x, const uint32_t y, const Float4& value)
+{
+    m_pixels[GetTiledIndex(x, y, m_width)] = value;
+}
+
+Float4 CpuFloat4Texture::Load(const uint32_t x, const uint32_t y) const
+{
+    return m_pixels[GetTiledIndex(x, y, m_width)];
+}
+
+uint32_t CpuFloat4Texture::GetWidth() const
+{
+    return m_width;
+}
+
+uint32_t CpuFloat4Texture::GetHeight() const
+{
+    return m_height;
+}
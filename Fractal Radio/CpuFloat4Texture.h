@@ -0,0 +1,31 @@
+#pragma once
+
+#include <cstdint>
+#include <vector>
+
+#include "CpuMath.h"
+
+// In-memory counterpart of the DXGI_FORMAT_R32G32B32A32_FLOAT textures of the ray marcher: the accumulation texture,
+// holding for each pixel the sum of the colors of the jittered samples taken since the view last changed, and the two
+// halves of the half resolution G-buffer. The texels are stored tiled, see GetTiledIndex.
+class CpuFloat4Texture
+{
+public:
+
+    CpuFloat4Texture();
+
+    void                       Resize(uint32_t, uint32_t);
+    void                       Clear();
+
+    void                       Store(uint32_t, uint32_t, const Float4&);
+    Float4                     Load(uint32_t, uint32_t)                         const;
+
+    uint32_t                   GetWidth()                                       const;
+    uint32_t                   GetHeight()                                      const;
+
+private:
+
+    uint32_t            m_width;
+    uint32_t            m_height;
+    std::vector<Float4> m_pixels;
+};
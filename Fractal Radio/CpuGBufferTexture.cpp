@@ -0,0 +1,45 @@
+#include "pch.h"
+
+#include "CpuGBufferTexture.h"
+
+#include <algorithm>
+
+using namespace std;
+
+CpuGBufferTexture::CpuGBufferTexture() :
+    m_width(0),
+    m_height(0)
+{
+}
+
+void CpuGBufferTexture::Resize(const uint32_t width, const uint32_t height)
+{
+    m_width = width;
+    m_height = height;
+    m_pixels.assign(GetTiledSize(width, height), Uint2{ 0, 0 });
+}
+
+void CpuGBufferTexture::Clear()
+{
+    fill(m_pixels.begin(), m_pixels.end(), Uint2{ 0, 0 });
+}
+
+void CpuGBufferTexture::Store(const uint32_t x, const uint32_t y, const Uint2& value)
+{
+    m_pixels[GetTiledIndex(x, y, m_width)] = value;
+}
+
+Uint2 CpuGBufferTexture::Load(const uint32_t x, const uint32_t y) const
+{
+    return m_pixels[GetTiledIndex(x, y, m_width)];
+}
+
+uint32_t CpuGBufferTexture::GetWidth() const
+{
+    return m_width;
+}
+
+uint32_t CpuGBufferTexture::GetHeight() const
+{
+    return m_height;
+}
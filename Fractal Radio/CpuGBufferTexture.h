@@ -0,0 +1,30 @@
+#pragma once
+
+#include <cstdint>
+#include <vector>
+
+#include "CpuMath.h"
+
+// In-memory counterpart of the DXGI_FORMAT_R32G32_UINT G-buffer of the deferred march: for each pixel the primary hit
+// packed by CpuRayMarcher::PackGBuffer. The texels are stored tiled, see GetTiledIndex.
+class CpuGBufferTexture
+{
+public:
+
+    CpuGBufferTexture();
+
+    void                       Resize(uint32_t, uint32_t);
+    void                       Clear();
+
+    void                       Store(uint32_t, uint32_t, const Uint2&);
+    Uint2                      Load(uint32_t, uint32_t)                         const;
+
+    uint32_t                   GetWidth()                                       const;
+    uint32_t                   GetHeight()                                      const;
+
+private:
+
+    uint32_t            m_width;
+    uint32_t            m_height;
+    std::vector<Uint2>  m_pixels;
+};
@@ -0,0 +1,100 @@
+#include "pch.h"
+
+#include "CpuGraphics.h"
+
+using namespace std;
+
+CpuGraphics::CpuGraphics(const uint32_t clientWidth, const uint32_t clientHeight, const uint8_t numFrames,
+                         const uint32_t numThreads) :
+    m_clientWidth(clientWidth),
+    m_clientHeight(clientHeight),
+    m_numFrames(max<uint32_t>(1, numFrames)),
+    m_isInitialized(false),
+    m_currentBackBufferIndex(0),
+    m_presentedBackBufferIndex(0),
+    m_presentedFrames(0),
+    m_marchKernels(CpuMarchKernels::GetBest())
+{
+    m_taskScheduler = make_shared<TaskScheduler>(numThreads);
+
+    m_backBuffers.resize(m_numFrames);
+    Resize(clientWidth, clientHeight);
+
+    m_isInitialized = true;
+}
+
+// Nothing is displayed, so there is no refresh to wait for.
+void CpuGraphics::ToggleVSync()
+{
+}
+
+void CpuGraphics::Resize(const uint32_t width, const uint32_t height)
+{
+    m_clientWidth = max(1u, width);
+    m_clientHeight = max(1u, height);
+
+    for (auto& backBuffer : m_backBuffers)
+        backBuffer.Resize(m_clientWidth, m_clientHeight, false);
+}
+
+// The frames are rendered synchronously, so none is ever in flight.
+void CpuGraphics::Flush()
+{
+}
+
+CpuTexture& CpuGraphics::BeginFrame()
+{
+    return m_backBuffers[m_currentBackBufferIndex];
+}
+
+void CpuGraphics::ClearRenderTarget(const float* clearColor)
+{
+    m_backBuffers[m_currentBackBufferIndex].Clear(clearColor);
+}
+
+void CpuGraphics::EndFrame()
+{
+    m_presentedBackBufferIndex = m_currentBackBufferIndex;
+    m_currentBackBufferIndex = (m_currentBackBufferIndex + 1) % m_numFrames;
+    m_presentedFrames++;
+}
+
+bool CpuGraphics::IsInitialized() const
+{
+    return m_isInitialized;
+}
+
+uint32_t CpuGraphics::GetClientWidth() const
+{
+    return m_clientWidth;
+}
+
+uint32_t CpuGraphics::GetClientHeight() const
+{
+    return m_clientHeight;
+}
+
+uint64_t CpuGraphics::GetPresentedFrames() const
+{
+    return m_presentedFrames;
+}
+
+const CpuTexture& CpuGraphics::GetPresentedBuffer() const
+{
+    return m_backBuffers[m_presentedBackBufferIndex];
+}
+
+shared_ptr<TaskScheduler> CpuGraphics::GetTaskScheduler() const
+{
+    return m_taskScheduler;
+}
+
+void CpuGraphics::SetMarchKernels(const CpuMarchKernels* marchKernels)
+{
+    m_marchKernels = marchKernels;
+}
+
+const CpuMarchKernels* CpuGraphics::GetMarchKernels() const
+{
+    return m_marchKernels;
+}
@@ -0,0 +1,52 @@
+#pragma once
+
+#include <cstdint>
+#include <vector>
+
+#include "CpuMarchKernels.h"
+#include "CpuTexture.h"
+#include "Graphics.h"
+#include "TaskScheduler.h"
+
+// Graphics for the headless build: a swap chain of in-memory back buffers instead of a D3D12 device.
+class CpuGraphics final : public Graphics
+{
+public:
+
+    CpuGraphics(uint32_t, uint32_t, uint8_t, uint32_t);
+
+    void                           ToggleVSync()                        override;
+    void                           Resize(uint32_t, uint32_t)           override;
+    void                           Flush()                              override;
+
+    CpuTexture&                    BeginFrame();
+    void                           ClearRenderTarget(const float*);
+    void                           EndFrame();
+
+    bool                           IsInitialized()                      const override;
+
+    uint32_t                       GetClientWidth()                     const override;
+    uint32_t                       GetClientHeight()                    const override;
+    uint64_t                       GetPresentedFrames()                 const;
+    const CpuTexture&              GetPresentedBuffer()                 const;
+
+    std::shared_ptr<TaskScheduler> GetTaskScheduler()                   const;
+
+    void                           SetMarchKernels(const CpuMarchKernels*);
+    const CpuMarchKernels*         GetMarchKernels()                    const;
+
+private:
+
+    uint32_t                       m_clientWidth;
+    uint32_t                       m_clientHeight;
+    uint32_t                       m_numFrames;
+    bool                           m_isInitialized;
+
+    std::vector<CpuTexture>        m_backBuffers;
+    uint32_t                       m_currentBackBufferIndex;
+    uint32_t                       m_presentedBackBufferIndex;
+    uint64_t                       m_presentedFrames;
+
+    std::shared_ptr<TaskScheduler> m_taskScheduler;
+    const CpuMarchKernels*         m_marchKernels;
+};
@@ -0,0 +1,55 @@
+#include "pch.h"
+
+#include "CpuMarchKernels.h"
+
+#include <cstring>
+
+#include "CpuFeatures.h"
+
+#if defined(_M_X64) || defined(_M_IX86) || defined(__x86_64__) || defined(__i386__)
+#define FRACTAL_RADIO_X86
+#endif
+
+using namespace std;
+
+static vector<CpuMarchKernels> DetectKernels()
+{
+    vector<CpuMarchKernels> kernels =
+    {
+        { "scalar", 1, &CpuRayMarcher::RenderTile, &CpuRayMarcher::EvaluateDistances }
+    };
+
+#if defined(FRACTAL_RADIO_X86)
+    const auto& features = CpuFeatures::Get();
+
+    if (features.Sse41)
+        kernels.push_back(CpuMarchKernels::GetSse41Kernels());
+    if (features.Avx2)
+        kernels.push_back(CpuMarchKernels::GetAvx2Kernels());
+    if (features.Avx512)
+        kernels.push_back(CpuMarchKernels::GetAvx512Kernels());
+#endif
+
+    return kernels;
+}
+
+// The kernel builds supported by the host CPU, ordered from the narrowest to the widest.
+const vector<CpuMarchKernels>& CpuMarchKernels::GetAvailable()
+{
+    static const vector<CpuMarchKernels> kernels = DetectKernels();
+    return kernels;
+}
+
+const CpuMarchKernels* CpuMarchKernels::Find(const char* name)
+{
+    for (const auto& kernels : GetAvailable())
+        if (!strcmp(kernels.Name, name))
+            return &kernels;
+
+    return nullptr;
+}
+
+const CpuMarchKernels* CpuMarchKernels::GetBest()
+{
+    return &GetAvailable().back();
+}
@@ -0,0 +1,26 @@
+#pragma once
+
+#include <cstdint>
+#include <vector>
+
+#include "CpuRayMarcher.h"
+
+// Entry points of one build of the march kernels: the scalar CpuRayMarcher code or a CpuPacketMarcher instantiation.
+// Each SIMD build lives in its own translation unit compiled for that instruction set (CpuMarchKernelsSse41.cpp,
+// CpuMarchKernelsAvx2.cpp, CpuMarchKernelsAvx512.cpp) and is only offered when CpuFeatures reports support for it.
+struct CpuMarchKernels
+{
+    const char* Name;
+    uint32_t    Width;
+    void        (*RenderTile)(uint32_t, uint32_t, const RayMarcherBuffer&,
+                              const CpuRayMarcher::RenderTargets&, CpuRayMarcher::Statistics&);
+    void        (*EvaluateDistances)(const float*, const float*, const float*, float*, uint32_t);
+
+    static const std::vector<CpuMarchKernels>& GetAvailable();
+    static const CpuMarchKernels*              Find(const char*);
+    static const CpuMarchKernels*              GetBest();
+
+    static CpuMarchKernels                     GetSse41Kernels();
+    static CpuMarchKernels                     GetAvx2Kernels();
+    static CpuMarchKernels                     GetAvx512Kernels();
+};
@@ -0,0 +1,33 @@
+// Compiled for AVX-512 independently of the project-wide instruction set; CpuMarchKernels only calls into this file when
+// CpuFeatures reports support. Nothing outside the Avx512-specific templates may be defined here, otherwise the linker
+// could pick AVX-512 code for functions shared with the rest of the program.
+#include "CpuMarchKernels.h"
+
+#if defined(_M_X64) || defined(_M_IX86) || defined(__x86_64__) || defined(__i386__)
+
+// FMA contraction is disabled so that the packets produce the same images as the scalar kernels.
+#if defined(__clang__)
+#pragma STDC FP_CONTRACT OFF
+#pragma clang attribute push(__attribute__((target("avx512f,avx2,fma"))), apply_to = function)
+#elif defined(__GNUC__)
+#pragma GCC push_options
+#pragma GCC target("avx512f,avx2,fma")
+#pragma GCC optimize("fp-contract=off")
+#endif
+
+#include "SimdAvx512.h"
+#include "CpuPacketMarcher.h"
+
+CpuMarchKernels CpuMarchKernels::GetAvx512Kernels()
+{
+    return { Avx512::Name(), Avx512::WIDTH, &CpuPacketMarcher<Avx512>::RenderTile,
+             &CpuPacketMarcher<Avx512>::EvaluateDistances };
+}
+
+#if defined(__clang__)
+#pragma clang attribute pop
+#elif defined(__GNUC__)
+#pragma GCC pop_options
+#endif
+
+#endif
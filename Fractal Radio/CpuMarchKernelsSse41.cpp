@@ -0,0 +1,30 @@
+// Compiled for SSE4.1 independently of the project-wide instruction set; CpuMarchKernels only calls into this file when
+// CpuFeatures reports support. Nothing outside the Sse41-specific templates may be defined here, otherwise the linker
+// could pick SSE4.1 code for functions shared with the rest of the program.
+#include "CpuMarchKernels.h"
+
+#if defined(_M_X64) || defined(_M_IX86) || defined(__x86_64__) || defined(__i386__)
+
+#if defined(__clang__)
+#pragma clang attribute push(__attribute__((target("sse4.1"))), apply_to = function)
+#elif defined(__GNUC__)
+#pragma GCC push_options
+#pragma GCC target("sse4.1")
+#endif
+
+#include "SimdSse41.h"
+#include "CpuPacketMarcher.h"
+
+CpuMarchKernels CpuMarchKernels::GetSse41Kernels()
+{
+    return { Sse41::Name(), Sse41::WIDTH, &CpuPacketMarcher<Sse41>::RenderTile,
+             &CpuPacketMarcher<Sse41>::EvaluateDistances };
+}
+
+#if defined(__clang__)
+#pragma clang attribute pop
+#elif defined(__GNUC__)
+#pragma GCC pop_options
+#endif
+
+#endif
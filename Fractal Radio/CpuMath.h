@@ -0,0 +1,243 @@
+#pragma once
+
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+
+// Small HLSL-like vector types used by the CPU port of the ray marcher.
+// Matrices follow the DirectXMath conventions (row-major, row vectors), so a Float4x4 built here
+// matches the XMMATRIX produced by Camera::GetMatrix().
+
+struct Float2
+{
+    float X;
+    float Y;
+};
+
+struct Uint2
+{
+    uint32_t X;
+    uint32_t Y;
+};
+
+struct Float3
+{
+    float X;
+    float Y;
+    float Z;
+};
+
+struct Float4
+{
+    float X;
+    float Y;
+    float Z;
+    float W;
+};
+
+struct Float4x4
+{
+    float M[4][4];
+};
+
+inline Float3 operator+(const Float3& a, const Float3& b) { return { a.X + b.X, a.Y + b.Y, a.Z + b.Z }; }
+inline Float3 operator-(const Float3& a, const Float3& b) { return { a.X - b.X, a.Y - b.Y, a.Z - b.Z }; }
+inline Float3 operator*(const Float3& a, const Float3& b) { return { a.X * b.X, a.Y * b.Y, a.Z * b.Z }; }
+inline Float3 operator+(const Float3& a, const float b)    { return { a.X + b, a.Y + b, a.Z + b }; }
+inline Float3 operator-(const Float3& a, const float b)    { return { a.X - b, a.Y - b, a.Z - b }; }
+inline Float3 operator*(const Float3& a, const float b)    { return { a.X * b, a.Y * b, a.Z * b }; }
+inline Float3 operator*(const float a, const Float3& b)    { return { a * b.X, a * b.Y, a * b.Z }; }
+inline Float3 operator/(const Float3& a, const float b)    { return { a.X / b, a.Y / b, a.Z / b }; }
+inline Float3 operator-(const Float3& a)                   { return { -a.X, -a.Y, -a.Z }; }
+
+inline Float3& operator+=(Float3& a, const Float3& b)
+{
+    a = a + b;
+    return a;
+}
+
+inline Float3& operator*=(Float3& a, const float b)
+{
+    a = a * b;
+    return a;
+}
+
+inline float Dot(const Float3& a, const Float3& b)
+{
+    return a.X * b.X + a.Y * b.Y + a.Z * b.Z;
+}
+
+inline float Length(const Float3& a)
+{
+    return std::sqrt(Dot(a, a));
+}
+
+inline Float3 Normalize(const Float3& a)
+{
+    return a / Length(a);
+}
+
+inline Float3 Reflect(const Float3& incident, const Float3& normal)
+{
+    return incident - 2.0f * Dot(incident, normal) * normal;
+}
+
+inline float Saturate(const float value)
+{
+    return value < 0.0f ? 0.0f : (value > 1.0f ? 1.0f : value);
+}
+
+// Forward-mode dual number: a value together with its gradient with respect to the position the distance estimators
+// are evaluated at. Evaluating an estimator on duals yields the distance and the surface normal direction in one pass.
+struct DualFloat
+{
+    float  Value;
+    Float3 Gradient;
+};
+
+// Dual counterpart of Float3; GradientX, GradientY and GradientZ are the rows of the Jacobian.
+struct DualFloat3
+{
+    Float3 Value;
+    Float3 GradientX;
+    Float3 GradientY;
+    Float3 GradientZ;
+};
+
+inline DualFloat operator-(const DualFloat& a, const float b) { return { a.Value - b, a.Gradient }; }
+inline DualFloat operator*(const DualFloat& a, const float b) { return { a.Value * b, a.Gradient * b }; }
+
+inline DualFloat3 operator-(const DualFloat3& a, const Float3& b)
+{
+    return { a.Value - b, a.GradientX, a.GradientY, a.GradientZ };
+}
+
+inline DualFloat3 operator*(const DualFloat3& a, const float b)
+{
+    return { a.Value * b, a.GradientX * b, a.GradientY * b, a.GradientZ * b };
+}
+
+// The independent variable: the position itself, whose Jacobian is the identity.
+inline DualFloat3 DualVariable(const Float3& position)
+{
+    return { position, { 1.0f, 0.0f, 0.0f }, { 0.0f, 1.0f, 0.0f }, { 0.0f, 0.0f, 1.0f } };
+}
+
+inline DualFloat Length(const DualFloat3& a)
+{
+    const float length = Length(a.Value);
+    return { length, (a.GradientX * a.Value.X + a.GradientY * a.Value.Y + a.GradientZ * a.Value.Z) / length };
+}
+
+inline DualFloat Min(const DualFloat& a, const DualFloat& b)
+{
+    return b.Value < a.Value ? b : a;
+}
+
+inline Float4x4 MatrixIdentity()
+{
+    return { {
+        { 1.0f, 0.0f, 0.0f, 0.0f },
+        { 0.0f, 1.0f, 0.0f, 0.0f },
+        { 0.0f, 0.0f, 1.0f, 0.0f },
+        { 0.0f, 0.0f, 0.0f, 1.0f }
+    } };
+}
+
+inline Float4x4 MatrixRotationX(const float angle)
+{
+    const float sine   = std::sin(angle);
+    const float cosine = std::cos(angle);
+
+    return { {
+        { 1.0f, 0.0f,    0.0f,   0.0f },
+        { 0.0f, cosine,  sine,   0.0f },
+        { 0.0f, -sine,   cosine, 0.0f },
+        { 0.0f, 0.0f,    0.0f,   1.0f }
+    } };
+}
+
+inline Float4x4 MatrixRotationY(const float angle)
+{
+    const float sine   = std::sin(angle);
+    const float cosine = std::cos(angle);
+
+    return { {
+        { cosine, 0.0f, -sine,   0.0f },
+        { 0.0f,   1.0f, 0.0f,    0.0f },
+        { sine,   0.0f, cosine,  0.0f },
+        { 0.0f,   0.0f, 0.0f,    1.0f }
+    } };
+}
+
+inline Float4x4 MatrixTranslation(const float x, const float y, const float z)
+{
+    Float4x4 result = MatrixIdentity();
+    result.M[3][0] = x;
+    result.M[3][1] = y;
+    result.M[3][2] = z;
+    return result;
+}
+
+inline Float4x4 MatrixMultiply(const Float4x4& a, const Float4x4& b)
+{
+    Float4x4 result{};
+    for (int row = 0; row < 4; row++)
+        for (int column = 0; column < 4; column++)
+            for (int i = 0; i < 4; i++)
+                result.M[row][column] += a.M[row][i] * b.M[i][column];
+    return result;
+}
+
+// Equivalent of mul(g_cameraMatrix, float4(point, 1.0f)).xyz in RayMarcher.hlsl.
+inline Float3 TransformPoint(const Float3& point, const Float4x4& matrix)
+{
+    return {
+        point.X * matrix.M[0][0] + point.Y * matrix.M[1][0] + point.Z * matrix.M[2][0] + matrix.M[3][0],
+        point.X * matrix.M[0][1] + point.Y * matrix.M[1][1] + point.Z * matrix.M[2][1] + matrix.M[3][1],
+        point.X * matrix.M[0][2] + point.Y * matrix.M[1][2] + point.Z * matrix.M[2][2] + matrix.M[3][2]
+    };
+}
+
+// Equivalent of mul(g_cameraMatrix, float4(direction, 0.0f)).xyz in RayMarcher.hlsl.
+inline Float3 TransformDirection(const Float3& direction, const Float4x4& matrix)
+{
+    return {
+        direction.X * matrix.M[0][0] + direction.Y * matrix.M[1][0] + direction.Z * matrix.M[2][0],
+        direction.X * matrix.M[0][1] + direction.Y * matrix.M[1][1] + direction.Z * matrix.M[2][1],
+        direction.X * matrix.M[0][2] + direction.Y * matrix.M[1][2] + direction.Z * matrix.M[2][2]
+    };
+}
+
+// Inverse of TransformPoint for the rigid camera matrices, mul(point - eye, (float3x3)matrix) in RayMarcher.hlsl: the
+// rotation part is orthonormal, so its transpose undoes it.
+inline Float3 InverseTransformPoint(const Float3& point, const Float4x4& matrix)
+{
+    const Float3 offset = { point.X - matrix.M[3][0], point.Y - matrix.M[3][1], point.Z - matrix.M[3][2] };
+    return {
+        offset.X * matrix.M[0][0] + offset.Y * matrix.M[0][1] + offset.Z * matrix.M[0][2],
+        offset.X * matrix.M[1][0] + offset.Y * matrix.M[1][1] + offset.Z * matrix.M[1][2],
+        offset.X * matrix.M[2][0] + offset.Y * matrix.M[2][1] + offset.Z * matrix.M[2][2]
+    };
+}
+
+// Side of the square tiles the CPU textures keep their texels in, that of the ray marcher's thread groups.
+constexpr uint32_t TEXTURE_TILE_SIZE = 8;
+
+// Texels of a width x height texture in the tiled layout, which pads it to whole tiles.
+inline size_t GetTiledSize(const uint32_t width, const uint32_t height)
+{
+    const size_t tilesX = (width + TEXTURE_TILE_SIZE - 1) / TEXTURE_TILE_SIZE;
+    const size_t tilesY = (height + TEXTURE_TILE_SIZE - 1) / TEXTURE_TILE_SIZE;
+    return tilesX * tilesY * TEXTURE_TILE_SIZE * TEXTURE_TILE_SIZE;
+}
+
+// Index of texel (x, y) of a texture width texels wide in the tiled layout: the tiles in row-major order, each with
+// its texels in row-major order, so that a thread group of the ray marcher reads and writes one block of memory
+// instead of a short run of every row it covers.
+inline size_t GetTiledIndex(const uint32_t x, const uint32_t y, const uint32_t width)
+{
+    const size_t tilesX = (width + TEXTURE_TILE_SIZE - 1) / TEXTURE_TILE_SIZE;
+    const size_t tile = y / TEXTURE_TILE_SIZE * tilesX + x / TEXTURE_TILE_SIZE;
+    return (tile * TEXTURE_TILE_SIZE + y % TEXTURE_TILE_SIZE) * TEXTURE_TILE_SIZE + x % TEXTURE_TILE_SIZE;
+}
@@ -0,0 +1,763 @@
+#pragma once
+
+#include <cstdint>
+
+#include "CpuRayMarcher.h"
+
+// SoA ray-packet version of CpuRayMarcher, instantiated once per instruction set (see SimdSse41.h, SimdAvx2.h and
+// SimdAvx512.h). Every lane runs the same code path as RayMarcher.hlsl; lanes that finished marching are masked out
+// and stop contributing to the distances, step counts and statistics.
+//
+// This header is included from translation units compiled for a specific instruction set, so it must not call the
+// non-template inline helpers of CpuMath.h or instantiate standard library templates.
+template <class Isa>
+class CpuPacketMarcher
+{
+    using Float = typename Isa::Float;
+    using Mask  = typename Isa::Mask;
+
+    struct Vector
+    {
+        Float X;
+        Float Y;
+        Float Z;
+    };
+
+    // Packet counterparts of DualFloat and DualFloat3.
+    struct DualFloat
+    {
+        Float  Value;
+        Vector Gradient;
+    };
+
+    struct DualVector
+    {
+        Vector Value;
+        Vector GradientX;
+        Vector GradientY;
+        Vector GradientZ;
+    };
+
+    // Packet counterpart of CpuRayMarcher::MarchState.
+    struct MarchState
+    {
+        Float TotalDistance;
+        Float StepLength;
+        Float PreviousDistance;
+        Float Relaxation;
+    };
+
+    struct TraceResult
+    {
+        Float  AmbientOcclusion;
+        Mask   Hit;
+        Vector Normal;
+        Float  Visibility;
+        Float  Distance;
+        Float  Steps;
+    };
+
+public:
+
+    static void  RenderTile(uint32_t, uint32_t, const RayMarcherBuffer&,
+                            const CpuRayMarcher::RenderTargets&, CpuRayMarcher::Statistics&);
+    static void  EvaluateDistances(const float*, const float*, const float*, float*, uint32_t);
+
+    static Float SphereEstimator(const Vector&, const Vector&, Float);
+    static Float SpheresEstimator(const Vector&, const Vector&);
+    static Float Sierpinski(const Vector&, const Vector&);
+    static Float YPlane(const Vector&, Float);
+    static Float DistanceEstimator(const Vector&);
+
+    static DualFloat SphereEstimator(const DualVector&, const Vector&, Float);
+    static DualFloat SpheresEstimator(const DualVector&, const Vector&);
+    static DualFloat Sierpinski(const DualVector&, const Vector&);
+    static DualFloat YPlane(const DualVector&, Float);
+    static DualFloat DistanceEstimator(const DualVector&);
+
+private:
+
+    static TraceResult IterativeTrace(Vector, Vector, Float, Float, Float, Mask,
+                                      const RayMarcherBuffer&, const CpuShadowCacheTexture&,
+                                      CpuRayMarcher::Statistics&);
+    static Vector      RefineHit(const Vector&, const Vector&, const Vector&, Float, Float, Mask,
+                                 const RayMarcherBuffer&, CpuRayMarcher::Statistics&);
+    static Vector      EstimateNormal(const Vector&, Mask, const RayMarcherBuffer&,
+                                      CpuRayMarcher::Statistics&);
+    static Float       TraceShadow(const Vector&, const Vector&, Mask, const RayMarcherBuffer&,
+                                   CpuRayMarcher::Statistics&);
+    static Float       ShadowVisibility(const Vector&, Mask, const RayMarcherBuffer&,
+                                        const CpuShadowCacheTexture&, CpuRayMarcher::Statistics&);
+    static Mask        Advance(Float, Mask, MarchState&, CpuRayMarcher::Statistics&);
+
+    static Vector      Set1(const Float3&);
+    static Vector      Add(const Vector&, const Vector&);
+    static Vector      Sub(const Vector&, const Vector&);
+    static Vector      Scale(const Vector&, Float);
+    static Vector      Select(Mask, const Vector&, const Vector&);
+    static Float       Dot(const Vector&, const Vector&);
+    static Float       Length(const Vector&);
+    static Vector      Normalize(const Vector&);
+    static Float       Fmod(Float, Float);
+
+    static DualVector  DualVariable(const Vector&);
+    static DualVector  Sub(const DualVector&, const Vector&);
+    static DualVector  Scale(const DualVector&, Float);
+    static DualFloat   Length(const DualVector&);
+
+    static uint32_t    Count(Mask);
+};
+
+template <class Isa>
+void CpuPacketMarcher<Isa>::RenderTile(const uint32_t tileX, const uint32_t tileY,
+                                       const RayMarcherBuffer& rayMarcherData,
+                                       const CpuRayMarcher::RenderTargets& renderTargets,
+                                       CpuRayMarcher::Statistics& statistics)
+{
+    const float width = rayMarcherData.WindowSize.X;
+    const float height = rayMarcherData.WindowSize.Y;
+    const Float4x4& cameraMatrix = rayMarcherData.CameraMatrix;
+    const Float2 sampleOffset = CpuRayMarcher::GetSampleOffset(rayMarcherData.SampleIndex);
+
+    const Float zero = Isa::Set1(0.0f);
+    const Float one = Isa::Set1(1.0f);
+    const Float two = Isa::Set1(2.0f);
+
+    float prepassDistances[PREPASS_CELLS * PREPASS_CELLS];
+    CpuRayMarcher::MarchPrepass(tileX, tileY, rayMarcherData, prepassDistances, statistics);
+
+    for (uint32_t first = 0; first < BLOCK_SIZE * BLOCK_SIZE; first += Isa::WIDTH)
+    {
+        float pixelsX[Isa::WIDTH];
+        float pixelsY[Isa::WIDTH];
+        float lanePrepassDistances[Isa::WIDTH];
+        float laneReprojectedDistances[Isa::WIDTH];
+        float laneReprojectedSteps[Isa::WIDTH];
+        // The threads of the thread group are taken in Z-order, so that a packet covers a square of pixels, or two
+        // side by side, rather than a strip of rows.
+        for (uint32_t lane = 0; lane < Isa::WIDTH; lane++)
+        {
+            uint32_t tileIndexX = 0;
+            uint32_t tileIndexY = 0;
+            for (uint32_t bit = 0; 1u << bit < BLOCK_SIZE; bit++)
+            {
+                tileIndexX |= ((first + lane) >> (2 * bit) & 1) << bit;
+                tileIndexY |= ((first + lane) >> (2 * bit + 1) & 1) << bit;
+            }
+            const Uint2 pixel = CpuRayMarcher::GetThreadPixel(tileX * BLOCK_SIZE + tileIndexX,
+                                                              tileY * BLOCK_SIZE + tileIndexY, rayMarcherData);
+            pixelsX[lane] = static_cast<float>(pixel.X);
+            pixelsY[lane] = static_cast<float>(pixel.Y);
+            lanePrepassDistances[lane] = prepassDistances[tileIndexY / PREPASS_CELL_SIZE * PREPASS_CELLS +
+                                                          tileIndexX / PREPASS_CELL_SIZE];
+
+            // The reprojection gathers from the previous depth texture, so it runs one lane at a time.
+            laneReprojectedDistances[lane] = 0.0f;
+            laneReprojectedSteps[lane] = -1.0f;
+            if (pixelsX[lane] < width && pixelsY[lane] < height)
+                laneReprojectedDistances[lane] = CpuRayMarcher::Reproject(pixel.X, pixel.Y, rayMarcherData,
+                                                                          *renderTargets.PreviousDepth,
+                                                                          laneReprojectedSteps[lane], statistics);
+        }
+
+        const Float x = Isa::Load(pixelsX);
+        const Float y = Isa::Load(pixelsY);
+        const Mask active = (x < Isa::Set1(width)) & (y < Isa::Set1(height));
+        if (!Isa::Bits(active))
+            continue;
+
+        // Same operations, in the same order, as CpuRayMarcher::ShadePixel.
+        Float normalizedX = (x + Isa::Set1(sampleOffset.X)) / Isa::Set1(width) * two - one;
+        Float normalizedY = (y + Isa::Set1(sampleOffset.Y)) / Isa::Set1(height) * two - one;
+        normalizedX = normalizedX * Isa::Set1(width / height);
+        normalizedY = normalizedY * Isa::Set1(-1.0f);
+
+        const Float directionZ = Isa::Set1(5.0f);
+        Vector rayDirection = {
+            normalizedX * Isa::Set1(cameraMatrix.M[0][0]) + normalizedY * Isa::Set1(cameraMatrix.M[1][0]) +
+                directionZ * Isa::Set1(cameraMatrix.M[2][0]),
+            normalizedX * Isa::Set1(cameraMatrix.M[0][1]) + normalizedY * Isa::Set1(cameraMatrix.M[1][1]) +
+                directionZ * Isa::Set1(cameraMatrix.M[2][1]),
+            normalizedX * Isa::Set1(cameraMatrix.M[0][2]) + normalizedY * Isa::Set1(cameraMatrix.M[1][2]) +
+                directionZ * Isa::Set1(cameraMatrix.M[2][2])
+        };
+        const Vector eye = Set1(Float3{ cameraMatrix.M[3][0], cameraMatrix.M[3][1], cameraMatrix.M[3][2] });
+        const Vector onCameraPoint = Add(eye, rayDirection);
+
+        const Float coneDistance = Length(rayDirection);
+        rayDirection = Normalize(rayDirection);
+
+        const Float startDistance = Isa::Max(zero, Isa::Max(Isa::Load(lanePrepassDistances),
+                                                            Isa::Load(laneReprojectedDistances)) - coneDistance);
+
+        statistics.PrimaryRays += Count(active);
+        const TraceResult result = IterativeTrace(onCameraPoint, rayDirection, startDistance,
+                                                  Isa::Load(laneReprojectedSteps), coneDistance, active,
+                                                  rayMarcherData, *renderTargets.ShadowCache, statistics);
+
+        const Float3& light = rayMarcherData.LightDirection;
+        const Vector lightDirection = Normalize(Set1(Float3{ -light.X, -light.Y, -light.Z }));
+        const Float lightIntensity = Isa::Max(Isa::Set1(0.1f), Dot(result.Normal, lightDirection));
+        Float color = result.AmbientOcclusion * lightIntensity;
+        color = color * (Isa::Set1(0.5f) + Isa::Set1(0.5f) * result.Visibility);
+
+        float colors[Isa::WIDTH];
+        Isa::Store(colors, color);
+        float normalsX[Isa::WIDTH];
+        float normalsY[Isa::WIDTH];
+        float normalsZ[Isa::WIDTH];
+        Isa::Store(normalsX, result.Normal.X);
+        Isa::Store(normalsY, result.Normal.Y);
+        Isa::Store(normalsZ, result.Normal.Z);
+        float depths[Isa::WIDTH];
+        Isa::Store(depths, Isa::Select(result.Hit, coneDistance + result.Distance, zero));
+        float steps[Isa::WIDTH];
+        Isa::Store(steps, Isa::Select(result.Hit, result.Steps, zero));
+
+        const uint32_t activeBits = Isa::Bits(active);
+        for (uint32_t lane = 0; lane < Isa::WIDTH; lane++)
+            if (activeBits & (1u << lane))
+            {
+                const CpuRayMarcher::PixelSample pixelSample = {
+                    Float3{ colors[lane], colors[lane], colors[lane] },
+                    Float3{ normalsX[lane], normalsY[lane], normalsZ[lane] },
+                    depths[lane],
+                    // The shader keeps TraceResult.NumSteps as an int, which truncates the fractional step counts
+                    // that upsampled depths carry into the reprojection.
+                    static_cast<float>(static_cast<int>(steps[lane]))
+                };
+                const auto pixelX = static_cast<uint32_t>(pixelsX[lane]);
+                const auto pixelY = static_cast<uint32_t>(pixelsY[lane]);
+                if (rayMarcherData.Deferred)
+                    CpuRayMarcher::StoreGeometry(pixelX, pixelY, pixelSample, rayMarcherData, renderTargets);
+                else
+                    CpuRayMarcher::StoreSample(pixelX, pixelY, pixelSample, rayMarcherData, renderTargets);
+            }
+    }
+}
+
+// Evaluates DistanceEstimator for count points given in SoA form; count must be a multiple of the packet width.
+template <class Isa>
+void CpuPacketMarcher<Isa>::EvaluateDistances(const float* xs, const float* ys, const float* zs, float* distances,
+                                              const uint32_t count)
+{
+    for (uint32_t i = 0; i < count; i += Isa::WIDTH)
+        Isa::Store(distances + i, DistanceEstimator(Vector{ Isa::Load(xs + i), Isa::Load(ys + i), Isa::Load(zs + i) }));
+}
+
+template <class Isa>
+typename CpuPacketMarcher<Isa>::Float CpuPacketMarcher<Isa>::SphereEstimator(const Vector& crtPosition,
+                                                                             const Vector& spherePosition,
+                                                                             const Float radius)
+{
+    return Length(Sub(crtPosition, spherePosition)) - radius;
+}
+
+template <class Isa>
+typename CpuPacketMarcher<Isa>::Float CpuPacketMarcher<Isa>::SpheresEstimator(const Vector& crtPosition,
+                                                                              const Vector& spherePosition)
+{
+    Vector z = Sub(crtPosition, spherePosition);
+    z.X = Fmod(z.X, Isa::Set1(1.0f)) - Isa::Set1(0.5f);
+    z.Z = Fmod(z.Z, Isa::Set1(1.0f)) - Isa::Set1(0.5f);
+    return Length(z) - Isa::Set1(0.3f);
+}
+
+template <class Isa>
+typename CpuPacketMarcher<Isa>::Float CpuPacketMarcher<Isa>::Sierpinski(const Vector& crtPosition,
+                                                                        const Vector& tetrahedronPosition)
+{
+    Vector z = Sub(crtPosition, tetrahedronPosition);
+
+    const Float zero = Isa::Set1(0.0f);
+    const Float scale = Isa::Set1(2.0f);
+    const Float offset = Isa::Set1(1.0f);
+
+    for (int n = 0; n < SIERPINSKI_ITERATIONS; n++)
+    {
+        const Mask fold1 = z.X + z.Y < zero;
+        z = Vector{ Isa::Select(fold1, -z.Y, z.X), Isa::Select(fold1, -z.X, z.Y), z.Z };
+        const Mask fold2 = z.X + z.Z < zero;
+        z = Vector{ Isa::Select(fold2, -z.Z, z.X), z.Y, Isa::Select(fold2, -z.X, z.Z) };
+        const Mask fold3 = z.Y + z.Z < zero;
+        z = Vector{ z.X, Isa::Select(fold3, -z.Z, z.Y), Isa::Select(fold3, -z.Y, z.Z) };
+        z = Sub(Scale(z, scale), Vector{ offset, offset, offset });
+    }
+
+    // pow(2, -SIERPINSKI_ITERATIONS), exact in single precision.
+    float inverseScale = 1.0f;
+    for (int n = 0; n < SIERPINSKI_ITERATIONS; n++)
+        inverseScale *= 0.5f;
+
+    return Length(z) * Isa::Set1(inverseScale);
+}
+
+template <class Isa>
+typename CpuPacketMarcher<Isa>::Float CpuPacketMarcher<Isa>::YPlane(const Vector& crtPosition, const Float y)
+{
+    return crtPosition.Y - y;
+}
+
+template <class Isa>
+typename CpuPacketMarcher<Isa>::Float CpuPacketMarcher<Isa>::DistanceEstimator(const Vector& position)
+{
+    return Isa::Min(SpheresEstimator(position, Set1(Float3{ 0.0f, 1.0f, 3.0f })), YPlane(position, Isa::Set1(-1.0f)));
+}
+
+template <class Isa>
+typename CpuPacketMarcher<Isa>::DualFloat CpuPacketMarcher<Isa>::SphereEstimator(const DualVector& crtPosition,
+                                                                                 const Vector& spherePosition,
+                                                                                 const Float radius)
+{
+    const DualFloat length = Length(Sub(crtPosition, spherePosition));
+    return { length.Value - radius, length.Gradient };
+}
+
+template <class Isa>
+typename CpuPacketMarcher<Isa>::DualFloat CpuPacketMarcher<Isa>::SpheresEstimator(const DualVector& crtPosition,
+                                                                                  const Vector& spherePosition)
+{
+    DualVector z = Sub(crtPosition, spherePosition);
+    z.Value.X = Fmod(z.Value.X, Isa::Set1(1.0f)) - Isa::Set1(0.5f);
+    z.Value.Z = Fmod(z.Value.Z, Isa::Set1(1.0f)) - Isa::Set1(0.5f);
+    const DualFloat length = Length(z);
+    return { length.Value - Isa::Set1(0.3f), length.Gradient };
+}
+
+template <class Isa>
+typename CpuPacketMarcher<Isa>::DualFloat CpuPacketMarcher<Isa>::Sierpinski(const DualVector& crtPosition,
+                                                                            const Vector& tetrahedronPosition)
+{
+    DualVector z = Sub(crtPosition, tetrahedronPosition);
+
+    const Float zero = Isa::Set1(0.0f);
+    const Float scale = Isa::Set1(2.0f);
+    const Float offset = Isa::Set1(1.0f);
+
+    for (int n = 0; n < SIERPINSKI_ITERATIONS; n++)
+    {
+        const Mask fold1 = z.Value.X + z.Value.Y < zero;
+        z = DualVector{
+            Vector{ Isa::Select(fold1, -z.Value.Y, z.Value.X), Isa::Select(fold1, -z.Value.X, z.Value.Y), z.Value.Z },
+            Select(fold1, Scale(z.GradientY, Isa::Set1(-1.0f)), z.GradientX),
+            Select(fold1, Scale(z.GradientX, Isa::Set1(-1.0f)), z.GradientY),
+            z.GradientZ
+        };
+        const Mask fold2 = z.Value.X + z.Value.Z < zero;
+        z = DualVector{
+            Vector{ Isa::Select(fold2, -z.Value.Z, z.Value.X), z.Value.Y, Isa::Select(fold2, -z.Value.X, z.Value.Z) },
+            Select(fold2, Scale(z.GradientZ, Isa::Set1(-1.0f)), z.GradientX),
+            z.GradientY,
+            Select(fold2, Scale(z.GradientX, Isa::Set1(-1.0f)), z.GradientZ)
+        };
+        const Mask fold3 = z.Value.Y + z.Value.Z < zero;
+        z = DualVector{
+            Vector{ z.Value.X, Isa::Select(fold3, -z.Value.Z, z.Value.Y), Isa::Select(fold3, -z.Value.Y, z.Value.Z) },
+            z.GradientX,
+            Select(fold3, Scale(z.GradientZ, Isa::Set1(-1.0f)), z.GradientY),
+            Select(fold3, Scale(z.GradientY, Isa::Set1(-1.0f)), z.GradientZ)
+        };
+        z = Sub(Scale(z, scale), Vector{ offset, offset, offset });
+    }
+
+    float inverseScale = 1.0f;
+    for (int n = 0; n < SIERPINSKI_ITERATIONS; n++)
+        inverseScale *= 0.5f;
+
+    const DualFloat length = Length(z);
+    return { length.Value * Isa::Set1(inverseScale), Scale(length.Gradient, Isa::Set1(inverseScale)) };
+}
+
+template <class Isa>
+typename CpuPacketMarcher<Isa>::DualFloat CpuPacketMarcher<Isa>::YPlane(const DualVector& crtPosition, const Float y)
+{
+    return { crtPosition.Value.Y - y, crtPosition.GradientY };
+}
+
+template <class Isa>
+typename CpuPacketMarcher<Isa>::DualFloat CpuPacketMarcher<Isa>::DistanceEstimator(const DualVector& position)
+{
+    const DualFloat spheres = SpheresEstimator(position, Set1(Float3{ 0.0f, 1.0f, 3.0f }));
+    const DualFloat plane = YPlane(position, Isa::Set1(-1.0f));
+    const Mask closerPlane = plane.Value < spheres.Value;
+    return { Isa::Select(closerPlane, plane.Value, spheres.Value),
+             Select(closerPlane, plane.Gradient, spheres.Gradient) };
+}
+
+// See CpuRayMarcher::Advance. Returns the lanes whose step was kept.
+template <class Isa>
+typename CpuPacketMarcher<Isa>::Mask CpuPacketMarcher<Isa>::Advance(const Float distance, const Mask marching,
+                                                                    MarchState& state,
+                                                                    CpuRayMarcher::Statistics& statistics)
+{
+    const Float one = Isa::Set1(1.0f);
+
+    const Mask fallback = marching & (state.Relaxation > one) &
+        (Isa::Max(distance, -distance) + state.PreviousDistance < state.StepLength);
+    const Mask accepted = Isa::AndNot(marching, fallback);
+    statistics.RelaxationFallbacks += Count(fallback);
+
+    state.TotalDistance = Isa::Select(fallback, state.TotalDistance - state.StepLength + state.PreviousDistance,
+                                      state.TotalDistance);
+    state.StepLength = Isa::Select(fallback, state.PreviousDistance, state.StepLength);
+    state.Relaxation = Isa::Select(fallback, one, state.Relaxation);
+
+    const Float stepLength = distance * state.Relaxation;
+    state.StepLength = Isa::Select(accepted, stepLength, state.StepLength);
+    state.PreviousDistance = Isa::Select(accepted, distance, state.PreviousDistance);
+    state.TotalDistance = Isa::Select(accepted, state.TotalDistance + stepLength, state.TotalDistance);
+
+    return accepted;
+}
+
+// See CpuRayMarcher::TraceShadow. Lanes leave the packet as they hit, escape or turn opaque in the penumbra.
+template <class Isa>
+typename CpuPacketMarcher<Isa>::Float CpuPacketMarcher<Isa>::TraceShadow(
+    const Vector& from, const Vector& direction, const Mask active,
+    const RayMarcherBuffer& rayMarcherData, CpuRayMarcher::Statistics& statistics)
+{
+    const uint32_t activeLanes = Count(active);
+    statistics.Rays += activeLanes;
+    statistics.ShadowRays += activeLanes;
+
+    const Float zero = Isa::Set1(0.0f);
+    const Float minimumDistance = Isa::Set1(MINIMUM_DISTANCE);
+    const Float maxCameraDepth = Isa::Set1(MAX_CAMERA_DEPTH);
+    const Float shadowSoftness = Isa::Set1(rayMarcherData.ShadowSoftness);
+    const Float shadowOpaque = Isa::Set1(SHADOW_OPAQUE);
+
+    MarchState state = { zero, zero, zero, Isa::Set1(rayMarcherData.OverRelaxation) };
+    Mask marching = active;
+    Float visibility = Isa::Set1(1.0f);
+
+    for (int steps = 0; steps < MAX_STEPS && Isa::Bits(marching); steps++)
+    {
+        const Float crtDistance = state.TotalDistance;
+        const Vector crtPoint = Add(from, Scale(direction, crtDistance));
+        const Float distance = DistanceEstimator(crtPoint);
+
+        const uint32_t marchingLanes = Count(marching);
+        statistics.Steps += marchingLanes;
+        statistics.ShadowSteps += marchingLanes;
+        statistics.DistanceEvaluations += marchingLanes;
+        statistics.LaneSlots += Isa::WIDTH;
+
+        const Mask advanced = Advance(distance, marching, state, statistics);
+
+        const Mask hit = advanced & (distance < minimumDistance);
+        const Mask escaped = Isa::AndNot(advanced, hit) & (distance > maxCameraDepth);
+        visibility = Isa::Select(hit, zero, visibility);
+        marching = Isa::AndNot(Isa::AndNot(marching, hit), escaped);
+
+        if (rayMarcherData.ShadowSoftness > 0.0f)
+        {
+            const Mask penumbra = advanced & marching & (crtDistance > zero);
+            visibility = Isa::Select(penumbra, Isa::Min(visibility, shadowSoftness * distance / crtDistance),
+                                     visibility);
+            const Mask opaque = penumbra & (visibility < shadowOpaque);
+            visibility = Isa::Select(opaque, zero, visibility);
+            marching = Isa::AndNot(marching, opaque);
+        }
+    }
+
+    return visibility;
+}
+
+// See CpuRayMarcher::ShadowVisibility. The hit lanes look the cache up one by one, with the code of the scalar kernels,
+// and only those outside it march. The other lanes are fully lit.
+template <class Isa>
+typename CpuPacketMarcher<Isa>::Float CpuPacketMarcher<Isa>::ShadowVisibility(
+    const Vector& hitPoint, const Mask hit, const RayMarcherBuffer& rayMarcherData,
+    const CpuShadowCacheTexture& shadowCache, CpuRayMarcher::Statistics& statistics)
+{
+    const Float zero = Isa::Set1(0.0f);
+
+    Mask cached = Isa::None();
+    Float visibility = Isa::Set1(1.0f);
+    if (rayMarcherData.ShadowCacheCellSize > 0.0f)
+    {
+        float pointsX[Isa::WIDTH];
+        float pointsY[Isa::WIDTH];
+        float pointsZ[Isa::WIDTH];
+        Isa::Store(pointsX, hitPoint.X);
+        Isa::Store(pointsY, hitPoint.Y);
+        Isa::Store(pointsZ, hitPoint.Z);
+
+        float cachedVisibilities[Isa::WIDTH];
+        const uint32_t hitBits = Isa::Bits(hit);
+        for (uint32_t lane = 0; lane < Isa::WIDTH; lane++)
+            cachedVisibilities[lane] = hitBits >> lane & 1 ?
+                CpuRayMarcher::LookUpShadowCache(Float3{ pointsX[lane], pointsY[lane], pointsZ[lane] },
+                                                 rayMarcherData, shadowCache) : -1.0f;
+
+        const Float cachedVisibility = Isa::Load(cachedVisibilities);
+        cached = Isa::AndNot(hit, cachedVisibility < zero);
+        visibility = Isa::Select(cached, cachedVisibility, visibility);
+        statistics.ShadowCacheHits += Count(cached);
+    }
+
+    // See CpuRayMarcher::MarchShadow for why the shadow ray uses only the x component of the direction.
+    const Mask marching = Isa::AndNot(hit, cached);
+    if (Isa::Bits(marching))
+    {
+        const Float3& light = rayMarcherData.LightDirection;
+        const Vector lightVector = Normalize(Set1(Float3{ -light.X, -light.Y, -light.Z }));
+        const Vector lightDirection = { lightVector.X, lightVector.X, lightVector.X };
+        const Vector toLight = Add(hitPoint, lightDirection);
+        visibility = Isa::Select(marching, TraceShadow(toLight, lightDirection, marching, rayMarcherData, statistics),
+                                 visibility);
+    }
+    return visibility;
+}
+
+// See CpuRayMarcher::RefineHit. All lanes share the tolerance, so they run the same number of bisection steps.
+template <class Isa>
+typename CpuPacketMarcher<Isa>::Vector CpuPacketMarcher<Isa>::RefineHit(
+    const Vector& from, const Vector& direction, const Vector& hitPoint, const Float hitDistance, const Float distance,
+    const Mask hit, const RayMarcherBuffer& rayMarcherData, CpuRayMarcher::Statistics& statistics)
+{
+    const Float zero = Isa::Set1(0.0f);
+
+    const int refinementSteps = CpuRayMarcher::GetRefinementSteps(rayMarcherData.HitTolerance);
+    Mask refining = Isa::AndNot(hit, distance < zero);
+    if (!refinementSteps || !Isa::Bits(refining))
+        return hitPoint;
+
+    Float nearDistance = hitDistance;
+    Float farDistance = hitDistance + Isa::Set1(2.0f * rayMarcherData.HitTolerance);
+
+    statistics.RefinementSteps += Count(refining);
+    statistics.DistanceEvaluations += Count(refining);
+    refining = refining & (DistanceEstimator(Add(from, Scale(direction, farDistance))) < zero);
+
+    for (int step = 0; step < refinementSteps && Isa::Bits(refining); step++)
+    {
+        const Float middleDistance = (nearDistance + farDistance) * Isa::Set1(0.5f);
+        statistics.RefinementSteps += Count(refining);
+        statistics.DistanceEvaluations += Count(refining);
+        const Mask inside = DistanceEstimator(Add(from, Scale(direction, middleDistance))) < zero;
+        farDistance = Isa::Select(refining & inside, middleDistance, farDistance);
+        nearDistance = Isa::Select(Isa::AndNot(refining, inside), middleDistance, nearDistance);
+    }
+
+    return Select(refining, Add(from, Scale(direction, nearDistance)), hitPoint);
+}
+
+// See CpuRayMarcher::EstimateNormal.
+template <class Isa>
+typename CpuPacketMarcher<Isa>::Vector CpuPacketMarcher<Isa>::EstimateNormal(
+    const Vector& crtPoint, const Mask active, const RayMarcherBuffer& rayMarcherData,
+    CpuRayMarcher::Statistics& statistics)
+{
+    if (rayMarcherData.AnalyticNormals)
+    {
+        statistics.DistanceEvaluations += Count(active);
+        return Normalize(DistanceEstimator(DualVariable(crtPoint)).Gradient);
+    }
+
+    const Float normalThreshold = Isa::Set1(NORMAL_THRESHOLD);
+
+    const Vector xyy = Set1(Float3{ 1.0f, -1.0f, -1.0f });
+    const Vector xyx = Set1(Float3{ -1.0f, 1.0f, -1.0f });
+    const Vector yyx = Set1(Float3{ -1.0f, -1.0f, 1.0f });
+    const Vector xxx = Set1(Float3{ 1.0f, 1.0f, 1.0f });
+
+    const Vector normal = Add(Add(Add(
+        Scale(xyy, DistanceEstimator(Add(crtPoint, Scale(xyy, normalThreshold)))),
+        Scale(xyx, DistanceEstimator(Add(crtPoint, Scale(xyx, normalThreshold))))),
+        Scale(yyx, DistanceEstimator(Add(crtPoint, Scale(yyx, normalThreshold))))),
+        Scale(xxx, DistanceEstimator(Add(crtPoint, Scale(xxx, normalThreshold)))));
+    statistics.DistanceEvaluations += 4 * Count(active);
+
+    return Normalize(normal);
+}
+
+template <class Isa>
+typename CpuPacketMarcher<Isa>::TraceResult CpuPacketMarcher<Isa>::IterativeTrace(
+    Vector from, Vector direction, Float startDistance, Float reprojectedSteps, Float coneDistance, const Mask active,
+    const RayMarcherBuffer& rayMarcherData, const CpuShadowCacheTexture& shadowCache,
+    CpuRayMarcher::Statistics& statistics)
+{
+    const Float zero = Isa::Set1(0.0f);
+    const Float hitTolerance = Isa::Set1(rayMarcherData.HitTolerance);
+
+    // See CpuRayMarcher::IterativeTrace. All lanes are at the same bounce, so they share the cone angle.
+    float coneAngle = rayMarcherData.ConeScale / (CAMERA_PLANE_DISTANCE * rayMarcherData.WindowSize.Y);
+    const Float maxCameraDepth = Isa::Set1(MAX_CAMERA_DEPTH);
+
+    TraceResult primaryResult = { zero, Isa::None(), direction, Isa::Set1(1.0f), zero, zero };
+    Mask stillGoing = active;
+
+    for (int depth = 0; depth < MAX_RAYS_DEPTH && Isa::Bits(stillGoing); depth++)
+    {
+        statistics.Rays += Count(stillGoing);
+
+        MarchState state = { startDistance, zero, zero, Isa::Set1(rayMarcherData.OverRelaxation) };
+        Float hitSteps = zero;
+        Float hitDistance = zero;
+        Float hitValue = zero;
+        Vector hitPoint = from;
+        Mask marching = stillGoing;
+        Mask hit = Isa::None();
+
+        for (int steps = 0; steps < MAX_STEPS && Isa::Bits(marching); steps++)
+        {
+            const Float crtDistance = state.TotalDistance;
+            const Vector crtPoint = Add(from, Scale(direction, crtDistance));
+            const Float distance = DistanceEstimator(crtPoint);
+
+            const uint32_t marchingLanes = Count(marching);
+            statistics.Steps += marchingLanes;
+            statistics.DistanceEvaluations += marchingLanes;
+            statistics.LaneSlots += Isa::WIDTH;
+
+            const Mask advanced = Advance(distance, marching, state, statistics);
+
+            const Float coneRadius = Isa::Set1(coneAngle) * (coneDistance + crtDistance);
+            const Mask crtHit = advanced & (distance < Isa::Max(hitTolerance, coneRadius));
+            const Mask escaped = Isa::AndNot(advanced, crtHit) & (distance > maxCameraDepth);
+
+            hitPoint = Select(crtHit, crtPoint, hitPoint);
+            hitDistance = Isa::Select(crtHit, crtDistance, hitDistance);
+            hitValue = Isa::Select(crtHit, distance, hitValue);
+            hitSteps = Isa::Select(crtHit, Isa::Set1(static_cast<float>(steps)), hitSteps);
+            hit = hit | crtHit;
+            marching = Isa::AndNot(Isa::AndNot(marching, crtHit), escaped);
+        }
+
+        // Lanes that escaped or ran out of steps end their path, like stillGoing = false in the shader.
+        TraceResult crtResult = { zero, hit, direction, Isa::Set1(1.0f), zero, zero };
+
+        if (Isa::Bits(hit))
+        {
+            const Float ambientSteps = Isa::Select(reprojectedSteps < zero, hitSteps, reprojectedSteps);
+            const Float ambientOcclusion = Isa::Set1(1.0f) - ambientSteps / Isa::Set1(static_cast<float>(MAX_STEPS));
+
+            hitPoint = RefineHit(from, direction, hitPoint, hitDistance, hitValue, hit, rayMarcherData, statistics);
+            const Vector normal = EstimateNormal(hitPoint, hit, rayMarcherData, statistics);
+
+            crtResult.AmbientOcclusion = Isa::Select(hit, ambientOcclusion, zero);
+            crtResult.Normal = Select(hit, normal, direction);
+            crtResult.Distance = Isa::Select(hit, hitDistance, zero);
+            crtResult.Steps = Isa::Select(hit, ambientSteps, zero);
+
+            const Float twoDotIN = Isa::Set1(2.0f) * Dot(direction, normal);
+            const Vector reflected = Sub(direction, Scale(normal, twoDotIN));
+            from = Select(hit, Add(hitPoint, Scale(reflected, Isa::Set1(0.1f))), from);
+            direction = Select(hit, reflected, direction);
+            coneDistance = Isa::Select(hit, coneDistance + hitDistance + Isa::Set1(0.1f), coneDistance);
+
+            // The deferred march leaves the shadow to the lighting pass.
+            if (!rayMarcherData.Deferred)
+                crtResult.Visibility = ShadowVisibility(hitPoint, hit, rayMarcherData, shadowCache, statistics);
+        }
+
+        if (depth == 0)
+            primaryResult = crtResult;
+
+        // It also stops at the primary hit.
+        stillGoing = rayMarcherData.Deferred ? Isa::None() : hit;
+        coneAngle *= REFLECTION_SPREAD;
+        startDistance = zero;
+        reprojectedSteps = Isa::Set1(-1.0f);
+    }
+
+    return primaryResult;
+}
+
+template <class Isa>
+typename CpuPacketMarcher<Isa>::Vector CpuPacketMarcher<Isa>::Set1(const Float3& value)
+{
+    return { Isa::Set1(value.X), Isa::Set1(value.Y), Isa::Set1(value.Z) };
+}
+
+template <class Isa>
+typename CpuPacketMarcher<Isa>::Vector CpuPacketMarcher<Isa>::Add(const Vector& a, const Vector& b)
+{
+    return { a.X + b.X, a.Y + b.Y, a.Z + b.Z };
+}
+
+template <class Isa>
+typename CpuPacketMarcher<Isa>::Vector CpuPacketMarcher<Isa>::Sub(const Vector& a, const Vector& b)
+{
+    return { a.X - b.X, a.Y - b.Y, a.Z - b.Z };
+}
+
+template <class Isa>
+typename CpuPacketMarcher<Isa>::Vector CpuPacketMarcher<Isa>::Scale(const Vector& a, const Float b)
+{
+    return { a.X * b, a.Y * b, a.Z * b };
+}
+
+template <class Isa>
+typename CpuPacketMarcher<Isa>::Vector CpuPacketMarcher<Isa>::Select(const Mask mask, const Vector& a, const Vector& b)
+{
+    return { Isa::Select(mask, a.X, b.X), Isa::Select(mask, a.Y, b.Y), Isa::Select(mask, a.Z, b.Z) };
+}
+
+template <class Isa>
+typename CpuPacketMarcher<Isa>::Float CpuPacketMarcher<Isa>::Dot(const Vector& a, const Vector& b)
+{
+    return a.X * b.X + a.Y * b.Y + a.Z * b.Z;
+}
+
+template <class Isa>
+typename CpuPacketMarcher<Isa>::Float CpuPacketMarcher<Isa>::Length(const Vector& a)
+{
+    return Isa::Sqrt(Dot(a, a));
+}
+
+template <class Isa>
+typename CpuPacketMarcher<Isa>::Vector CpuPacketMarcher<Isa>::Normalize(const Vector& a)
+{
+    const Float length = Length(a);
+    return { a.X / length, a.Y / length, a.Z / length };
+}
+
+// Same result as the HLSL/C fmod: the remainder keeps the sign of the dividend.
+template <class Isa>
+typename CpuPacketMarcher<Isa>::Float CpuPacketMarcher<Isa>::Fmod(const Float a, const Float b)
+{
+    return a - b * Isa::Trunc(a / b);
+}
+
+template <class Isa>
+typename CpuPacketMarcher<Isa>::DualVector CpuPacketMarcher<Isa>::DualVariable(const Vector& position)
+{
+    return { position, Set1(Float3{ 1.0f, 0.0f, 0.0f }), Set1(Float3{ 0.0f, 1.0f, 0.0f }),
+             Set1(Float3{ 0.0f, 0.0f, 1.0f }) };
+}
+
+template <class Isa>
+typename CpuPacketMarcher<Isa>::DualVector CpuPacketMarcher<Isa>::Sub(const DualVector& a, const Vector& b)
+{
+    return { Sub(a.Value, b), a.GradientX, a.GradientY, a.GradientZ };
+}
+
+template <class Isa>
+typename CpuPacketMarcher<Isa>::DualVector CpuPacketMarcher<Isa>::Scale(const DualVector& a, const Float b)
+{
+    return { Scale(a.Value, b), Scale(a.GradientX, b), Scale(a.GradientY, b), Scale(a.GradientZ, b) };
+}
+
+template <class Isa>
+typename CpuPacketMarcher<Isa>::DualFloat CpuPacketMarcher<Isa>::Length(const DualVector& a)
+{
+    const Float length = Length(a.Value);
+    const Vector gradient = Add(Add(Scale(a.GradientX, a.Value.X), Scale(a.GradientY, a.Value.Y)),
+                                Scale(a.GradientZ, a.Value.Z));
+    return { length, Vector{ gradient.X / length, gradient.Y / length, gradient.Z / length } };
+}
+
+template <class Isa>
+uint32_t CpuPacketMarcher<Isa>::Count(const Mask mask)
+{
+    uint32_t bits = Isa::Bits(mask);
+    uint32_t count = 0;
+    while (bits)
+    {
+        bits &= bits - 1;
+        count++;
+    }
+    return count;
+}
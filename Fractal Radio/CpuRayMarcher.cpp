@@ -0,0 +1,1465 @@
+#include "pch.h"
+
+#include "CpuRayMarcher.h"
+
+#include "CpuMarchKernels.h"
+
+#include <cstring>
+
+using namespace std;
+
+CpuRayMarcher::CpuRayMarcher(const shared_ptr<TaskScheduler> taskScheduler, const CpuMarchKernels* marchKernels) :
+    m_taskScheduler(taskScheduler),
+    m_marchKernels(marchKernels),
+    m_marchTiles(),
+    m_fullTiles()
+{
+    m_workerStatistics.resize(m_taskScheduler->GetNumThreads());
+    ResetStatistics();
+}
+
+// With HalfResolution the march covers every other pixel of every other row and the UpsampleTile pass, the dispatch
+// of Upsample.hlsl, fills in the rest. The interleaved modes march half of the pixels and the ReconstructTile pass,
+// the dispatch of Reconstruct.hlsl, fills in the rest. The deferred march only finds the primary hits and the LightTile
+// pass, the dispatch of Lighting.hlsl, shades them; a relit frame skips the march and shades the G-buffer of the
+// previous one. With SupersampleBudget the CountEdgesTile and SupersampleTile passes, the dispatches of
+// EdgeHistogram.hlsl and Supersample.hlsl, then add jittered rays to the pixels on edges.
+void CpuRayMarcher::Render(const RayMarcherBuffer& rayMarcherData, const RenderTargets& renderTargets)
+{
+    const uint32_t width = static_cast<uint32_t>(rayMarcherData.WindowSize.X);
+    const uint32_t height = static_cast<uint32_t>(rayMarcherData.WindowSize.Y);
+    const Uint2 pixelSpacing = GetPixelSpacing(rayMarcherData);
+
+    const uint32_t tilesX = GetTilesCount((width + pixelSpacing.X - 1) / pixelSpacing.X);
+    const uint32_t tilesY = GetTilesCount((height + pixelSpacing.Y - 1) / pixelSpacing.Y);
+    const vector<uint32_t>& marchTiles = GetTileOrder(tilesX, tilesY, m_marchTiles);
+
+    if (rayMarcherData.Deferred != DEFERRED_RELIGHT)
+        m_taskScheduler->ParallelFor(tilesX * tilesY, [&](const uint32_t tileIndex, const uint32_t workerIndex)
+        {
+            const uint32_t tile = marchTiles[tileIndex];
+            m_marchKernels->RenderTile(tile % tilesX, tile / tilesX, rayMarcherData, renderTargets,
+                                       m_workerStatistics[workerIndex].Value);
+        });
+
+    const uint32_t fullTilesX = GetTilesCount(width);
+    const uint32_t fullTilesY = GetTilesCount(height);
+    const vector<uint32_t>& fullTiles = GetTileOrder(fullTilesX, fullTilesY, m_fullTiles);
+
+    if (rayMarcherData.Deferred)
+        m_taskScheduler->ParallelFor(fullTilesX * fullTilesY, [&](const uint32_t tileIndex, const uint32_t workerIndex)
+        {
+            const uint32_t tile = fullTiles[tileIndex];
+            LightTile(tile % fullTilesX, tile / fullTilesX, rayMarcherData, renderTargets,
+                      m_workerStatistics[workerIndex].Value);
+        });
+
+    if (rayMarcherData.HalfResolution || rayMarcherData.Interleave >= INTERLEAVE_CHECKER)
+        m_taskScheduler->ParallelFor(fullTilesX * fullTilesY, [&](const uint32_t tileIndex, const uint32_t workerIndex)
+        {
+            const uint32_t tile = fullTiles[tileIndex];
+            if (rayMarcherData.HalfResolution)
+                UpsampleTile(tile % fullTilesX, tile / fullTilesX, rayMarcherData, renderTargets,
+                             m_workerStatistics[workerIndex].Value);
+            else
+                ReconstructTile(tile % fullTilesX, tile / fullTilesX, rayMarcherData, renderTargets,
+                                m_workerStatistics[workerIndex].Value);
+        });
+
+    if (rayMarcherData.SupersampleBudget <= 0.0f)
+        return;
+
+    for (auto& workerStatistics : m_workerStatistics)
+        fill(begin(workerStatistics.EdgeHistogram), end(workerStatistics.EdgeHistogram), 0);
+
+    m_taskScheduler->ParallelFor(fullTilesX * fullTilesY, [&](const uint32_t tileIndex, const uint32_t workerIndex)
+    {
+        const uint32_t tile = fullTiles[tileIndex];
+        CountEdgesTile(tile % fullTilesX, tile / fullTilesX, rayMarcherData, renderTargets,
+                       m_workerStatistics[workerIndex].EdgeHistogram, m_workerStatistics[workerIndex].Value);
+    });
+
+    uint32_t edgeHistogram[EDGE_BUCKETS] = {};
+    for (const auto& workerStatistics : m_workerStatistics)
+        for (uint32_t bucket = 0; bucket < EDGE_BUCKETS; bucket++)
+            edgeHistogram[bucket] += workerStatistics.EdgeHistogram[bucket];
+    const uint32_t supersampledBucket = GetSupersampledBucket(rayMarcherData, edgeHistogram);
+
+    m_taskScheduler->ParallelFor(fullTilesX * fullTilesY, [&](const uint32_t tileIndex, const uint32_t workerIndex)
+    {
+        const uint32_t tile = fullTiles[tileIndex];
+        SupersampleTile(tile % fullTilesX, tile / fullTilesX, rayMarcherData, renderTargets, supersampledBucket,
+                        m_workerStatistics[workerIndex].Value);
+    });
+}
+
+// Fills the shadow cache with one BuildShadowCacheSlice task per slice along z.
+void CpuRayMarcher::BuildShadowCache(const RayMarcherBuffer& rayMarcherData, CpuShadowCacheTexture& shadowCache)
+{
+    shadowCache.Resize(rayMarcherData.ShadowCacheCells, SHADOW_CACHE_LAYERS, rayMarcherData.ShadowCacheCells);
+    m_taskScheduler->ParallelFor(rayMarcherData.ShadowCacheCells, [&](const uint32_t z, const uint32_t workerIndex)
+    {
+        BuildShadowCacheSlice(z, rayMarcherData, shadowCache, m_workerStatistics[workerIndex].Value);
+    });
+}
+
+CpuRayMarcher::Statistics CpuRayMarcher::GetStatistics() const
+{
+    Statistics result{};
+    for (const auto& workerStatistics : m_workerStatistics)
+    {
+        result.PrimaryRays += workerStatistics.Value.PrimaryRays;
+        result.Rays += workerStatistics.Value.Rays;
+        result.Steps += workerStatistics.Value.Steps;
+        result.DistanceEvaluations += workerStatistics.Value.DistanceEvaluations;
+        result.LaneSlots += workerStatistics.Value.LaneSlots;
+        result.RelaxationFallbacks += workerStatistics.Value.RelaxationFallbacks;
+        result.RefinementSteps += workerStatistics.Value.RefinementSteps;
+        result.PrepassSteps += workerStatistics.Value.PrepassSteps;
+        result.ReprojectedRays += workerStatistics.Value.ReprojectedRays;
+        result.UpsampledPixels += workerStatistics.Value.UpsampledPixels;
+        result.ReconstructedPixels += workerStatistics.Value.ReconstructedPixels;
+        result.EdgePixels += workerStatistics.Value.EdgePixels;
+        result.SupersampledPixels += workerStatistics.Value.SupersampledPixels;
+        result.ShadowRays += workerStatistics.Value.ShadowRays;
+        result.ShadowSteps += workerStatistics.Value.ShadowSteps;
+        result.ShadowCacheHits += workerStatistics.Value.ShadowCacheHits;
+        result.ShadowCacheSteps += workerStatistics.Value.ShadowCacheSteps;
+    }
+    return result;
+}
+
+void CpuRayMarcher::ResetStatistics()
+{
+    for (auto& workerStatistics : m_workerStatistics)
+        workerStatistics.Value = {};
+}
+
+// The tiles of a tilesX x tilesY dispatch sorted by the Morton code of their coordinates, cached in order until the
+// dispatch changes size. On a grid of a power of two tiles a side, any run of 4^n tiles from a multiple of 4^n on is a
+// square of tiles.
+const vector<uint32_t>& CpuRayMarcher::GetTileOrder(const uint32_t tilesX, const uint32_t tilesY, TileOrder& order)
+{
+    if (order.TilesX == tilesX && order.TilesY == tilesY)
+        return order.Tiles;
+
+    vector<uint64_t> codes(static_cast<size_t>(tilesX) * tilesY);
+    for (uint32_t tileY = 0; tileY < tilesY; tileY++)
+        for (uint32_t tileX = 0; tileX < tilesX; tileX++)
+        {
+            uint64_t code = 0;
+            for (uint32_t bit = 0; bit < 16; bit++)
+                code |= static_cast<uint64_t>(tileX >> bit & 1) << (2 * bit) |
+                    static_cast<uint64_t>(tileY >> bit & 1) << (2 * bit + 1);
+            const uint32_t tile = tileY * tilesX + tileX;
+            codes[tile] = code << 32 | tile;
+        }
+    sort(codes.begin(), codes.end());
+
+    order.TilesX = tilesX;
+    order.TilesY = tilesY;
+    order.Tiles.resize(codes.size());
+    for (size_t i = 0; i < codes.size(); i++)
+        order.Tiles[i] = static_cast<uint32_t>(codes[i]);
+    return order.Tiles;
+}
+
+// Same as FractalRadio::GetComputerShaderGroupsCount for BLOCK_SIZE.
+uint32_t CpuRayMarcher::GetTilesCount(const uint32_t size)
+{
+    return (size + BLOCK_SIZE - 1) / BLOCK_SIZE;
+}
+
+// Number of bisection steps that shrink a 2 * tolerance bracket below MINIMUM_DISTANCE; zero when the tolerance is
+// already that fine and the hits are not refined.
+int CpuRayMarcher::GetRefinementSteps(const float tolerance)
+{
+    int steps = 0;
+    if (tolerance <= MINIMUM_DISTANCE)
+        return steps;
+
+    for (float width = 2.0f * tolerance; width > MINIMUM_DISTANCE && steps < MAX_REFINEMENT_STEPS; width *= 0.5f)
+        steps++;
+    return steps;
+}
+
+// One thread group of the compute dispatch. The threads march the pixels GetThreadPixel gives them; those outside
+// WindowSize, which may cover only the top left corner of the render targets, are skipped like the writes the shader
+// leaves out.
+void CpuRayMarcher::RenderTile(const uint32_t tileX, const uint32_t tileY, const RayMarcherBuffer& rayMarcherData,
+                               const RenderTargets& renderTargets, Statistics& statistics)
+{
+    const uint32_t width = static_cast<uint32_t>(rayMarcherData.WindowSize.X);
+    const uint32_t height = static_cast<uint32_t>(rayMarcherData.WindowSize.Y);
+
+    float prepassDistances[PREPASS_CELLS * PREPASS_CELLS];
+    MarchPrepass(tileX, tileY, rayMarcherData, prepassDistances, statistics);
+
+    for (uint32_t y = tileY * BLOCK_SIZE; y < (tileY + 1) * BLOCK_SIZE; y++)
+        for (uint32_t x = tileX * BLOCK_SIZE; x < (tileX + 1) * BLOCK_SIZE; x++)
+        {
+            const Uint2 pixel = GetThreadPixel(x, y, rayMarcherData);
+            if (pixel.X >= width || pixel.Y >= height)
+                continue;
+
+            const uint32_t cell = (y % BLOCK_SIZE) / PREPASS_CELL_SIZE * PREPASS_CELLS +
+                (x % BLOCK_SIZE) / PREPASS_CELL_SIZE;
+            ShadePixel(pixel.X, pixel.Y, prepassDistances[cell], rayMarcherData, renderTargets, statistics);
+        }
+}
+
+// One thread group of the Upsample.hlsl dispatch, for the full resolution pixels of tile (tileX, tileY). The pixels
+// between the marched ones are a joint bilateral interpolation of the marched pixels around them: bilinear weights,
+// divided by one plus the distance of each depth from the bilinear depth in units of UPSAMPLE_DEPTH_RATIO. When the
+// marched pixels disagree on whether the ray hit, their depths differ by more than the ratio UPSAMPLE_DEPTH_RATIO, the
+// dot product of their normals falls below UPSAMPLE_NORMAL_DOT or their colors differ by more than UPSAMPLE_COLOR_STEP,
+// which catches the shadow edges on flat ground, the pixel is marched at full resolution instead.
+void CpuRayMarcher::UpsampleTile(const uint32_t tileX, const uint32_t tileY, const RayMarcherBuffer& rayMarcherData,
+                                 const RenderTargets& renderTargets, Statistics& statistics)
+{
+    const uint32_t width = static_cast<uint32_t>(rayMarcherData.WindowSize.X);
+    const uint32_t height = static_cast<uint32_t>(rayMarcherData.WindowSize.Y);
+    const uint32_t halfWidth = (width + 1) / 2;
+    const uint32_t halfHeight = (height + 1) / 2;
+    const uint32_t endX = min((tileX + 1) * BLOCK_SIZE, width);
+    const uint32_t endY = min((tileY + 1) * BLOCK_SIZE, height);
+
+    RayMarcherBuffer fullData = rayMarcherData;
+    fullData.HalfResolution = 0;
+
+    for (uint32_t y = tileY * BLOCK_SIZE; y < endY; y++)
+        for (uint32_t x = tileX * BLOCK_SIZE; x < endX; x++)
+        {
+            // The marched pixels around this one, at half resolution coordinates first and last, which coincide
+            // along an even coordinate or the last column or row.
+            const uint32_t firstX = x / 2;
+            const uint32_t firstY = y / 2;
+            const uint32_t lastX = min((x + 1) / 2, halfWidth - 1);
+            const uint32_t lastY = min((y + 1) / 2, halfHeight - 1);
+            const float lastWeightX = firstX == lastX ? 0.0f : 0.5f;
+            const float lastWeightY = firstY == lastY ? 0.0f : 0.5f;
+
+            float weights[4];
+            Float4 colors[4];
+            Float4 geometries[4];
+            uint32_t hits = 0;
+            uint32_t count = 0;
+            float depthReference = 0.0f;
+            float weightSum = 0.0f;
+            for (uint32_t corner = 0; corner < 4; corner++)
+            {
+                const float weight = ((corner & 1) ? lastWeightX : 1.0f - lastWeightX) *
+                    ((corner & 2) ? lastWeightY : 1.0f - lastWeightY);
+                if (weight <= 0.0f)
+                    continue;
+
+                const uint32_t halfX = (corner & 1) ? lastX : firstX;
+                const uint32_t halfY = (corner & 2) ? lastY : firstY;
+                weights[count] = weight;
+                colors[count] = renderTargets.HalfColor->Load(halfX, halfY);
+                geometries[count] = renderTargets.HalfGeometry->Load(halfX, halfY);
+                if (geometries[count].W > 0.0f)
+                    hits++;
+                depthReference += weight * geometries[count].W;
+                weightSum += weight;
+                count++;
+            }
+            depthReference /= weightSum;
+
+            bool remarch = hits != 0 && hits != count;
+            if (hits == count)
+            {
+                float minDepth = geometries[0].W;
+                float maxDepth = geometries[0].W;
+                for (uint32_t i = 1; i < count; i++)
+                {
+                    minDepth = min(minDepth, geometries[i].W);
+                    maxDepth = max(maxDepth, geometries[i].W);
+                    const float normalDot = geometries[i].X * geometries[0].X + geometries[i].Y * geometries[0].Y +
+                        geometries[i].Z * geometries[0].Z;
+                    if (normalDot < UPSAMPLE_NORMAL_DOT || fabs(colors[i].X - colors[0].X) > UPSAMPLE_COLOR_STEP)
+                        remarch = true;
+                }
+                if (maxDepth > minDepth * (1.0f + UPSAMPLE_DEPTH_RATIO))
+                    remarch = true;
+            }
+
+            if (remarch)
+            {
+                ShadePixel(x, y, 0.0f, fullData, renderTargets, statistics);
+                continue;
+            }
+
+            // Misses keep the bilinear weights.
+            Float4 color = { 0.0f, 0.0f, 0.0f, 0.0f };
+            Float4 geometry = { 0.0f, 0.0f, 0.0f, 0.0f };
+            float rangeWeightSum = 0.0f;
+            for (uint32_t i = 0; i < count; i++)
+            {
+                float weight = weights[i];
+                if (hits)
+                    weight /= 1.0f + fabs(geometries[i].W - depthReference) / (UPSAMPLE_DEPTH_RATIO * depthReference);
+                color = { color.X + weight * colors[i].X, color.Y + weight * colors[i].Y,
+                          color.Z + weight * colors[i].Z, color.W + weight * colors[i].W };
+                geometry = { geometry.X + weight * geometries[i].X, geometry.Y + weight * geometries[i].Y,
+                             geometry.Z + weight * geometries[i].Z, geometry.W + weight * geometries[i].W };
+                rangeWeightSum += weight;
+            }
+
+            if (count > 1)
+                statistics.UpsampledPixels++;
+
+            const PixelSample pixelSample = {
+                Float3{ color.X / rangeWeightSum, color.Y / rangeWeightSum, color.Z / rangeWeightSum },
+                Float3{ geometry.X / rangeWeightSum, geometry.Y / rangeWeightSum, geometry.Z / rangeWeightSum },
+                geometry.W / rangeWeightSum,
+                color.W / rangeWeightSum
+            };
+            StoreSample(x, y, pixelSample, fullData, renderTargets);
+        }
+}
+
+// One thread group of the Reconstruct.hlsl dispatch, for the full resolution pixels of tile (tileX, tileY) that the
+// interleaved frame did not march. Each follows the nearest hit among its marched neighbours, above and below and in
+// the checkerboard also left and right, into the previous frame and takes the color found there, clamped to the range
+// of the neighbours' colors so that disoccluded and changed pixels cannot bring back stale ones. Where that point is
+// off the previous frame or all the neighbours missed, the pixel is the mean of its neighbours.
+void CpuRayMarcher::ReconstructTile(const uint32_t tileX, const uint32_t tileY, const RayMarcherBuffer& rayMarcherData,
+                                    const RenderTargets& renderTargets, Statistics& statistics)
+{
+    const uint32_t width = static_cast<uint32_t>(rayMarcherData.WindowSize.X);
+    const uint32_t height = static_cast<uint32_t>(rayMarcherData.WindowSize.Y);
+    const uint32_t endX = min((tileX + 1) * BLOCK_SIZE, width);
+    const uint32_t endY = min((tileY + 1) * BLOCK_SIZE, height);
+
+    static const int offsets[4][2] = { { 0, -1 }, { 0, 1 }, { -1, 0 }, { 1, 0 } };
+    const uint32_t numOffsets = rayMarcherData.Interleave == INTERLEAVE_CHECKER ? 4 : 2;
+    const Float3 eye = TransformPoint(Float3{ 0.0f, 0.0f, 0.0f }, rayMarcherData.CameraMatrix);
+
+    for (uint32_t y = tileY * BLOCK_SIZE; y < endY; y++)
+        for (uint32_t x = tileX * BLOCK_SIZE; x < endX; x++)
+        {
+            if (IsMarchedPixel(x, y, rayMarcherData))
+                continue;
+
+            Float3 minColor = { 0.0f, 0.0f, 0.0f };
+            Float3 maxColor = { 0.0f, 0.0f, 0.0f };
+            Float3 meanColor = { 0.0f, 0.0f, 0.0f };
+            uint32_t count = 0;
+            float depth = 0.0f;
+            uint32_t nearestX = x;
+            uint32_t nearestY = y;
+            for (uint32_t i = 0; i < numOffsets; i++)
+            {
+                const int neighbourX = static_cast<int>(x) + offsets[i][0];
+                const int neighbourY = static_cast<int>(y) + offsets[i][1];
+                if (neighbourX < 0 || neighbourY < 0 || neighbourX >= static_cast<int>(width) ||
+                    neighbourY >= static_cast<int>(height))
+                    continue;
+
+                const Float4 history = renderTargets.History->Load(static_cast<uint32_t>(neighbourX),
+                                                                   static_cast<uint32_t>(neighbourY));
+                const Float3 color = { history.X, history.Y, history.Z };
+                minColor = count ? Float3{ min(minColor.X, color.X), min(minColor.Y, color.Y),
+                                           min(minColor.Z, color.Z) }
+                                 : color;
+                maxColor = count ? Float3{ max(maxColor.X, color.X), max(maxColor.Y, color.Y),
+                                           max(maxColor.Z, color.Z) }
+                                 : color;
+                meanColor += color;
+                count++;
+                if (history.W > 0.0f && (depth <= 0.0f || history.W < depth))
+                {
+                    depth = history.W;
+                    nearestX = static_cast<uint32_t>(neighbourX);
+                    nearestY = static_cast<uint32_t>(neighbourY);
+                }
+            }
+
+            // A window a single row high leaves the rows mode without neighbours.
+            if (!count)
+            {
+                ShadePixel(x, y, 0.0f, rayMarcherData, renderTargets, statistics);
+                continue;
+            }
+
+            PixelSample pixelSample = {
+                meanColor / static_cast<float>(count),
+                Float3{ 0.0f, 0.0f, 0.0f },
+                depth,
+                depth > 0.0f && rayMarcherData.Reprojection ? renderTargets.Depth->Load(nearestX, nearestY).Y : 0.0f
+            };
+
+            const Float3 direction = GetRayDirection(static_cast<float>(x), static_cast<float>(y),
+                                                     rayMarcherData.CameraMatrix, rayMarcherData.WindowSize);
+            Float2 previousPixel;
+            if (depth > 0.0f && ProjectToPreviousFrame(eye + depth * direction, rayMarcherData, previousPixel))
+            {
+                // Bilinear filtering over the 2 x 2 footprint, as in Reconstruct.hlsl.
+                const auto footprintX = static_cast<uint32_t>(previousPixel.X);
+                const auto footprintY = static_cast<uint32_t>(previousPixel.Y);
+                const float weightX = previousPixel.X - static_cast<float>(footprintX);
+                const float weightY = previousPixel.Y - static_cast<float>(footprintY);
+                Float3 previous = { 0.0f, 0.0f, 0.0f };
+                for (uint32_t corner = 0; corner < 4; corner++)
+                {
+                    const Float4 history = renderTargets.PreviousHistory->Load(footprintX + corner % 2,
+                                                                               footprintY + corner / 2);
+                    const float weight = (corner % 2 ? weightX : 1.0f - weightX) *
+                        (corner / 2 ? weightY : 1.0f - weightY);
+                    previous += weight * Float3{ history.X, history.Y, history.Z };
+                }
+                pixelSample.Color = Float3{ min(max(previous.X, minColor.X), maxColor.X),
+                                            min(max(previous.Y, minColor.Y), maxColor.Y),
+                                            min(max(previous.Z, minColor.Z), maxColor.Z) };
+                statistics.ReconstructedPixels++;
+            }
+
+            StoreSample(x, y, pixelSample, rayMarcherData, renderTargets);
+        }
+}
+
+// One thread group of the Lighting.hlsl dispatch: shades the primary hits of tile (tileX, tileY) in the G-buffer and
+// stores them like the forward march does.
+void CpuRayMarcher::LightTile(const uint32_t tileX, const uint32_t tileY, const RayMarcherBuffer& rayMarcherData,
+                              const RenderTargets& renderTargets, Statistics& statistics)
+{
+    const uint32_t endX = min((tileX + 1) * BLOCK_SIZE, static_cast<uint32_t>(rayMarcherData.WindowSize.X));
+    const uint32_t endY = min((tileY + 1) * BLOCK_SIZE, static_cast<uint32_t>(rayMarcherData.WindowSize.Y));
+
+    for (uint32_t y = tileY * BLOCK_SIZE; y < endY; y++)
+        for (uint32_t x = tileX * BLOCK_SIZE; x < endX; x++)
+            StoreSample(x, y, LightPixel(x, y, rayMarcherData, renderTargets, statistics), rayMarcherData,
+                        renderTargets);
+}
+
+// One thread group of the EdgeHistogram.hlsl dispatch: adds the pixels of tile (tileX, tileY) to the histogram of
+// their GetEdgeBucket.
+void CpuRayMarcher::CountEdgesTile(const uint32_t tileX, const uint32_t tileY, const RayMarcherBuffer& rayMarcherData,
+                                   const RenderTargets& renderTargets, uint32_t* edgeHistogram, Statistics& statistics)
+{
+    const uint32_t endX = min((tileX + 1) * BLOCK_SIZE, static_cast<uint32_t>(rayMarcherData.WindowSize.X));
+    const uint32_t endY = min((tileY + 1) * BLOCK_SIZE, static_cast<uint32_t>(rayMarcherData.WindowSize.Y));
+
+    for (uint32_t y = tileY * BLOCK_SIZE; y < endY; y++)
+        for (uint32_t x = tileX * BLOCK_SIZE; x < endX; x++)
+        {
+            const uint32_t bucket = GetEdgeBucket(GetEdgeStrength(x, y, rayMarcherData, renderTargets));
+            edgeHistogram[bucket]++;
+            if (bucket)
+                statistics.EdgePixels++;
+        }
+}
+
+// One thread group of the Supersample.hlsl dispatch, for the full resolution pixels of tile (tileX, tileY). The pixels
+// in supersampledBucket and above average their centre sample with SUPERSAMPLES - 1 more rays at the jittered offsets
+// of the accumulated samples. The extra rays march from the camera plane without reprojection, like those of a still
+// view, are shaded as they go in the deferred mode too, and on the CPU always run in scalar code, so the result stays
+// identical across instruction sets.
+void CpuRayMarcher::SupersampleTile(const uint32_t tileX, const uint32_t tileY, const RayMarcherBuffer& rayMarcherData,
+                                    const RenderTargets& renderTargets, const uint32_t supersampledBucket,
+                                    Statistics& statistics)
+{
+    const uint32_t endX = min((tileX + 1) * BLOCK_SIZE, static_cast<uint32_t>(rayMarcherData.WindowSize.X));
+    const uint32_t endY = min((tileY + 1) * BLOCK_SIZE, static_cast<uint32_t>(rayMarcherData.WindowSize.Y));
+
+    RayMarcherBuffer sampleData = rayMarcherData;
+    sampleData.Reprojection = 0;
+    sampleData.Deferred = 0;
+
+    for (uint32_t y = tileY * BLOCK_SIZE; y < endY; y++)
+        for (uint32_t x = tileX * BLOCK_SIZE; x < endX; x++)
+        {
+            if (GetEdgeBucket(GetEdgeStrength(x, y, rayMarcherData, renderTargets)) < supersampledBucket)
+                continue;
+
+            const Float4 centre = renderTargets.Color->Load(x, y);
+            Float3 color = { centre.X, centre.Y, centre.Z };
+            for (uint32_t sampleIndex = 1; sampleIndex < SUPERSAMPLES; sampleIndex++)
+            {
+                sampleData.SampleIndex = sampleIndex;
+                color += MarchPixel(x, y, 0.0f, sampleData, renderTargets, statistics).Color;
+            }
+
+            color = color / static_cast<float>(SUPERSAMPLES);
+            StoreColor(x, y, Float4{ color.X, color.Y, color.Z, 1.0f }, rayMarcherData, renderTargets);
+            statistics.SupersampledPixels++;
+        }
+}
+
+// Lowest edge bucket whose pixels fit in SupersampleBudget, in extra rays per pixel, along with all the stronger
+// ones: the budget goes to the strongest edges of the frame first, whole buckets at a time. A budget of
+// SUPERSAMPLES - 1 rays per pixel fits bucket zero, the pixels off the edges, too and is plain supersampling of the
+// whole frame.
+uint32_t CpuRayMarcher::GetSupersampledBucket(const RayMarcherBuffer& rayMarcherData, const uint32_t* edgeHistogram)
+{
+    const auto budget = static_cast<uint32_t>(rayMarcherData.SupersampleBudget /
+                                              static_cast<float>(SUPERSAMPLES - 1) * rayMarcherData.WindowSize.X *
+                                              rayMarcherData.WindowSize.Y);
+    uint32_t pixels = 0;
+    uint32_t bucket = EDGE_BUCKETS;
+    while (bucket > 0 && pixels + edgeHistogram[bucket - 1] <= budget)
+    {
+        bucket--;
+        pixels += edgeHistogram[bucket];
+    }
+    return bucket;
+}
+
+// Largest difference between pixel (x, y) and its neighbours in the G-buffer, in units of the thresholds: color by
+// EDGE_COLOR_STEP, depth by the ratio EDGE_DEPTH_RATIO with misses as hits at MAX_CAMERA_DEPTH, and when both hit
+// normal by a dot product of EDGE_NORMAL_DOT and ambient occlusion steps by EDGE_STEP_DIFFERENCE. 1 or more is an edge.
+float CpuRayMarcher::GetEdgeStrength(const uint32_t x, const uint32_t y, const RayMarcherBuffer& rayMarcherData,
+                                     const RenderTargets& renderTargets)
+{
+    const int width = static_cast<int>(rayMarcherData.WindowSize.X);
+    const int height = static_cast<int>(rayMarcherData.WindowSize.Y);
+    static const int offsets[4][2] = { { 0, -1 }, { 0, 1 }, { -1, 0 }, { 1, 0 } };
+
+    const Float4 color = renderTargets.Color->Load(x, y);
+    const Float4 geometry = renderTargets.Geometry->Load(x, y);
+    const float depth = geometry.W > 0.0f ? geometry.W : MAX_CAMERA_DEPTH;
+
+    float strength = 0.0f;
+    for (const auto& offset : offsets)
+    {
+        const int neighbourX = static_cast<int>(x) + offset[0];
+        const int neighbourY = static_cast<int>(y) + offset[1];
+        if (neighbourX < 0 || neighbourY < 0 || neighbourX >= width || neighbourY >= height)
+            continue;
+
+        const Float4 neighbourColor = renderTargets.Color->Load(static_cast<uint32_t>(neighbourX),
+                                                                static_cast<uint32_t>(neighbourY));
+        const Float4 neighbourGeometry = renderTargets.Geometry->Load(static_cast<uint32_t>(neighbourX),
+                                                                      static_cast<uint32_t>(neighbourY));
+        const float neighbourDepth = neighbourGeometry.W > 0.0f ? neighbourGeometry.W : MAX_CAMERA_DEPTH;
+
+        const float colorStep = max(fabs(neighbourColor.X - color.X),
+                                    max(fabs(neighbourColor.Y - color.Y), fabs(neighbourColor.Z - color.Z)));
+        strength = max(strength, colorStep / EDGE_COLOR_STEP);
+        strength = max(strength, fabs(neighbourDepth - depth) / (EDGE_DEPTH_RATIO * min(depth, neighbourDepth)));
+        if (geometry.W > 0.0f && neighbourGeometry.W > 0.0f)
+        {
+            const float normalDot = neighbourGeometry.X * geometry.X + neighbourGeometry.Y * geometry.Y +
+                neighbourGeometry.Z * geometry.Z;
+            strength = max(strength, (1.0f - normalDot) / (1.0f - EDGE_NORMAL_DOT));
+            strength = max(strength, fabs(neighbourColor.W - color.W) / EDGE_STEP_DIFFERENCE);
+        }
+    }
+
+    return strength;
+}
+
+// Histogram bucket of an edge strength: 0 for pixels that are not on an edge, then a quarter octave of strength each.
+uint32_t CpuRayMarcher::GetEdgeBucket(const float strength)
+{
+    if (strength < 1.0f)
+        return 0;
+    return 1 + min(static_cast<uint32_t>(4.0f * log2(strength)), EDGE_BUCKETS - 2);
+}
+
+// Low resolution prepass of a tile, the groupshared step of the compute shader: one cone per PREPASS_CELL_SIZE x
+// PREPASS_CELL_SIZE cell, storing for each cell the distance from the eye up to which all its primary rays are in
+// empty space. Without Prepass the distances are zero and the rays start on the camera plane.
+void CpuRayMarcher::MarchPrepass(const uint32_t tileX, const uint32_t tileY, const RayMarcherBuffer& rayMarcherData,
+                                 float* distances, Statistics& statistics)
+{
+    for (uint32_t cellY = 0; cellY < PREPASS_CELLS; cellY++)
+        for (uint32_t cellX = 0; cellX < PREPASS_CELLS; cellX++)
+        {
+            // The cone follows the ray halfway between the pixels of the cell's first and last threads.
+            const uint32_t firstX = tileX * BLOCK_SIZE + cellX * PREPASS_CELL_SIZE;
+            const uint32_t firstY = tileY * BLOCK_SIZE + cellY * PREPASS_CELL_SIZE;
+            const Uint2 first = GetThreadPixel(firstX, firstY, rayMarcherData);
+            const Uint2 last = GetThreadPixel(firstX + PREPASS_CELL_SIZE - 1, firstY + PREPASS_CELL_SIZE - 1,
+                                              rayMarcherData);
+            const float x = static_cast<float>(first.X + last.X) * 0.5f;
+            const float y = static_cast<float>(first.Y + last.Y) * 0.5f;
+
+            distances[cellY * PREPASS_CELLS + cellX] =
+                rayMarcherData.Prepass ? ConeMarch(x, y, rayMarcherData, statistics) : 0.0f;
+        }
+}
+
+// Distance in pixels between the primary rays of neighbouring threads of the ray marcher.
+Uint2 CpuRayMarcher::GetPixelSpacing(const RayMarcherBuffer& rayMarcherData)
+{
+    if (rayMarcherData.HalfResolution)
+        return Uint2{ 2, 2 };
+    if (rayMarcherData.Interleave == INTERLEAVE_CHECKER)
+        return Uint2{ 2, 1 };
+    if (rayMarcherData.Interleave == INTERLEAVE_ROWS)
+        return Uint2{ 1, 2 };
+    return Uint2{ 1, 1 };
+}
+
+// Pixel whose primary ray the thread (x, y) marches: every other pixel of every other row at half resolution, and in
+// the interleaved modes the half of the pixels of a checkerboard or of the rows that alternates with FrameIndex.
+Uint2 CpuRayMarcher::GetThreadPixel(const uint32_t x, const uint32_t y, const RayMarcherBuffer& rayMarcherData)
+{
+    const Uint2 pixelSpacing = GetPixelSpacing(rayMarcherData);
+    Uint2 pixel = { x * pixelSpacing.X, y * pixelSpacing.Y };
+    if (rayMarcherData.Interleave == INTERLEAVE_CHECKER)
+        pixel.X += (y + rayMarcherData.FrameIndex) & 1;
+    else if (rayMarcherData.Interleave == INTERLEAVE_ROWS)
+        pixel.Y += rayMarcherData.FrameIndex & 1;
+    return pixel;
+}
+
+// Whether an interleaved frame marches pixel (x, y) itself rather than reconstructing it.
+bool CpuRayMarcher::IsMarchedPixel(const uint32_t x, const uint32_t y, const RayMarcherBuffer& rayMarcherData)
+{
+    if (rayMarcherData.Interleave == INTERLEAVE_CHECKER)
+        return ((x + y + rayMarcherData.FrameIndex) & 1) == 0;
+    if (rayMarcherData.Interleave == INTERLEAVE_ROWS)
+        return ((y + rayMarcherData.FrameIndex) & 1) == 0;
+    return true;
+}
+
+// Sub-pixel offset of the primary rays of sample sampleIndex of a still view. The first sample goes through the pixel
+// centres like a plain frame; the next ones follow the (2, 3) Halton sequence over the pixel, so the average converges
+// to the box filtered image.
+Float2 CpuRayMarcher::GetSampleOffset(const uint32_t sampleIndex)
+{
+    if (!sampleIndex)
+        return Float2{ 0.0f, 0.0f };
+
+    return Float2{ Halton(sampleIndex, 2) - 0.5f, Halton(sampleIndex, 3) - 0.5f };
+}
+
+// Writes the sample of pixel (x, y) either to the half resolution G-buffer or to the output, and the depth for the
+// next frame's reprojection, the history for the next interleaved frame and the G-buffer for supersampling.
+void CpuRayMarcher::StoreSample(const uint32_t x, const uint32_t y, const PixelSample& pixelSample,
+                                const RayMarcherBuffer& rayMarcherData, const RenderTargets& renderTargets)
+{
+    if (rayMarcherData.HalfResolution)
+    {
+        renderTargets.HalfColor->Store(x / 2, y / 2, Float4{ pixelSample.Color.X, pixelSample.Color.Y,
+                                                             pixelSample.Color.Z, pixelSample.Steps });
+        renderTargets.HalfGeometry->Store(x / 2, y / 2, Float4{ pixelSample.Normal.X, pixelSample.Normal.Y,
+                                                                pixelSample.Normal.Z, pixelSample.Depth });
+        return;
+    }
+
+    StoreColor(x, y, Float4{ pixelSample.Color.X, pixelSample.Color.Y, pixelSample.Color.Z, 1.0f }, rayMarcherData,
+               renderTargets);
+    if (rayMarcherData.Reprojection)
+        renderTargets.Depth->Store(x, y, Float2{ pixelSample.Depth, pixelSample.Steps });
+    if (rayMarcherData.Interleave)
+        renderTargets.History->Store(x, y, Float4{ pixelSample.Color.X, pixelSample.Color.Y, pixelSample.Color.Z,
+                                                   pixelSample.Depth });
+    if (rayMarcherData.SupersampleBudget > 0.0f)
+    {
+        renderTargets.Color->Store(x, y, Float4{ pixelSample.Color.X, pixelSample.Color.Y, pixelSample.Color.Z,
+                                                 pixelSample.Steps });
+        renderTargets.Geometry->Store(x, y, Float4{ pixelSample.Normal.X, pixelSample.Normal.Y, pixelSample.Normal.Z,
+                                                    pixelSample.Depth });
+    }
+}
+
+// Writes the primary hit of a deferred march through pixel (x, y) to the G-buffer, from which the LightTile pass stores
+// the rest.
+void CpuRayMarcher::StoreGeometry(const uint32_t x, const uint32_t y, const PixelSample& pixelSample,
+                                  const RayMarcherBuffer& rayMarcherData, const RenderTargets& renderTargets)
+{
+    uint32_t material = MATERIAL_NONE;
+    if (pixelSample.Depth > 0.0f)
+    {
+        const Float3 eye = TransformPoint(Float3{ 0.0f, 0.0f, 0.0f }, rayMarcherData.CameraMatrix);
+        material = GetMaterial(eye + pixelSample.Depth * GetSampleDirection(x, y, rayMarcherData.SampleIndex,
+                                                                              rayMarcherData));
+    }
+    renderTargets.GBuffer->Store(x, y, PackGBuffer(pixelSample, material));
+}
+
+// Writes the color of pixel (x, y) to the output. With Accumulation the color is also added to the sum of the earlier
+// samples of the view, which restarts at SampleIndex zero, and the output receives their average instead.
+void CpuRayMarcher::StoreColor(const uint32_t x, const uint32_t y, const Float4& color,
+                               const RayMarcherBuffer& rayMarcherData, const RenderTargets& renderTargets)
+{
+    if (!rayMarcherData.Accumulation)
+    {
+        renderTargets.Output->Store(x, y, color);
+        return;
+    }
+
+    Float4 sum = color;
+    if (rayMarcherData.SampleIndex)
+    {
+        const Float4 previousSum = renderTargets.Accumulation->Load(x, y);
+        sum = Float4{ previousSum.X + color.X, previousSum.Y + color.Y, previousSum.Z + color.Z,
+                      previousSum.W + color.W };
+    }
+    renderTargets.Accumulation->Store(x, y, sum);
+
+    const auto samples = static_cast<float>(rayMarcherData.SampleIndex + 1);
+    renderTargets.Output->Store(x, y, Float4{ sum.X / samples, sum.Y / samples, sum.Z / samples, sum.W / samples });
+}
+
+void CpuRayMarcher::EvaluateDistances(const float* xs, const float* ys, const float* zs, float* distances,
+                                      const uint32_t count)
+{
+    for (uint32_t i = 0; i < count; i++)
+        distances[i] = DistanceEstimator(Float3{ xs[i], ys[i], zs[i] });
+}
+
+float CpuRayMarcher::SphereEstimator(const Float3& crtPosition, const Float3& spherePosition, const float radius)
+{
+    return Length(crtPosition - spherePosition) - radius;
+}
+
+float CpuRayMarcher::SpheresEstimator(const Float3& crtPosition, const Float3& spherePosition)
+{
+    Float3 z = crtPosition - spherePosition;
+    z.X = fmod(z.X, 1.0f) - 0.5f;
+    z.Z = fmod(z.Z, 1.0f) - 0.5f;
+    return Length(z) - 0.3f;
+}
+
+float CpuRayMarcher::Sierpinski(const Float3& crtPosition, const Float3& tetrahedronPosition)
+{
+    Float3 z = crtPosition - tetrahedronPosition;
+
+    int n = 0;
+    const float scale = 2.0f;
+    while (n < SIERPINSKI_ITERATIONS)
+    {
+        if (z.X + z.Y < 0) z = { -z.Y, -z.X, z.Z }; // fold 1
+        if (z.X + z.Z < 0) z = { -z.Z, z.Y, -z.X }; // fold 2
+        if (z.Y + z.Z < 0) z = { z.X, -z.Z, -z.Y }; // fold 3
+        z = z * scale - Float3{ 1.0f, 1.0f, 1.0f } * (scale - 1.0f);
+        n++;
+    }
+    return Length(z) * pow(scale, -static_cast<float>(n));
+}
+
+float CpuRayMarcher::YPlane(const Float3& crtPosition, const float y)
+{
+    return crtPosition.Y - y;
+}
+
+float CpuRayMarcher::DistanceEstimator(const Float3& position)
+{
+    return min(SpheresEstimator(position, Float3{ 0.0f, 1.0f, 3.0f }), YPlane(position, -1.0f));
+}
+
+DualFloat CpuRayMarcher::SphereEstimator(const DualFloat3& crtPosition, const Float3& spherePosition,
+                                         const float radius)
+{
+    return Length(crtPosition - spherePosition) - radius;
+}
+
+// fmod only shifts the value, so the repetition leaves the Jacobian untouched.
+DualFloat CpuRayMarcher::SpheresEstimator(const DualFloat3& crtPosition, const Float3& spherePosition)
+{
+    DualFloat3 z = crtPosition - spherePosition;
+    z.Value.X = fmod(z.Value.X, 1.0f) - 0.5f;
+    z.Value.Z = fmod(z.Value.Z, 1.0f) - 0.5f;
+    return Length(z) - 0.3f;
+}
+
+// The folds are reflections, so they permute and negate the rows of the Jacobian along with the components.
+DualFloat CpuRayMarcher::Sierpinski(const DualFloat3& crtPosition, const Float3& tetrahedronPosition)
+{
+    DualFloat3 z = crtPosition - tetrahedronPosition;
+
+    int n = 0;
+    const float scale = 2.0f;
+    while (n < SIERPINSKI_ITERATIONS)
+    {
+        if (z.Value.X + z.Value.Y < 0) // fold 1
+            z = { { -z.Value.Y, -z.Value.X, z.Value.Z }, -z.GradientY, -z.GradientX, z.GradientZ };
+        if (z.Value.X + z.Value.Z < 0) // fold 2
+            z = { { -z.Value.Z, z.Value.Y, -z.Value.X }, -z.GradientZ, z.GradientY, -z.GradientX };
+        if (z.Value.Y + z.Value.Z < 0) // fold 3
+            z = { { z.Value.X, -z.Value.Z, -z.Value.Y }, z.GradientX, -z.GradientZ, -z.GradientY };
+        z = z * scale - Float3{ 1.0f, 1.0f, 1.0f } * (scale - 1.0f);
+        n++;
+    }
+    return Length(z) * pow(scale, -static_cast<float>(n));
+}
+
+DualFloat CpuRayMarcher::YPlane(const DualFloat3& crtPosition, const float y)
+{
+    return { crtPosition.Value.Y - y, crtPosition.GradientY };
+}
+
+DualFloat CpuRayMarcher::DistanceEstimator(const DualFloat3& position)
+{
+    return Min(SpheresEstimator(position, Float3{ 0.0f, 1.0f, 3.0f }), YPlane(position, -1.0f));
+}
+
+// Moves the ray forward after evaluating distance at the current point. The step is distance * Relaxation; when
+// the unbounding sphere at the new point does not overlap the previous one, the relaxed step may have skipped a
+// surface, so it is undone, replaced by the plain sphere tracing step and the ray continues without relaxation.
+// Returns false for an undone step, whose distance must not be used for the hit test. With Relaxation == 1 this is
+// exactly the classic tracer.
+bool CpuRayMarcher::Advance(const float distance, MarchState& state, Statistics& statistics)
+{
+    if (state.Relaxation > 1.0f && fabs(distance) + state.PreviousDistance < state.StepLength)
+    {
+        statistics.RelaxationFallbacks++;
+        state.TotalDistance = state.TotalDistance - state.StepLength + state.PreviousDistance;
+        state.StepLength = state.PreviousDistance;
+        state.Relaxation = 1.0f;
+        return false;
+    }
+
+    state.StepLength = distance * state.Relaxation;
+    state.PreviousDistance = distance;
+    state.TotalDistance += state.StepLength;
+    return true;
+}
+
+// Radical inverse of index in base: the index-th element of the Halton sequence of that base.
+float CpuRayMarcher::Halton(uint32_t index, const uint32_t base)
+{
+    float result = 0.0f;
+    float fraction = 1.0f;
+    while (index > 0)
+    {
+        fraction /= static_cast<float>(base);
+        result += fraction * static_cast<float>(index % base);
+        index /= base;
+    }
+    return result;
+}
+
+// Fraction of the light that reaches from along direction. With ShadowSoftness the march also keeps the smallest
+// ShadowSoftness * distance / travelled ratio, the penumbra, and stops once that is below SHADOW_OPAQUE.
+float CpuRayMarcher::TraceShadow(const Float3& from, const Float3& direction, const RayMarcherBuffer& rayMarcherData,
+                                 Statistics& statistics)
+{
+    statistics.Rays++;
+    statistics.ShadowRays++;
+
+    MarchState state = { 0.0f, 0.0f, 0.0f, rayMarcherData.OverRelaxation };
+    float visibility = 1.0f;
+    for (int steps = 0; steps < MAX_STEPS; steps++)
+    {
+        const float crtDistance = state.TotalDistance;
+        const Float3 crtPoint = from + crtDistance * direction;
+        const float distance = DistanceEstimator(crtPoint);
+        statistics.Steps++;
+        statistics.ShadowSteps++;
+        statistics.DistanceEvaluations++;
+        statistics.LaneSlots++;
+        if (!Advance(distance, state, statistics))
+            continue;
+        if (distance < MINIMUM_DISTANCE)
+            return 0.0f;
+        if (distance > MAX_CAMERA_DEPTH)
+            return visibility;
+        if (rayMarcherData.ShadowSoftness > 0.0f && crtDistance > 0.0f)
+        {
+            visibility = min(visibility, rayMarcherData.ShadowSoftness * distance / crtDistance);
+            if (visibility < SHADOW_OPAQUE)
+                return 0.0f;
+        }
+    }
+
+    return visibility;
+}
+
+// Visibility of the light from a hit: the shader stores normalize(-g_lightDirection) into a float, which keeps only the
+// x component, so the shadow ray starts and travels along (1, 1, 1) * x. Kept as-is to match the GPU output.
+float CpuRayMarcher::MarchShadow(const Float3& hitPoint, const RayMarcherBuffer& rayMarcherData,
+                                 Statistics& statistics)
+{
+    const float lightDirection = Normalize(-rayMarcherData.LightDirection).X;
+    return TraceShadow(hitPoint + lightDirection * 1.0f, Float3{ lightDirection, lightDirection, lightDirection },
+                       rayMarcherData, statistics);
+}
+
+// Marches the shadows of the texels of slice z of the shadow cache. Their steps are the cost of the cache rather than
+// of a frame, so they only count as ShadowCacheSteps.
+void CpuRayMarcher::BuildShadowCacheSlice(const uint32_t z, const RayMarcherBuffer& rayMarcherData,
+                                          CpuShadowCacheTexture& shadowCache, Statistics& statistics)
+{
+    Statistics sliceStatistics{};
+    for (uint32_t y = 0; y < shadowCache.GetHeight(); y++)
+        for (uint32_t x = 0; x < shadowCache.GetWidth(); x++)
+        {
+            const Float3 texel = {
+                static_cast<float>(x), static_cast<float>(y), static_cast<float>(z)
+            };
+            const float visibility = MarchShadow(rayMarcherData.ShadowCacheOrigin +
+                                                 texel * rayMarcherData.ShadowCacheCellSize,
+                                                 rayMarcherData, sliceStatistics);
+            shadowCache.Store(x, y, z, static_cast<uint8_t>(visibility * 255.0f + 0.5f));
+        }
+    statistics.ShadowCacheSteps += sliceStatistics.ShadowSteps;
+}
+
+// MarchShadow interpolated trilinearly between the texels of the shadow cache around hitPoint, or -1 when the cache is
+// off or hitPoint is not inside it. The texels read like DXGI_FORMAT_R8_UNORM ones.
+float CpuRayMarcher::LookUpShadowCache(const Float3& hitPoint, const RayMarcherBuffer& rayMarcherData,
+                                       const CpuShadowCacheTexture& shadowCache)
+{
+    if (rayMarcherData.ShadowCacheCellSize <= 0.0f)
+        return -1.0f;
+
+    const Float3 texel = (hitPoint - rayMarcherData.ShadowCacheOrigin) / rayMarcherData.ShadowCacheCellSize;
+    const float lastColumn = static_cast<float>(rayMarcherData.ShadowCacheCells) - 1.0f;
+    const float lastLayer = static_cast<float>(SHADOW_CACHE_LAYERS) - 1.0f;
+    if (texel.X < 0.0f || texel.Y < 0.0f || texel.Z < 0.0f ||
+        texel.X >= lastColumn || texel.Y >= lastLayer || texel.Z >= lastColumn)
+        return -1.0f;
+
+    const uint32_t x = static_cast<uint32_t>(texel.X);
+    const uint32_t y = static_cast<uint32_t>(texel.Y);
+    const uint32_t z = static_cast<uint32_t>(texel.Z);
+    const Float3 weight = {
+        texel.X - static_cast<float>(x), texel.Y - static_cast<float>(y), texel.Z - static_cast<float>(z)
+    };
+    const auto load = [&](const uint32_t dx, const uint32_t dy, const uint32_t dz)
+    {
+        return static_cast<float>(shadowCache.Load(x + dx, y + dy, z + dz)) / 255.0f;
+    };
+
+    const Float4 lower = { load(0, 0, 0), load(1, 0, 0), load(0, 1, 0), load(1, 1, 0) };
+    const Float4 upper = { load(0, 0, 1), load(1, 0, 1), load(0, 1, 1), load(1, 1, 1) };
+    const Float4 row = {
+        lower.X + (upper.X - lower.X) * weight.Z, lower.Y + (upper.Y - lower.Y) * weight.Z,
+        lower.Z + (upper.Z - lower.Z) * weight.Z, lower.W + (upper.W - lower.W) * weight.Z
+    };
+    const Float2 column = { row.X + (row.Z - row.X) * weight.Y, row.Y + (row.W - row.Y) * weight.Y };
+    return column.X + (column.Y - column.X) * weight.X;
+}
+
+// Origin of a shadow cache of cells x cells texels around eye. It moves in steps of a quarter of the cache, so that the
+// cache is rebuilt only when the eye strays that far from its centre, and stays on the grid of the texels.
+Float3 CpuRayMarcher::GetShadowCacheOrigin(const Float3& eye, const uint32_t cells, const float cellSize)
+{
+    const float step = static_cast<float>(max(cells / 4, 1u)) * cellSize;
+    const float half = static_cast<float>(cells / 2) * cellSize;
+    return Float3{
+        round(eye.X / step) * step - half,
+        SHADOW_CACHE_BOTTOM,
+        round(eye.Z / step) * step - half
+    };
+}
+
+// Visibility of the light from a hit, from the shadow cache where it covers the hit.
+float CpuRayMarcher::ShadowVisibility(const Float3& hitPoint, const RayMarcherBuffer& rayMarcherData,
+                                      const CpuShadowCacheTexture& shadowCache, Statistics& statistics)
+{
+    const float cached = LookUpShadowCache(hitPoint, rayMarcherData, shadowCache);
+    if (cached >= 0.0f)
+    {
+        statistics.ShadowCacheHits++;
+        return cached;
+    }
+    return MarchShadow(hitPoint, rayMarcherData, statistics);
+}
+
+// Primary and reflection rays stop as soon as the distance drops below HitTolerance instead of creeping towards
+// MINIMUM_DISTANCE. The surface crossing is then bracketed between the hit and 2 * HitTolerance further along the ray
+// and bisected down to MINIMUM_DISTANCE; the outer end of the bracket is returned so the point stays in front of the
+// surface like a classic hit. Rays that start inside or graze the surface without crossing it keep the coarse hit.
+Float3 CpuRayMarcher::RefineHit(const Float3& from, const Float3& direction, const float hitDistance,
+                                const float distance, const RayMarcherBuffer& rayMarcherData, Statistics& statistics)
+{
+    const Float3 hitPoint = from + hitDistance * direction;
+
+    const int refinementSteps = GetRefinementSteps(rayMarcherData.HitTolerance);
+    if (!refinementSteps || distance < 0.0f)
+        return hitPoint;
+
+    float nearDistance = hitDistance;
+    float farDistance = hitDistance + 2.0f * rayMarcherData.HitTolerance;
+
+    statistics.RefinementSteps++;
+    statistics.DistanceEvaluations++;
+    if (!(DistanceEstimator(from + farDistance * direction) < 0.0f))
+        return hitPoint;
+
+    for (int step = 0; step < refinementSteps; step++)
+    {
+        const float middleDistance = (nearDistance + farDistance) * 0.5f;
+        statistics.RefinementSteps++;
+        statistics.DistanceEvaluations++;
+        if (DistanceEstimator(from + middleDistance * direction) < 0.0f)
+            farDistance = middleDistance;
+        else
+            nearDistance = middleDistance;
+    }
+
+    return from + nearDistance * direction;
+}
+
+// Surface normal at a hit. By default it is the tetrahedral central difference of the shader, which costs four
+// distance evaluations; with AnalyticNormals it is the gradient of the dual estimator, a single evaluation.
+Float3 CpuRayMarcher::EstimateNormal(const Float3& crtPoint, const RayMarcherBuffer& rayMarcherData,
+                                     Statistics& statistics)
+{
+    if (rayMarcherData.AnalyticNormals)
+    {
+        statistics.DistanceEvaluations++;
+        return Normalize(DistanceEstimator(DualVariable(crtPoint)).Gradient);
+    }
+
+    const Float3 xyy = { 1.0f, -1.0f, -1.0f };
+    const Float3 xyx = { -1.0f, 1.0f, -1.0f };
+    const Float3 yyx = { -1.0f, -1.0f, 1.0f };
+    const Float3 xxx = { 1.0f, 1.0f, 1.0f };
+
+    const Float3 normal = xyy * DistanceEstimator(crtPoint + xyy * NORMAL_THRESHOLD) +
+        xyx * DistanceEstimator(crtPoint + xyx * NORMAL_THRESHOLD) +
+        yyx * DistanceEstimator(crtPoint + yyx * NORMAL_THRESHOLD) +
+        xxx * DistanceEstimator(crtPoint + xxx * NORMAL_THRESHOLD);
+    statistics.DistanceEvaluations += 4;
+
+    return Normalize(normal);
+}
+
+// Marches a cone around the camera ray through pixel (x, y) that contains the rays of all the pixels of its cell: they
+// leave the eye within coneAngle of it, as the farthest pixel centre is (PREPASS_CELL_SIZE - 1) / sqrt(2) pixel
+// spacings of 2 / height away on the camera plane at CAMERA_PLANE_DISTANCE. The checkerboard shifts every other row by
+// a pixel, and jittered samples may reach half a pixel further, to the cell's corners. Each step keeps the whole cone
+// inside the empty sphere around the centre, so every distance returned is safe for all those rays.
+float CpuRayMarcher::ConeMarch(const float x, const float y, const RayMarcherBuffer& rayMarcherData,
+                               Statistics& statistics)
+{
+    const Float2 windowSize = rayMarcherData.WindowSize;
+
+    const Float3 eye = TransformPoint(Float3{ 0.0f, 0.0f, 0.0f }, rayMarcherData.CameraMatrix);
+    const Float3 direction = GetRayDirection(x, y, rayMarcherData.CameraMatrix, windowSize);
+
+    const Uint2 pixelSpacing = GetPixelSpacing(rayMarcherData);
+    const auto cellSpread = static_cast<float>((PREPASS_CELL_SIZE - 1) * max(pixelSpacing.X, pixelSpacing.Y) +
+                                                (rayMarcherData.Interleave == INTERLEAVE_CHECKER ? 1 : 0) +
+                                                (rayMarcherData.SampleIndex ? 1 : 0));
+    const float coneAngle = cellSpread * 1.41421356f / (CAMERA_PLANE_DISTANCE * windowSize.Y);
+
+    float totalDistance = CAMERA_PLANE_DISTANCE;
+    for (int steps = 0; steps < MAX_STEPS; steps++)
+    {
+        const float distance = DistanceEstimator(eye + totalDistance * direction);
+        statistics.PrepassSteps++;
+        statistics.DistanceEvaluations++;
+
+        const float freeDistance = distance - coneAngle * totalDistance;
+        if (freeDistance < MINIMUM_DISTANCE || distance > MAX_CAMERA_DEPTH)
+            break;
+        totalDistance += freeDistance / (1.0f + coneAngle);
+    }
+
+    return totalDistance;
+}
+
+// Start distance from the eye of the primary ray through pixel (x, y), reprojected from the previous frame's depth:
+// the hit that pixel saw last frame is followed into the previous camera, and the nearest of the four previous pixels
+// around it gives the next guess, REPROJECTION_PASSES times. A miss among those pixels is a silhouette that may hide
+// disoccluded geometry, and a guess off the ray by more than REPROJECTION_SLACK pixels or starting inside the scene is
+// not trusted either; all of them return zero for a full march. Otherwise the ray starts REPROJECTION_MARGIN of the
+// distance short of the reprojected hit and steps receives the step count of that hit's ambient occlusion. As that
+// count only changes when a ray marches from the camera plane, one tile in REPROJECTION_REFRESH always does, in a
+// rotating pattern, so the reused ambient occlusion stays recent. Whole tiles keep the packets and thread groups
+// coherent, where single pixels would hold back every packet.
+float CpuRayMarcher::Reproject(const uint32_t x, const uint32_t y, const RayMarcherBuffer& rayMarcherData,
+                               const CpuDepthTexture& previousDepth, float& steps, Statistics& statistics)
+{
+    steps = -1.0f;
+    if (rayMarcherData.Reprojection != REPROJECTION_REUSE ||
+        (x / BLOCK_SIZE + 2 * (y / BLOCK_SIZE) + rayMarcherData.FrameIndex) % REPROJECTION_REFRESH == 0)
+        return 0.0f;
+
+    const Float2 windowSize = rayMarcherData.WindowSize;
+    const Float4x4& previousMatrix = rayMarcherData.PreviousCameraMatrix;
+
+    const Float3 eye = TransformPoint(Float3{ 0.0f, 0.0f, 0.0f }, rayMarcherData.CameraMatrix);
+    const Float3 direction = GetRayDirection(static_cast<float>(x), static_cast<float>(y), rayMarcherData.CameraMatrix,
+                                             windowSize);
+    const Float3 previousEye = TransformPoint(Float3{ 0.0f, 0.0f, 0.0f }, previousMatrix);
+
+    Float2 nearest = previousDepth.Load(x, y);
+    if (nearest.X <= 0.0f)
+        return 0.0f;
+
+    float distance = nearest.X;
+    float previousSteps = nearest.Y;
+    Float3 previousHit = eye + distance * direction;
+
+    for (int pass = 0; pass < REPROJECTION_PASSES; pass++)
+    {
+        Float2 previousPixel;
+        if (!ProjectToPreviousFrame(eye + distance * direction, rayMarcherData, previousPixel))
+            return 0.0f;
+
+        const float previousX = previousPixel.X;
+        const float previousY = previousPixel.Y;
+
+        const auto footprintX = static_cast<uint32_t>(previousX);
+        const auto footprintY = static_cast<uint32_t>(previousY);
+
+        nearest = Float2{ 0.0f, 0.0f };
+        uint32_t nearestX = footprintX;
+        uint32_t nearestY = footprintY;
+        for (uint32_t sampleY = footprintY; sampleY <= footprintY + 1; sampleY++)
+            for (uint32_t sampleX = footprintX; sampleX <= footprintX + 1; sampleX++)
+            {
+                const Float2 sample = previousDepth.Load(sampleX, sampleY);
+                if (sample.X <= 0.0f)
+                    return 0.0f;
+                if (nearest.X <= 0.0f || sample.X < nearest.X)
+                {
+                    nearest = sample;
+                    nearestX = sampleX;
+                    nearestY = sampleY;
+                }
+            }
+
+        // The step count comes from the previous pixel closest to the reprojected point; taking it from the nearest
+        // hit would drift the ambient occlusion towards the foreground over the frames.
+        previousSteps = previousDepth.Load(static_cast<uint32_t>(previousX + 0.5f),
+                                           static_cast<uint32_t>(previousY + 0.5f)).Y;
+        previousHit = previousEye + nearest.X * GetRayDirection(static_cast<float>(nearestX),
+                                                                static_cast<float>(nearestY), previousMatrix,
+                                                                windowSize);
+        distance = Dot(previousHit - eye, direction);
+    }
+
+    const float slack = REPROJECTION_SLACK * 2.0f * distance / (CAMERA_PLANE_DISTANCE * windowSize.Y);
+    if (Length(previousHit - (eye + distance * direction)) > slack)
+        return 0.0f;
+
+    const float startDistance = distance * (1.0f - REPROJECTION_MARGIN);
+    statistics.DistanceEvaluations++;
+    if (DistanceEstimator(eye + startDistance * direction) < rayMarcherData.HitTolerance)
+        return 0.0f;
+
+    statistics.ReprojectedRays++;
+    steps = previousSteps;
+    return startDistance;
+}
+
+// Pixel of the previous frame at which its camera saw position. Fails behind the camera and outside the pixels with a
+// whole 2 x 2 footprint around them.
+bool CpuRayMarcher::ProjectToPreviousFrame(const Float3& position, const RayMarcherBuffer& rayMarcherData,
+                                           Float2& previousPixel)
+{
+    const Float2 windowSize = rayMarcherData.WindowSize;
+
+    // Inverse of the pixel to camera plane mapping of ShadePixel, in the previous camera.
+    const Float3 local = InverseTransformPoint(position, rayMarcherData.PreviousCameraMatrix);
+    previousPixel = Float2{ 0.0f, 0.0f };
+    if (local.Z <= 0.0f)
+        return false;
+
+    previousPixel = Float2{
+        (local.X * CAMERA_PLANE_DISTANCE / local.Z * (windowSize.Y / windowSize.X) + 1.0f) * 0.5f * windowSize.X,
+        (1.0f - local.Y * CAMERA_PLANE_DISTANCE / local.Z) * 0.5f * windowSize.Y
+    };
+    return previousPixel.X >= 0.0f && previousPixel.Y >= 0.0f &&
+        previousPixel.X < windowSize.X - 1.0f && previousPixel.Y < windowSize.Y - 1.0f;
+}
+
+// Normalized direction of the camera ray through pixel (x, y).
+Float3 CpuRayMarcher::GetRayDirection(const float x, const float y, const Float4x4& cameraMatrix,
+                                      const Float2& windowSize)
+{
+    const Float3 onCameraPoint = {
+        (x / windowSize.X * 2.0f - 1.0f) * (windowSize.X / windowSize.Y),
+        -(y / windowSize.Y * 2.0f - 1.0f),
+        CAMERA_PLANE_DISTANCE
+    };
+    return Normalize(TransformDirection(onCameraPoint, cameraMatrix));
+}
+
+// The primary ray starts marching at startDistance along direction, its reflections at from. With reprojectedSteps
+// zero or more the primary hit takes its ambient occlusion from that step count instead of its own.
+// coneDistance is the distance from the eye to from. With ConeScale > 0 the hit threshold grows with the radius of
+// the pixel's cone at the current point: a pixel spans 2 / height on the camera plane at CAMERA_PLANE_DISTANCE, so
+// the cone radius is ConeScale * distance / (CAMERA_PLANE_DISTANCE * height). Reflections off the curved surfaces
+// spread the cone further, so its angle grows by REFLECTION_SPREAD at each bounce. The color takes only the primary
+// hit, so MAX_RAYS_DEPTH marches no reflection. The deferred march leaves its shadow to the lighting pass.
+CpuRayMarcher::TraceResult CpuRayMarcher::IterativeTrace(Float3 from, Float3 direction, float startDistance,
+                                                         float reprojectedSteps, float coneDistance,
+                                                         const RayMarcherBuffer& rayMarcherData,
+                                                         const CpuShadowCacheTexture& shadowCache,
+                                                         Statistics& statistics)
+{
+    TraceResult intersectionsStack[MAX_RAYS_DEPTH];
+    int stackLength = 0;
+    bool stillGoing = true;
+
+    float coneAngle = rayMarcherData.ConeScale / (CAMERA_PLANE_DISTANCE * rayMarcherData.WindowSize.Y);
+
+    for (int depth = 0; depth < MAX_RAYS_DEPTH && stillGoing; depth++)
+    {
+        statistics.Rays++;
+
+        int steps;
+        MarchState state = { startDistance, 0.0f, 0.0f, rayMarcherData.OverRelaxation };
+        bool stopped = false;
+
+        for (steps = 0; steps < MAX_STEPS; steps++)
+        {
+            const float crtDistance = state.TotalDistance;
+            const Float3 crtPoint = from + crtDistance * direction;
+            const float distance = DistanceEstimator(crtPoint);
+            statistics.Steps++;
+            statistics.DistanceEvaluations++;
+            statistics.LaneSlots++;
+            if (!Advance(distance, state, statistics))
+                continue;
+            if (distance < max(rayMarcherData.HitTolerance, coneAngle * (coneDistance + crtDistance)))
+            {
+                const float ambientSteps = reprojectedSteps < 0.0f ? static_cast<float>(steps) : reprojectedSteps;
+                const float ambientOcclusion = 1.0f - ambientSteps / static_cast<float>(MAX_STEPS);
+
+                const Float3 hitPoint = RefineHit(from, direction, crtDistance, distance, rayMarcherData, statistics);
+                const Float3 normal = EstimateNormal(hitPoint, rayMarcherData, statistics);
+
+                TraceResult crtResult;
+                crtResult.Hit = true;
+                crtResult.Normal = normal;
+                crtResult.AmbientOcclusion = ambientOcclusion;
+                crtResult.Color = Float3{ 1.0f, 1.0f, 1.0f };
+                crtResult.NumSteps = static_cast<int>(ambientSteps);
+                crtResult.Distance = crtDistance;
+
+                const Float3 reflected = Reflect(direction, normal);
+                from = hitPoint + reflected * 0.1f;
+                direction = reflected;
+                coneDistance += crtDistance + 0.1f;
+                coneAngle *= REFLECTION_SPREAD;
+                startDistance = 0.0f;
+                reprojectedSteps = -1.0f;
+
+                crtResult.Visibility = 1.0f;
+                if (rayMarcherData.Deferred)
+                    stillGoing = false;
+                else
+                    crtResult.Visibility = ShadowVisibility(hitPoint, rayMarcherData, shadowCache, statistics);
+
+                intersectionsStack[stackLength++] = crtResult;
+
+                stopped = true;
+
+                break;
+            }
+
+            if (distance > MAX_CAMERA_DEPTH)
+            {
+                TraceResult crtResult;
+                crtResult.Hit = false;
+                crtResult.AmbientOcclusion = 0.0f;
+                crtResult.Normal = direction;
+                crtResult.Color = Float3{ 0.0f, 0.0f, 0.0f };
+                crtResult.NumSteps = steps;
+                crtResult.Visibility = 1.0f;
+                crtResult.Distance = 0.0f;
+                intersectionsStack[stackLength++] = crtResult;
+                stillGoing = false;
+
+                stopped = true;
+
+                break;
+            }
+        }
+
+        if (!stopped)
+        {
+            TraceResult crtResult;
+            crtResult.Hit = false;
+            crtResult.AmbientOcclusion = 0.0f;
+            crtResult.Normal = direction;
+            crtResult.Color = Float3{ 0.0f, 0.0f, 0.0f };
+            crtResult.NumSteps = steps;
+            crtResult.Visibility = 1.0f;
+            crtResult.Distance = 0.0f;
+            intersectionsStack[stackLength++] = crtResult;
+            stillGoing = false;
+        }
+    }
+
+    TraceResult finalResult{};
+    finalResult.Color = Float3{ 0.0f, 0.0f, 0.0f };
+
+    // Like the shader, only the primary hit contributes to the final color.
+    for (int i = 0; i >= 0; i--)
+    {
+        TraceResult crtResult = intersectionsStack[i];
+
+        const Float3 lightDirection = Normalize(-rayMarcherData.LightDirection);
+        const float lightIntensity = max(0.1f, Dot(crtResult.Normal, lightDirection));
+        const float color = crtResult.AmbientOcclusion * lightIntensity;
+
+        crtResult.Color = Float3{ color, color, color };
+
+        // The shadow halves the color, the penumbra less.
+        crtResult.Color *= 0.5f + 0.5f * crtResult.Visibility;
+
+        finalResult.Color += crtResult.Color;
+        finalResult.Hit = crtResult.Hit;
+        finalResult.Normal = crtResult.Normal;
+        finalResult.AmbientOcclusion = crtResult.AmbientOcclusion;
+        finalResult.NumSteps = crtResult.NumSteps;
+        finalResult.Distance = crtResult.Distance;
+
+        intersectionsStack[i] = crtResult;
+    }
+
+    return finalResult;
+}
+
+// Body of the compute shader's main for the thread at DispatchThreadId (x, y): MarchPixel, then StoreSample, or
+// StoreGeometry for the deferred march.
+void CpuRayMarcher::ShadePixel(const uint32_t x, const uint32_t y, const float prepassDistance,
+                               const RayMarcherBuffer& rayMarcherData, const RenderTargets& renderTargets,
+                               Statistics& statistics)
+{
+    const PixelSample pixelSample = MarchPixel(x, y, prepassDistance, rayMarcherData, renderTargets, statistics);
+    if (rayMarcherData.Deferred)
+        StoreGeometry(x, y, pixelSample, rayMarcherData, renderTargets);
+    else
+        StoreSample(x, y, pixelSample, rayMarcherData, renderTargets);
+}
+
+// The primary ray through pixel (x, y) at the offset of SampleIndex. It starts at the farthest of prepassDistance and
+// the reprojected distance from the eye if that is past the camera plane. A deferred sample has no color yet.
+CpuRayMarcher::PixelSample CpuRayMarcher::MarchPixel(const uint32_t x, const uint32_t y, const float prepassDistance,
+                                                     const RayMarcherBuffer& rayMarcherData,
+                                                     const RenderTargets& renderTargets, Statistics& statistics)
+{
+    const Float2 windowSize = rayMarcherData.WindowSize;
+    const Float2 sampleOffset = GetSampleOffset(rayMarcherData.SampleIndex);
+
+    Float2 normalizedCoords = {
+        (static_cast<float>(x) + sampleOffset.X) / windowSize.X * 2.0f - 1.0f,
+        (static_cast<float>(y) + sampleOffset.Y) / windowSize.Y * 2.0f - 1.0f
+    };
+    normalizedCoords.X *= windowSize.X / windowSize.Y;
+    normalizedCoords.Y *= -1.0f;
+
+    Float3 onCameraPoint = { normalizedCoords.X, normalizedCoords.Y, 5.0f };
+    Float3 eye = { 0.0f, 0.0f, 0.0f };
+
+    Float3 rayDirection = onCameraPoint - eye;
+
+    eye = TransformPoint(eye, rayMarcherData.CameraMatrix);
+    rayDirection = TransformDirection(rayDirection, rayMarcherData.CameraMatrix);
+    onCameraPoint = eye + rayDirection;
+
+    const float coneDistance = Length(rayDirection);
+    rayDirection = Normalize(rayDirection);
+
+    float reprojectedSteps;
+    const float reprojectedDistance = Reproject(x, y, rayMarcherData, *renderTargets.PreviousDepth, reprojectedSteps,
+                                                statistics);
+    const float startDistance = max(0.0f, max(prepassDistance, reprojectedDistance) - coneDistance);
+
+    statistics.PrimaryRays++;
+    const TraceResult result = IterativeTrace(onCameraPoint, rayDirection, startDistance, reprojectedSteps,
+                                              coneDistance, rayMarcherData, *renderTargets.ShadowCache, statistics);
+
+    return PixelSample{
+        result.Color,
+        result.Normal,
+        result.Hit ? coneDistance + result.Distance : 0.0f,
+        result.Hit ? static_cast<float>(result.NumSteps) : 0.0f
+    };
+}
+
+// Shades the primary hit of pixel (x, y) in the G-buffer. The hit point is rebuilt from the depth, the coarse hit,
+// which stays within HitTolerance of the refined one.
+CpuRayMarcher::PixelSample CpuRayMarcher::LightPixel(const uint32_t x, const uint32_t y,
+                                                     const RayMarcherBuffer& rayMarcherData,
+                                                     const RenderTargets& renderTargets, Statistics& statistics)
+{
+    PixelSample pixelSample = UnpackGBuffer(renderTargets.GBuffer->Load(x, y));
+    if (pixelSample.Depth > 0.0f)
+    {
+        const Float3 eye = TransformPoint(Float3{ 0.0f, 0.0f, 0.0f }, rayMarcherData.CameraMatrix);
+        const Float3 hitPoint = eye + pixelSample.Depth * GetSampleDirection(x, y, rayMarcherData.SampleIndex,
+                                                                            rayMarcherData);
+        pixelSample.Color = ShadeHit(hitPoint, pixelSample.Normal, pixelSample.Steps, rayMarcherData,
+                                     *renderTargets.ShadowCache, statistics);
+    }
+    return pixelSample;
+}
+
+// Color of a primary hit as IterativeTrace shades it: the ambient occlusion of its step count times the diffuse light
+// from LightDirection, halved in the shadow.
+Float3 CpuRayMarcher::ShadeHit(const Float3& hitPoint, const Float3& normal, const float steps,
+                               const RayMarcherBuffer& rayMarcherData, const CpuShadowCacheTexture& shadowCache,
+                               Statistics& statistics)
+{
+    const Float3 lightDirection = Normalize(-rayMarcherData.LightDirection);
+    const float lightIntensity = max(0.1f, Dot(normal, lightDirection));
+    const float color = (1.0f - steps / static_cast<float>(MAX_STEPS)) * lightIntensity;
+    const float visibility = ShadowVisibility(hitPoint, rayMarcherData, shadowCache, statistics);
+    return Float3{ color, color, color } * (0.5f + 0.5f * visibility);
+}
+
+// Normalized direction of the primary ray through pixel (x, y) at the offset of sampleIndex.
+Float3 CpuRayMarcher::GetSampleDirection(const uint32_t x, const uint32_t y, const uint32_t sampleIndex,
+                                         const RayMarcherBuffer& rayMarcherData)
+{
+    const Float2 sampleOffset = GetSampleOffset(sampleIndex);
+    return GetRayDirection(static_cast<float>(x) + sampleOffset.X, static_cast<float>(y) + sampleOffset.Y,
+                           rayMarcherData.CameraMatrix, rayMarcherData.WindowSize);
+}
+
+// Which of the sub-estimators of DistanceEstimator is the closest at position.
+uint32_t CpuRayMarcher::GetMaterial(const Float3& position)
+{
+    return YPlane(position, -1.0f) < SpheresEstimator(position, Float3{ 0.0f, 1.0f, 3.0f }) ? MATERIAL_PLANE
+                                                                                           : MATERIAL_SPHERES;
+}
+
+// Octahedral mapping of a unit vector to the [-1, 1] square: the vector is projected on the octahedron
+// |x| + |y| + |z| = 1, whose lower half is then folded over the diagonals of the square.
+Float2 CpuRayMarcher::EncodeOctahedral(Float3 normal)
+{
+    normal = normal / (abs(normal.X) + abs(normal.Y) + abs(normal.Z));
+    if (normal.Z >= 0.0f)
+        return Float2{ normal.X, normal.Y };
+    return Float2{ (1.0f - abs(normal.Y)) * (normal.X >= 0.0f ? 1.0f : -1.0f),
+                   (1.0f - abs(normal.X)) * (normal.Y >= 0.0f ? 1.0f : -1.0f) };
+}
+
+Float3 CpuRayMarcher::DecodeOctahedral(const Float2& octahedral)
+{
+    Float3 normal = { octahedral.X, octahedral.Y, 1.0f - abs(octahedral.X) - abs(octahedral.Y) };
+    if (normal.Z < 0.0f)
+    {
+        normal.X = (1.0f - abs(octahedral.Y)) * (octahedral.X >= 0.0f ? 1.0f : -1.0f);
+        normal.Y = (1.0f - abs(octahedral.X)) * (octahedral.Y >= 0.0f ? 1.0f : -1.0f);
+    }
+    return Normalize(normal);
+}
+
+// G-buffer texel of a deferred sample: the bits of the depth, then the octahedral normal in two GBUFFER_NORMAL_BITS
+// fields, the step count, below MAX_STEPS, in GBUFFER_STEPS_BITS and the material in the top bits.
+Uint2 CpuRayMarcher::PackGBuffer(const PixelSample& pixelSample, const uint32_t material)
+{
+    const Float2 octahedral = EncodeOctahedral(pixelSample.Normal);
+    const auto normalX = static_cast<uint32_t>((octahedral.X * 0.5f + 0.5f) * GBUFFER_NORMAL_MAX + 0.5f);
+    const auto normalY = static_cast<uint32_t>((octahedral.Y * 0.5f + 0.5f) * GBUFFER_NORMAL_MAX + 0.5f);
+
+    uint32_t depth;
+    memcpy(&depth, &pixelSample.Depth, sizeof(depth));
+    return Uint2{ depth, normalX | normalY << GBUFFER_NORMAL_BITS |
+                         static_cast<uint32_t>(pixelSample.Steps) << 2 * GBUFFER_NORMAL_BITS |
+                         material << (2 * GBUFFER_NORMAL_BITS + GBUFFER_STEPS_BITS) };
+}
+
+// Deferred sample of a G-buffer texel, without its color.
+CpuRayMarcher::PixelSample CpuRayMarcher::UnpackGBuffer(const Uint2& texel)
+{
+    constexpr uint32_t normalMask = (1u << GBUFFER_NORMAL_BITS) - 1;
+    const Float2 octahedral = {
+        static_cast<float>(texel.Y & normalMask) / GBUFFER_NORMAL_MAX * 2.0f - 1.0f,
+        static_cast<float>(texel.Y >> GBUFFER_NORMAL_BITS & normalMask) / GBUFFER_NORMAL_MAX * 2.0f - 1.0f
+    };
+
+    PixelSample pixelSample;
+    pixelSample.Color = Float3{ 0.0f, 0.0f, 0.0f };
+    pixelSample.Normal = DecodeOctahedral(octahedral);
+    memcpy(&pixelSample.Depth, &texel.X, sizeof(pixelSample.Depth));
+    pixelSample.Steps = static_cast<float>(texel.Y >> 2 * GBUFFER_NORMAL_BITS & ((1u << GBUFFER_STEPS_BITS) - 1));
+    return pixelSample;
+}
@@ -0,0 +1,200 @@
+#pragma once
+
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+#include "CpuDepthTexture.h"
+#include "CpuFloat4Texture.h"
+#include "CpuGBufferTexture.h"
+#include "CpuMath.h"
+#include "CpuShadowCacheTexture.h"
+#include "CpuTexture.h"
+#include "RayMarcherBuffer.h"
+#include "RayMarcherConstants.h"
+#include "TaskScheduler.h"
+
+struct CpuMarchKernels;
+
+// C++ port of RayMarcher.hlsl, used by the headless backend.
+// The frame is split into BLOCK_SIZE x BLOCK_SIZE tiles, like the compute dispatch, and the tiles are distributed over
+// the TaskScheduler's workers. Each tile is rendered by the selected CpuMarchKernels, either the scalar code below or
+// one of the SIMD packet versions in CpuPacketMarcher.h. The passes hand the tiles out in Z-order, so that the tiles a
+// worker takes one after the other lie close together.
+class CpuRayMarcher
+{
+public:
+
+    // Mirror of the textures bound to RayMarcher.hlsl: g_outputTexture, g_previousDepth, g_depth, g_accumulatedColor,
+    // g_halfColor, g_halfGeometry, g_previousHistory, g_history, g_color, g_geometry, g_gBuffer and g_shadowCache.
+    struct RenderTargets
+    {
+        CpuTexture*                  Output;
+        const CpuDepthTexture*       PreviousDepth;
+        CpuDepthTexture*             Depth;
+        CpuFloat4Texture*            Accumulation;
+        CpuFloat4Texture*            HalfColor;
+        CpuFloat4Texture*            HalfGeometry;
+        const CpuFloat4Texture*      PreviousHistory;
+        CpuFloat4Texture*            History;
+        CpuFloat4Texture*            Color;
+        CpuFloat4Texture*            Geometry;
+        CpuGBufferTexture*           GBuffer;
+        const CpuShadowCacheTexture* ShadowCache;
+    };
+
+    struct Statistics
+    {
+        uint64_t PrimaryRays;
+        uint64_t Rays;
+        uint64_t Steps;
+        uint64_t DistanceEvaluations;
+        uint64_t LaneSlots;
+        uint64_t RelaxationFallbacks;
+        uint64_t RefinementSteps;
+        uint64_t PrepassSteps;
+        uint64_t ReprojectedRays;
+        uint64_t UpsampledPixels;
+        uint64_t ReconstructedPixels;
+        uint64_t EdgePixels;
+        uint64_t SupersampledPixels;
+        uint64_t ShadowRays;
+        uint64_t ShadowSteps;
+        uint64_t ShadowCacheHits;
+        uint64_t ShadowCacheSteps;
+    };
+
+    // What the primary ray through a pixel found. Depth and Steps are zero for misses.
+    struct PixelSample
+    {
+        Float3 Color;
+        Float3 Normal;
+        float  Depth;
+        float  Steps;
+    };
+
+    struct TraceResult
+    {
+        float  AmbientOcclusion;
+        bool   Hit;
+        Float3 Normal;
+        Float3 Color;
+        int    NumSteps;
+        float  Visibility;
+        float  Distance;
+    };
+
+    CpuRayMarcher(std::shared_ptr<TaskScheduler>, const CpuMarchKernels*);
+
+    void               Render(const RayMarcherBuffer&, const RenderTargets&);
+    void               BuildShadowCache(const RayMarcherBuffer&, CpuShadowCacheTexture&);
+
+    Statistics         GetStatistics()                                              const;
+    void               ResetStatistics();
+
+    static uint32_t    GetTilesCount(uint32_t);
+    static int         GetRefinementSteps(float);
+
+    static void        RenderTile(uint32_t, uint32_t, const RayMarcherBuffer&, const RenderTargets&, Statistics&);
+    static void        UpsampleTile(uint32_t, uint32_t, const RayMarcherBuffer&, const RenderTargets&, Statistics&);
+    static void        ReconstructTile(uint32_t, uint32_t, const RayMarcherBuffer&, const RenderTargets&,
+                                       Statistics&);
+    static void        LightTile(uint32_t, uint32_t, const RayMarcherBuffer&, const RenderTargets&, Statistics&);
+    static void        BuildShadowCacheSlice(uint32_t, const RayMarcherBuffer&, CpuShadowCacheTexture&, Statistics&);
+    static float       LookUpShadowCache(const Float3&, const RayMarcherBuffer&, const CpuShadowCacheTexture&);
+    static Float3      GetShadowCacheOrigin(const Float3&, uint32_t, float);
+    static void        CountEdgesTile(uint32_t, uint32_t, const RayMarcherBuffer&, const RenderTargets&, uint32_t*,
+                                      Statistics&);
+    static void        SupersampleTile(uint32_t, uint32_t, const RayMarcherBuffer&, const RenderTargets&, uint32_t,
+                                       Statistics&);
+    static uint32_t    GetSupersampledBucket(const RayMarcherBuffer&, const uint32_t*);
+    static void        MarchPrepass(uint32_t, uint32_t, const RayMarcherBuffer&, float*, Statistics&);
+    static float       Reproject(uint32_t, uint32_t, const RayMarcherBuffer&, const CpuDepthTexture&, float&,
+                                 Statistics&);
+    static Uint2       GetPixelSpacing(const RayMarcherBuffer&);
+    static Uint2       GetThreadPixel(uint32_t, uint32_t, const RayMarcherBuffer&);
+    static bool        IsMarchedPixel(uint32_t, uint32_t, const RayMarcherBuffer&);
+    static Float2      GetSampleOffset(uint32_t);
+    static void        StoreSample(uint32_t, uint32_t, const PixelSample&, const RayMarcherBuffer&,
+                                   const RenderTargets&);
+    static void        StoreGeometry(uint32_t, uint32_t, const PixelSample&, const RayMarcherBuffer&,
+                                     const RenderTargets&);
+    static void        EvaluateDistances(const float*, const float*, const float*, float*, uint32_t);
+
+    static float       SphereEstimator(const Float3&, const Float3&, float);
+    static float       SpheresEstimator(const Float3&, const Float3&);
+    static float       Sierpinski(const Float3&, const Float3&);
+    static float       YPlane(const Float3&, float);
+    static float       DistanceEstimator(const Float3&);
+
+    static DualFloat   SphereEstimator(const DualFloat3&, const Float3&, float);
+    static DualFloat   SpheresEstimator(const DualFloat3&, const Float3&);
+    static DualFloat   Sierpinski(const DualFloat3&, const Float3&);
+    static DualFloat   YPlane(const DualFloat3&, float);
+    static DualFloat   DistanceEstimator(const DualFloat3&);
+
+private:
+
+    // Also the worker's share of g_edgeHistogram.
+    struct WorkerStatistics
+    {
+        Statistics Value;
+        uint32_t   EdgeHistogram[EDGE_BUCKETS];
+        char       Padding[64];
+    };
+
+    // Tile indices of a TilesX x TilesY dispatch in Z-order, rebuilt when the dispatch changes size.
+    struct TileOrder
+    {
+        uint32_t              TilesX;
+        uint32_t              TilesY;
+        std::vector<uint32_t> Tiles;
+    };
+
+    // Position along a ray and the state of the over-relaxed stepping.
+    struct MarchState
+    {
+        float TotalDistance;
+        float StepLength;
+        float PreviousDistance;
+        float Relaxation;
+    };
+
+    static const std::vector<uint32_t>& GetTileOrder(uint32_t, uint32_t, TileOrder&);
+
+    static void        ShadePixel(uint32_t, uint32_t, float, const RayMarcherBuffer&, const RenderTargets&,
+                                  Statistics&);
+    static PixelSample MarchPixel(uint32_t, uint32_t, float, const RayMarcherBuffer&, const RenderTargets&,
+                                  Statistics&);
+    static float       GetEdgeStrength(uint32_t, uint32_t, const RayMarcherBuffer&, const RenderTargets&);
+    static uint32_t    GetEdgeBucket(float);
+    static PixelSample LightPixel(uint32_t, uint32_t, const RayMarcherBuffer&, const RenderTargets&, Statistics&);
+    static Float3      ShadeHit(const Float3&, const Float3&, float, const RayMarcherBuffer&,
+                                const CpuShadowCacheTexture&, Statistics&);
+    static Float3      GetSampleDirection(uint32_t, uint32_t, uint32_t, const RayMarcherBuffer&);
+    static uint32_t    GetMaterial(const Float3&);
+    static Float2      EncodeOctahedral(Float3);
+    static Float3      DecodeOctahedral(const Float2&);
+    static Uint2       PackGBuffer(const PixelSample&, uint32_t);
+    static PixelSample UnpackGBuffer(const Uint2&);
+    static float       ConeMarch(float, float, const RayMarcherBuffer&, Statistics&);
+    static TraceResult IterativeTrace(Float3, Float3, float, float, float, const RayMarcherBuffer&,
+                                      const CpuShadowCacheTexture&, Statistics&);
+    static Float3      GetRayDirection(float, float, const Float4x4&, const Float2&);
+    static Float3      RefineHit(const Float3&, const Float3&, float, float, const RayMarcherBuffer&, Statistics&);
+    static Float3      EstimateNormal(const Float3&, const RayMarcherBuffer&, Statistics&);
+    static float       TraceShadow(const Float3&, const Float3&, const RayMarcherBuffer&, Statistics&);
+    static float       MarchShadow(const Float3&, const RayMarcherBuffer&, Statistics&);
+    static float       ShadowVisibility(const Float3&, const RayMarcherBuffer&, const CpuShadowCacheTexture&,
+                                        Statistics&);
+    static bool        Advance(float, MarchState&, Statistics&);
+    static float       Halton(uint32_t, uint32_t);
+    static bool        ProjectToPreviousFrame(const Float3&, const RayMarcherBuffer&, Float2&);
+    static void        StoreColor(uint32_t, uint32_t, const Float4&, const RayMarcherBuffer&, const RenderTargets&);
+
+    std::shared_ptr<TaskScheduler> m_taskScheduler;
+    const CpuMarchKernels*         m_marchKernels;
+    std::vector<WorkerStatistics>  m_workerStatistics;
+    TileOrder                      m_marchTiles;
+    TileOrder                      m_fullTiles;
+};
@@ -0,0 +1,51 @@
+#include "pch.h"
+
+#include "CpuShadowCacheTexture.h"
+
+using namespace std;
+
+CpuShadowCacheTexture::CpuShadowCacheTexture() :
+    m_width(0),
+    m_height(0),
+    m_depth(0)
+{
+}
+
+void CpuShadowCacheTexture::Resize(const uint32_t width, const uint32_t height, const uint32_t depth)
+{
+    m_width = width;
+    m_height = height;
+    m_depth = depth;
+    m_texels.assign(static_cast<size_t>(width) * height * depth, 0);
+}
+
+void CpuShadowCacheTexture::Store(const uint32_t x, const uint32_t y, const uint32_t z, const uint8_t value)
+{
+    m_texels[(static_cast<size_t>(z) * m_height + y) * m_width + x] = value;
+}
+
+uint8_t CpuShadowCacheTexture::Load(const uint32_t x, const uint32_t y, const uint32_t z) const
+{
+    return m_texels[(static_cast<size_t>(z) * m_height + y) * m_width + x];
+}
+
+uint32_t CpuShadowCacheTexture::GetWidth() const
+{
+    return m_width;
+}
+
+uint32_t CpuShadowCacheTexture::GetHeight() const
+{
+    return m_height;
+}
+
+uint32_t CpuShadowCacheTexture::GetDepth() const
+{
+    return m_depth;
+}
+
+// Slices of rows, in the layout of the D3D12 upload.
+const vector<uint8_t>& CpuShadowCacheTexture::GetTexels() const
+{
+    return m_texels;
+}
@@ -0,0 +1,31 @@
+#pragma once
+
+#include <cstdint>
+#include <vector>
+
+// In-memory counterpart of the DXGI_FORMAT_R8_UNORM 3D shadow cache: for each texel of a grid over the scene the
+// visibility of the light, built by CpuRayMarcher::BuildShadowCacheSlice. X and Z are the horizontal axes and Y the
+// vertical one, like the world.
+class CpuShadowCacheTexture
+{
+public:
+
+    CpuShadowCacheTexture();
+
+    void                        Resize(uint32_t, uint32_t, uint32_t);
+
+    void                        Store(uint32_t, uint32_t, uint32_t, uint8_t);
+    uint8_t                     Load(uint32_t, uint32_t, uint32_t)                const;
+
+    uint32_t                    GetWidth()                                        const;
+    uint32_t                    GetHeight()                                       const;
+    uint32_t                    GetDepth()                                        const;
+    const std::vector<uint8_t>& GetTexels()                                       const;
+
+private:
+
+    uint32_t                    m_width;
+    uint32_t                    m_height;
+    uint32_t                    m_depth;
+    std::vector<uint8_t>        m_texels;
+};
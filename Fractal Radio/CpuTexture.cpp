@@ -0,0 +1,128 @@
+#include "pch.h"
+
+#include "CpuTexture.h"
+
+#include <cstdio>
+#include <cstring>
+
+using namespace std;
+
+CpuTexture::CpuTexture() :
+    m_width(0),
+    m_height(0),
+    m_tiled(false)
+{
+}
+
+CpuTexture::CpuTexture(const uint32_t width, const uint32_t height) :
+    CpuTexture()
+{
+    Resize(width, height, false);
+}
+
+void CpuTexture::Resize(const uint32_t width, const uint32_t height, const bool tiled)
+{
+    m_width = width;
+    m_height = height;
+    m_tiled = tiled;
+    m_pixels.assign(tiled ? GetTiledSize(width, height) : static_cast<size_t>(width) * height, 0);
+}
+
+void CpuTexture::Clear(const float* color)
+{
+    fill(m_pixels.begin(), m_pixels.end(), Pack(Float4{ color[0], color[1], color[2], color[3] }));
+}
+
+void CpuTexture::Store(const uint32_t x, const uint32_t y, const Float4& color)
+{
+    m_pixels[GetIndex(x, y)] = Pack(color);
+}
+
+uint32_t CpuTexture::Load(const uint32_t x, const uint32_t y) const
+{
+    return m_pixels[GetIndex(x, y)];
+}
+
+// Point sampling with clamp addressing, like g_pointClampSampler in PixelShader.hlsl.
+uint32_t CpuTexture::Sample(const float u, const float v) const
+{
+    const auto x = static_cast<uint32_t>(min(max(u * m_width, 0.0f), static_cast<float>(m_width - 1)));
+    const auto y = static_cast<uint32_t>(min(max(v * m_height, 0.0f), static_cast<float>(m_height - 1)));
+
+    return Load(x, y);
+}
+
+// Copies this tiled texture to target, a texture of the same size in rows, one row of a tile at a time.
+void CpuTexture::Detile(CpuTexture& target) const
+{
+    for (uint32_t y = 0; y < m_height; y++)
+        for (uint32_t x = 0; x < m_width; x += TEXTURE_TILE_SIZE)
+            memcpy(&target.m_pixels[static_cast<size_t>(y) * m_width + x], &m_pixels[GetTiledIndex(x, y, m_width)],
+                   min(TEXTURE_TILE_SIZE, m_width - x) * sizeof(uint32_t));
+}
+
+uint32_t CpuTexture::GetWidth() const
+{
+    return m_width;
+}
+
+uint32_t CpuTexture::GetHeight() const
+{
+    return m_height;
+}
+
+bool CpuTexture::IsTiled() const
+{
+    return m_tiled;
+}
+
+vector<uint32_t>& CpuTexture::GetPixels()
+{
+    return m_pixels;
+}
+
+const vector<uint32_t>& CpuTexture::GetPixels() const
+{
+    return m_pixels;
+}
+
+bool CpuTexture::SavePpm(const char* fileName) const
+{
+    FILE* file = fopen(fileName, "wb");
+    if (!file)
+        return false;
+
+    fprintf(file, "P6\n%u %u\n255\n", m_width, m_height);
+
+    for (uint32_t y = 0; y < m_height; y++)
+        for (uint32_t x = 0; x < m_width; x++)
+        {
+            const uint32_t pixel = Load(x, y);
+            const unsigned char rgb[] =
+            {
+                static_cast<unsigned char>(pixel & 0xFF),
+                static_cast<unsigned char>((pixel >> 8) & 0xFF),
+                static_cast<unsigned char>((pixel >> 16) & 0xFF)
+            };
+            fwrite(rgb, 1, sizeof rgb, file);
+        }
+
+    fclose(file);
+    return true;
+}
+
+// UNORM conversion as performed by the GPU when writing to an R8G8B8A8_UNORM UAV.
+uint32_t CpuTexture::Pack(const Float4& color)
+{
+    const auto r = static_cast<uint32_t>(Saturate(color.X) * 255.0f + 0.5f);
+    const auto g = static_cast<uint32_t>(Saturate(color.Y) * 255.0f + 0.5f);
+    const auto b = static_cast<uint32_t>(Saturate(color.Z) * 255.0f + 0.5f);
+    const auto a = static_cast<uint32_t>(Saturate(color.W) * 255.0f + 0.5f);
+
+    return r | (g << 8) | (b << 16) | (a << 24);
+}
+
+size_t CpuTexture::GetIndex(const uint32_t x, const uint32_t y) const
+{
+    return m_tiled ? GetTiledIndex(x, y, m_width) : static_cast<size_t>(y) * m_width + x;
+}
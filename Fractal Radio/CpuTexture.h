@@ -0,0 +1,45 @@
+#pragma once
+
+#include <cstdint>
+#include <vector>
+
+#include "CpuMath.h"
+
+// In-memory counterpart of a DXGI_FORMAT_R8G8B8A8_UNORM texture. The texels are stored in rows, the layout of the
+// back buffers, or tiled like the other textures of the ray marcher (see GetTiledIndex); GetPixels is in that layout,
+// and Detile copies a tiled texture to one in rows.
+class CpuTexture
+{
+public:
+
+    CpuTexture();
+    CpuTexture(uint32_t, uint32_t);
+
+    void                         Resize(uint32_t, uint32_t, bool);
+    void                         Clear(const float*);
+
+    void                         Store(uint32_t, uint32_t, const Float4&);
+    uint32_t                     Load(uint32_t, uint32_t)                         const;
+    uint32_t                     Sample(float, float)                             const;
+    void                         Detile(CpuTexture&)                              const;
+
+    uint32_t                     GetWidth()                                       const;
+    uint32_t                     GetHeight()                                      const;
+    bool                         IsTiled()                                        const;
+
+    std::vector<uint32_t>&       GetPixels();
+    const std::vector<uint32_t>& GetPixels()                                      const;
+
+    bool                         SavePpm(const char*)                             const;
+
+    static uint32_t              Pack(const Float4&);
+
+private:
+
+    size_t                       GetIndex(uint32_t, uint32_t)                     const;
+
+    uint32_t              m_width;
+    uint32_t              m_height;
+    bool                  m_tiled;
+    std::vector<uint32_t> m_pixels;
+};
@@ -25,3 +25,7 @@ void Demo::Resize(uint32_t, uint32_t)
 void Demo::MouseMoved(float, float)
 {
 }
+
+void Demo::KeyPressed(uint32_t)
+{
+}
@@ -1,9 +1,11 @@
 #pragma once
 
-#include "Graphics.h"
+#include <cstdint>
+#include <memory>
 
-class Graphics;
+#include "Graphics.h"
 
+// A renderer driven by Window's message loop or by HeadlessApplication, over either backend of Graphics.
 class Demo  // NOLINT(cppcoreguidelines-special-member-functions)
 {
 public:
@@ -18,6 +20,7 @@ public:
 
     virtual void                      Resize(uint32_t, uint32_t);
     virtual void                      MouseMoved(float, float);
+    virtual void                      KeyPressed(uint32_t);
 
 protected:
 
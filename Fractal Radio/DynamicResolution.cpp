@@ -0,0 +1,66 @@
+#include "pch.h"
+
+#include "DynamicResolution.h"
+
+#include <algorithm>
+#include <cmath>
+
+using namespace std;
+
+constexpr float  RESOLUTION_STEPS     = 16.0f;
+constexpr float  MIN_RESOLUTION_SCALE = 0.25f;
+constexpr double BUDGET_HEADROOM      = 0.9;
+
+// A budget of zero keeps the full resolution.
+DynamicResolution::DynamicResolution(const double budgetSeconds) :
+    m_budgetSeconds(budgetSeconds),
+    m_scale(1.0f)
+{
+}
+
+// Takes the render time of a frame at the current scale and returns true when the scale changed. The cost of a frame
+// follows its pixel count, so the scale that fits BUDGET_HEADROOM of the budget is the current one times the square
+// root of the time ratio, rounded down to a step. Over budget the resolution drops at once; it only grows when a
+// whole step fits in the headroom, which keeps it from flickering between two steps on timing noise.
+bool DynamicResolution::Update(const double renderSeconds)
+{
+    if (m_budgetSeconds <= 0.0 || renderSeconds <= 0.0)
+        return false;
+
+    const double idealScale = m_scale * sqrt(BUDGET_HEADROOM * m_budgetSeconds / renderSeconds);
+    const float scale = min(max(static_cast<float>(floor(idealScale * RESOLUTION_STEPS)) / RESOLUTION_STEPS,
+                                MIN_RESOLUTION_SCALE), 1.0f);
+
+    if (scale == m_scale || (scale < m_scale && renderSeconds <= m_budgetSeconds))
+        return false;
+
+    m_scale = scale;
+    return true;
+}
+
+void DynamicResolution::Reset()
+{
+    m_scale = 1.0f;
+}
+
+void DynamicResolution::SetBudget(const double budgetSeconds)
+{
+    m_budgetSeconds = budgetSeconds;
+    Reset();
+}
+
+double DynamicResolution::GetBudget() const
+{
+    return m_budgetSeconds;
+}
+
+float DynamicResolution::GetScale() const
+{
+    return m_scale;
+}
+
+// Number of pixels marched along a window dimension of size pixels, at least one.
+uint32_t DynamicResolution::GetScaledSize(const uint32_t size) const
+{
+    return max(static_cast<uint32_t>(static_cast<float>(size) * m_scale + 0.5f), 1u);
+}
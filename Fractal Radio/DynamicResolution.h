@@ -0,0 +1,26 @@
+#pragma once
+
+#include <cstdint>
+
+// Frame-time controller of the ray marcher's internal resolution, shared by FractalRadio and HeadlessFractalRadio.
+// It is fed the measured time of each rendered frame and picks the fraction of the window the next frames march at,
+// in whole steps of 1 / RESOLUTION_STEPS between MIN_RESOLUTION_SCALE and full resolution.
+class DynamicResolution
+{
+public:
+
+    explicit DynamicResolution(double = 0.0);
+
+    bool     Update(double);
+    void     Reset();
+
+    void     SetBudget(double);
+    double   GetBudget()          const;
+    float    GetScale()           const;
+    uint32_t GetScaledSize(uint32_t) const;
+
+private:
+
+    double m_budgetSeconds;
+    float  m_scale;
+};
@@ -0,0 +1,13 @@
+// Counts the pixels of each edge bucket for Supersample.hlsl.
+#define RAY_MARCHER_LIBRARY
+#include "RayMarcher.hlsl"
+
+[numthreads(BLOCK_SIZE, BLOCK_SIZE, 1)]
+void main(ComputeShaderInput IN)
+{
+    uint2 pixel = IN.DispatchThreadId.xy;
+    if (pixel.x >= uint(g_windowSize.x) || pixel.y >= uint(g_windowSize.y))
+        return;
+
+    InterlockedAdd(g_edgeHistogram[GetEdgeBucket(GetEdgeStrength(pixel))], 1);
+}
@@ -1,13 +1,33 @@
 #include "pch.h"
 
 #include "FractalRadio.h"
+#include "RayMarcherConstants.h"
 #include "d3dcompiler.h"
 #include "Window.h"
 
+#include <chrono>
+#include <cstring>
+
 using namespace std;
 using namespace Microsoft::WRL;
 using namespace DirectX;
 using namespace DX;
+using namespace std::chrono;
+
+// Values the rendering options take when switched on.
+constexpr auto OVER_RELAXATION        = 1.4f;
+constexpr auto HIT_TOLERANCE          = 0.05f;
+constexpr auto SUPERSAMPLE_BUDGET     = 0.5f;
+constexpr auto LIGHT_SPEED            = 0.5f;
+constexpr auto SHADOW_SOFTNESS        = 8.0f;
+constexpr auto SHADOW_CACHE_CELLS     = 256u;
+constexpr auto SHADOW_CACHE_CELL_SIZE = 0.125f;
+constexpr auto FRAME_BUDGET           = 1.0 / 60.0;
+
+// Each frame's descriptor table: g_outputTexture, g_depth, g_accumulatedColor, g_halfColor, g_halfGeometry, g_history,
+// g_color, g_geometry, g_edgeHistogram and g_gBuffer UAVs, then the g_previousDepth, g_previousHistory and
+// g_shadowCache SRVs.
+constexpr auto RAY_MARCHER_DESCRIPTORS = 13u;
 
 static FractalRadio::Vertex g_vertices[] =
 {
@@ -23,24 +43,27 @@ static WORD g_indices[] =
     0, 2, 3
 };
 
-FractalRadio::FractalRadio(const shared_ptr<Graphics> graphics) :
-    Demo(graphics)
+FractalRadio::FractalRadio(const shared_ptr<D3D12Graphics> graphics) :
+    Demo(graphics),
+    m_d3d12Graphics(graphics),
+    m_frameState(FrameState::Settings()),
+    m_shadowCacheBuilder()
 {
     const auto device = graphics->GetDevice();
     auto commandQueue = graphics->GetCommandQueue();
     const auto commandList = commandQueue->GetCommandList();
     
     ComPtr<ID3D12Resource> vertexIntermediateResource;
-    m_graphics->UpdateBufferResource(commandList, &m_vertexBuffer, &vertexIntermediateResource, _countof(g_vertices),
-        sizeof Vertex, g_vertices);
+    m_d3d12Graphics->UpdateBufferResource(commandList, &m_vertexBuffer, &vertexIntermediateResource,
+        _countof(g_vertices), sizeof Vertex, g_vertices);
 
     m_vertexBufferView.BufferLocation = m_vertexBuffer->GetGPUVirtualAddress();
     m_vertexBufferView.SizeInBytes = sizeof g_vertices;
     m_vertexBufferView.StrideInBytes = sizeof(Vertex);
 
     ComPtr<ID3D12Resource> indexIntermediateResource;
-    m_graphics->UpdateBufferResource(commandList, &m_indexBuffer, &indexIntermediateResource, _countof(g_indices),
-        sizeof WORD, g_indices);
+    m_d3d12Graphics->UpdateBufferResource(commandList, &m_indexBuffer, &indexIntermediateResource,
+        _countof(g_indices), sizeof WORD, g_indices);
 
     m_indexBufferView.BufferLocation = m_indexBuffer->GetGPUVirtualAddress();
     m_indexBufferView.Format = DXGI_FORMAT_R16_UINT;
@@ -57,9 +80,8 @@ FractalRadio::FractalRadio(const shared_ptr<Graphics> graphics) :
 
 void FractalRadio::Resize(uint32_t width, uint32_t height)
 {
-    auto commandQueue = m_graphics->GetCommandQueue();
-    commandQueue->Flush();
-    CreateRayMarcherTexture(m_graphics->GetDevice());
+    m_graphics->Flush();
+    CreateRayMarcherTexture(m_d3d12Graphics->GetDevice());
 }
 
 void FractalRadio::MouseMoved(float diffX, float diffY)
@@ -67,6 +89,57 @@ void FractalRadio::MouseMoved(float diffX, float diffY)
     m_camera->MouseMoved(diffX, diffY);
 }
 
+// Rendering options: N switches between central difference and analytic (dual number) normals, O toggles over-relaxed
+// sphere tracing, B the coarse hit tolerance with bisection refinement, C the pixel footprint hit threshold, P the
+// low resolution cone marching prepass, R the reprojection of the previous frame's depth, A the progressive
+// accumulation of jittered samples while the view is still, D the dynamic resolution that keeps the ray marcher
+// within FRAME_BUDGET, H the half resolution march with edge-aware upsampling, I cycles through the checkerboard and
+// interlaced rows modes that march half of the pixels and reconstruct the others from the previous frame, E the
+// adaptive supersampling of the edges within SUPERSAMPLE_BUDGET, G the deferred shading that marches a compact G-buffer
+// and lights it in a separate pass, L turns the light at LIGHT_SPEED, K switches between hard shadows and soft ones
+// with SHADOW_SOFTNESS and V looks the shadows up in a cache built on the CPU instead of marching them.
+void FractalRadio::KeyPressed(const uint32_t key)
+{
+    FrameState::Settings settings = m_frameState.GetSettings();
+    if (key == 'N')
+        settings.AnalyticNormals = !settings.AnalyticNormals;
+    if (key == 'O')
+        settings.OverRelaxation = settings.OverRelaxation > 1.0f ? 1.0f : OVER_RELAXATION;
+    if (key == 'B')
+        settings.HitTolerance = settings.HitTolerance > MINIMUM_DISTANCE ? MINIMUM_DISTANCE : HIT_TOLERANCE;
+    if (key == 'C')
+        settings.ConeScale = settings.ConeScale > 0.0f ? 0.0f : 1.0f;
+    if (key == 'P')
+        settings.Prepass = !settings.Prepass;
+    if (key == 'R')
+        settings.Reprojection = !settings.Reprojection;
+    if (key == 'A')
+        settings.Accumulation = !settings.Accumulation;
+    if (key == 'H')
+        settings.HalfResolution = !settings.HalfResolution;
+    if (key == 'I')
+    {
+        settings.Interleave = settings.Interleave == INTERLEAVE_ROWS ? 0 :
+                              settings.Interleave ? INTERLEAVE_ROWS : INTERLEAVE_CHECKER;
+    }
+    if (key == 'E')
+        settings.SupersampleBudget = settings.SupersampleBudget > 0.0f ? 0.0f : SUPERSAMPLE_BUDGET;
+    if (key == 'G')
+        settings.Deferred = !settings.Deferred;
+    if (key == 'L')
+        settings.LightSpeed = settings.LightSpeed > 0.0f ? 0.0f : LIGHT_SPEED;
+    if (key == 'K')
+        settings.ShadowSoftness = settings.ShadowSoftness > 0.0f ? 0.0f : SHADOW_SOFTNESS;
+    if (key == 'V')
+    {
+        settings.ShadowCacheCells = settings.ShadowCacheCells ? 0 : SHADOW_CACHE_CELLS;
+        settings.ShadowCacheCellSize = SHADOW_CACHE_CELL_SIZE;
+    }
+    if (key == 'D')
+        settings.FrameBudget = settings.FrameBudget > 0.0 ? 0.0 : FRAME_BUDGET;
+    m_frameState.SetSettings(settings);
+}
+
 void FractalRadio::Update(float deltaTime)
 {
     static uint64_t frameCounter = 0;
@@ -78,7 +151,8 @@ void FractalRadio::Update(float deltaTime)
     {
         char buffer[500];
         auto fps = frameCounter / elapsedSeconds;
-        sprintf_s(buffer, 500, "FPS: %f\n", fps);
+        sprintf_s(buffer, 500, "FPS: %f, skipped frames: %llu, resolution scale: %.2f\n", fps,
+                  m_frameState.GetSkippedFrames(), m_frameState.GetDynamicResolution().GetScale());
         OutputDebugStringA(buffer);
 
         frameCounter = 0;
@@ -86,29 +160,50 @@ void FractalRadio::Update(float deltaTime)
     }
 
     m_camera->Update(deltaTime);
+    m_frameState.Update(deltaTime);
 }
 
 void FractalRadio::Render()
 {
     FLOAT clearColor[] = { 0.4f, 0.6f, 0.9f, 1.0f };
 
-    auto commandQueue = m_graphics->GetCommandQueue();
-    auto commandList = commandQueue->GetCommandList();
+    auto commandQueue = m_d3d12Graphics->GetCommandQueue();
 
-    //PIXBeginEvent(commandList.Get(), (UINT64)0, L"FractalStart");
+    XMFLOAT4X4 cameraMatrix;
+    XMStoreFloat4x4(&cameraMatrix, m_camera->GetMatrix());
+    Float4x4 frameCameraMatrix;
+    memcpy(frameCameraMatrix.M, cameraMatrix.m, sizeof frameCameraMatrix.M);
 
-    RenderFractal(commandList);
+    const FrameState::Frame frame = m_frameState.BeginFrame(m_graphics->GetClientWidth(),
+                                                            m_graphics->GetClientHeight(), frameCameraMatrix);
+    if (!frame.IsSkipped)
+    {
+        auto commandList = commandQueue->GetCommandList();
 
-    //PIXBeginEvent(commandList.Get(), (UINT64)0, L"FractalEnd");
+        // The shadow cache upload is left out of the frame's time.
+        if (frame.BuildShadowCache)
+            UploadShadowCache(commandList, frame.RayMarcherData);
 
-    commandQueue->ExecuteCommandList(commandList);
-    commandQueue->Flush();
+        const auto startTime = high_resolution_clock::now();
+
+        //PIXBeginEvent(commandList.Get(), (UINT64)0, L"FractalStart");
+
+        RenderFractal(commandList, frame.RayMarcherData);
 
-    commandList = m_graphics->BeginFrame();
+        //PIXBeginEvent(commandList.Get(), (UINT64)0, L"FractalEnd");
+
+        commandQueue->ExecuteCommandList(commandList);
+        commandQueue->Flush();
+
+        // The flush waits for the dispatch, so the wall time is the ray marching time.
+        m_frameState.EndFrame(frame, duration<double>(high_resolution_clock::now() - startTime).count());
+    }
+
+    auto commandList = m_d3d12Graphics->BeginFrame();
 
     //PIXBeginEvent(commandList.Get(), (UINT64)0, L"FrameStart");
 
-    m_graphics->ClearRenderTarget(commandList, clearColor);
+    m_d3d12Graphics->ClearRenderTarget(commandList, clearColor);
 
     commandList->SetPipelineState(m_drawPipelineState.Get());
     commandList->SetGraphicsRootSignature(m_drawRootSignature.Get());
@@ -130,11 +225,16 @@ void FractalRadio::Render()
         0,
         m_fractalTextureDescriptorSrvHeap->GetGPUDescriptorHandleForHeapStart());
 
+    // The fractal texture holds the last rendered view in its top left corner.
+    const Float2& windowSize = m_frameState.GetLastRayMarcherData().WindowSize;
+    const XMFLOAT2 uvScale(windowSize.X / m_graphics->GetClientWidth(), windowSize.Y / m_graphics->GetClientHeight());
+    commandList->SetGraphicsRoot32BitConstants(1, 2, &uvScale, 0);
+
     commandList->IASetPrimitiveTopology(D3D_PRIMITIVE_TOPOLOGY_TRIANGLELIST);
     commandList->IASetVertexBuffers(0, 1, &m_vertexBufferView);
     commandList->IASetIndexBuffer(&m_indexBufferView);
 
-    m_graphics->SetRenderTarget(commandList);
+    m_d3d12Graphics->SetRenderTarget(commandList);
 
     commandList->DrawIndexedInstanced(_countof(g_indices), 1, 0, 0, 0);
 
@@ -146,7 +246,7 @@ void FractalRadio::Render()
 
     //PIXBeginEvent(commandList.Get(), (UINT64)1000, L"FrameEnd");
 
-    m_graphics->EndFrame(commandList);
+    m_d3d12Graphics->EndFrame(commandList);
 }
 
 uint32_t FractalRadio::GetComputerShaderGroupsCount(const uint32_t size, const uint32_t numBlocks)
@@ -154,7 +254,32 @@ uint32_t FractalRadio::GetComputerShaderGroupsCount(const uint32_t size, const u
     return (size + numBlocks - 1) / numBlocks;
 }
 
-void FractalRadio::RenderFractal(ComPtr<ID3D12GraphicsCommandList2> commandList)
+// Builds the shadow cache of rayMarcherData on the CPU and copies it to g_shadowCache through the upload buffer.
+void FractalRadio::UploadShadowCache(ComPtr<ID3D12GraphicsCommandList2> commandList,
+                                     const RayMarcherBuffer& rayMarcherData)
+{
+    const CpuShadowCacheTexture& shadowCache = m_shadowCacheBuilder.Build(rayMarcherData);
+
+    D3D12_SUBRESOURCE_DATA subresourceData;
+    subresourceData.pData = shadowCache.GetTexels().data();
+    subresourceData.RowPitch = shadowCache.GetWidth();
+    subresourceData.SlicePitch = static_cast<LONG_PTR>(shadowCache.GetWidth()) * shadowCache.GetHeight();
+
+    CD3DX12_RESOURCE_BARRIER barrier = CD3DX12_RESOURCE_BARRIER::Transition(m_shadowCacheTexture.Get(),
+        D3D12_RESOURCE_STATE_COMMON, D3D12_RESOURCE_STATE_COPY_DEST);
+
+    commandList->ResourceBarrier(1, &barrier);
+
+    UpdateSubresources(commandList.Get(), m_shadowCacheTexture.Get(), m_shadowCacheUploadBuffer.Get(), 0, 0, 1,
+                       &subresourceData);
+
+    CD3DX12_RESOURCE_BARRIER barrier2 = CD3DX12_RESOURCE_BARRIER::Transition(m_shadowCacheTexture.Get(),
+        D3D12_RESOURCE_STATE_COPY_DEST, D3D12_RESOURCE_STATE_COMMON);
+
+    commandList->ResourceBarrier(1, &barrier2);
+}
+
+void FractalRadio::RenderFractal(ComPtr<ID3D12GraphicsCommandList2> commandList, const RayMarcherBuffer& rayMarcherData)
 {
     commandList->SetPipelineState(m_fractalPipelineState.Get());
     commandList->SetComputeRootSignature(m_fractalRootSignature.Get());
@@ -166,29 +291,160 @@ void FractalRadio::RenderFractal(ComPtr<ID3D12GraphicsCommandList2> commandList)
 
     commandList->SetDescriptorHeaps(1, descriptorHeaps);
 
-    CD3DX12_RESOURCE_BARRIER barrier = CD3DX12_RESOURCE_BARRIER::Transition(
-        m_fractalsTexture.Get(),
-        D3D12_RESOURCE_STATE_COMMON, D3D12_RESOURCE_STATE_UNORDERED_ACCESS);
+    // The depth and history textures alternate between frames: the ones written last frame are read while the others
+    // are written.
+    const uint32_t depthIndex = m_frameState.GetDepthIndex();
+    ID3D12Resource* depthTexture = m_depthTextures[depthIndex].Get();
+    ID3D12Resource* previousDepthTexture = m_depthTextures[depthIndex ^ 1].Get();
+    ID3D12Resource* historyTexture = m_historyTextures[depthIndex].Get();
+    ID3D12Resource* previousHistoryTexture = m_historyTextures[depthIndex ^ 1].Get();
 
-    commandList->ResourceBarrier(1, &barrier);
+    CD3DX12_RESOURCE_BARRIER barriers[] =
+    {
+        CD3DX12_RESOURCE_BARRIER::Transition(m_fractalsTexture.Get(),
+            D3D12_RESOURCE_STATE_COMMON, D3D12_RESOURCE_STATE_UNORDERED_ACCESS),
+        CD3DX12_RESOURCE_BARRIER::Transition(depthTexture,
+            D3D12_RESOURCE_STATE_COMMON, D3D12_RESOURCE_STATE_UNORDERED_ACCESS),
+        CD3DX12_RESOURCE_BARRIER::Transition(m_accumulationTexture.Get(),
+            D3D12_RESOURCE_STATE_COMMON, D3D12_RESOURCE_STATE_UNORDERED_ACCESS),
+        CD3DX12_RESOURCE_BARRIER::Transition(m_halfColorTexture.Get(),
+            D3D12_RESOURCE_STATE_COMMON, D3D12_RESOURCE_STATE_UNORDERED_ACCESS),
+        CD3DX12_RESOURCE_BARRIER::Transition(m_halfGeometryTexture.Get(),
+            D3D12_RESOURCE_STATE_COMMON, D3D12_RESOURCE_STATE_UNORDERED_ACCESS),
+        CD3DX12_RESOURCE_BARRIER::Transition(historyTexture,
+            D3D12_RESOURCE_STATE_COMMON, D3D12_RESOURCE_STATE_UNORDERED_ACCESS),
+        CD3DX12_RESOURCE_BARRIER::Transition(m_colorTexture.Get(),
+            D3D12_RESOURCE_STATE_COMMON, D3D12_RESOURCE_STATE_UNORDERED_ACCESS),
+        CD3DX12_RESOURCE_BARRIER::Transition(m_geometryTexture.Get(),
+            D3D12_RESOURCE_STATE_COMMON, D3D12_RESOURCE_STATE_UNORDERED_ACCESS),
+        CD3DX12_RESOURCE_BARRIER::Transition(m_edgeHistogramBuffer.Get(),
+            D3D12_RESOURCE_STATE_COMMON, D3D12_RESOURCE_STATE_UNORDERED_ACCESS),
+        CD3DX12_RESOURCE_BARRIER::Transition(m_gBufferTexture.Get(),
+            D3D12_RESOURCE_STATE_COMMON, D3D12_RESOURCE_STATE_UNORDERED_ACCESS),
+        CD3DX12_RESOURCE_BARRIER::Transition(previousDepthTexture,
+            D3D12_RESOURCE_STATE_COMMON, D3D12_RESOURCE_STATE_NON_PIXEL_SHADER_RESOURCE),
+        CD3DX12_RESOURCE_BARRIER::Transition(previousHistoryTexture,
+            D3D12_RESOURCE_STATE_COMMON, D3D12_RESOURCE_STATE_NON_PIXEL_SHADER_RESOURCE),
+        CD3DX12_RESOURCE_BARRIER::Transition(m_shadowCacheTexture.Get(),
+            D3D12_RESOURCE_STATE_COMMON, D3D12_RESOURCE_STATE_NON_PIXEL_SHADER_RESOURCE)
+    };
+
+    commandList->ResourceBarrier(_countof(barriers), barriers);
 
-    RayMarcherBuffer rayMarcherData;
-    rayMarcherData.WindowSize = XMFLOAT2(Window::GetInstance()->GetClientWidth(), Window::GetInstance()->GetClientHeight());
-    rayMarcherData.CameraMatrix = m_camera->GetMatrix();
     commandList->SetComputeRoot32BitConstants(0, sizeof(RayMarcherBuffer) / 4, &rayMarcherData, 0);
     
+    const auto descriptorSize = m_d3d12Graphics->GetDevice()->GetDescriptorHandleIncrementSize(
+        D3D12_DESCRIPTOR_HEAP_TYPE_CBV_SRV_UAV);
     commandList->SetComputeRootDescriptorTable(
         1,
-        m_fractalTextureDescriptorUavHeap->GetGPUDescriptorHandleForHeapStart());
+        CD3DX12_GPU_DESCRIPTOR_HANDLE(m_fractalTextureDescriptorUavHeap->GetGPUDescriptorHandleForHeapStart(),
+                                      depthIndex * RAY_MARCHER_DESCRIPTORS, descriptorSize));
     
-    commandList->Dispatch(GetComputerShaderGroupsCount(Window::GetInstance()->GetClientWidth(), 8),
-                          GetComputerShaderGroupsCount(Window::GetInstance()->GetClientHeight(), 8), 1);
+    // With HalfResolution the ray marcher fills the G-buffer from every other pixel of every other row and
+    // Upsample.hlsl then covers the whole window, re-marching the pixels on edges. The interleaved modes march every
+    // other pixel of each row (checkerboard) or every other row, and Reconstruct.hlsl fills in the rest. The deferred
+    // march only writes the G-buffer and Lighting.hlsl shades it; a relit frame skips the march altogether.
+    const uint32_t width = static_cast<uint32_t>(rayMarcherData.WindowSize.X);
+    const uint32_t height = static_cast<uint32_t>(rayMarcherData.WindowSize.Y);
+    const uint32_t spacingX = rayMarcherData.HalfResolution || rayMarcherData.Interleave == INTERLEAVE_CHECKER ? 2 : 1;
+    const uint32_t spacingY = rayMarcherData.HalfResolution || rayMarcherData.Interleave == INTERLEAVE_ROWS ? 2 : 1;
+    if (rayMarcherData.Deferred != DEFERRED_RELIGHT)
+        commandList->Dispatch(GetComputerShaderGroupsCount((width + spacingX - 1) / spacingX, 8),
+                              GetComputerShaderGroupsCount((height + spacingY - 1) / spacingY, 8), 1);
+
+    if (rayMarcherData.Deferred)
+    {
+        CD3DX12_RESOURCE_BARRIER gBufferBarrier = CD3DX12_RESOURCE_BARRIER::UAV(m_gBufferTexture.Get());
 
-    CD3DX12_RESOURCE_BARRIER barrier2 = CD3DX12_RESOURCE_BARRIER::Transition(
-        m_fractalsTexture.Get(),
-        D3D12_RESOURCE_STATE_UNORDERED_ACCESS, D3D12_RESOURCE_STATE_COMMON);
+        commandList->ResourceBarrier(1, &gBufferBarrier);
 
-    commandList->ResourceBarrier(1, &barrier2);
+        commandList->SetPipelineState(m_lightingPipelineState.Get());
+        commandList->Dispatch(GetComputerShaderGroupsCount(width, 8), GetComputerShaderGroupsCount(height, 8), 1);
+    }
+
+    if (rayMarcherData.HalfResolution)
+    {
+        CD3DX12_RESOURCE_BARRIER halfBarriers[] =
+        {
+            CD3DX12_RESOURCE_BARRIER::UAV(m_halfColorTexture.Get()),
+            CD3DX12_RESOURCE_BARRIER::UAV(m_halfGeometryTexture.Get())
+        };
+
+        commandList->ResourceBarrier(_countof(halfBarriers), halfBarriers);
+
+        commandList->SetPipelineState(m_upsamplePipelineState.Get());
+        commandList->Dispatch(GetComputerShaderGroupsCount(width, 8), GetComputerShaderGroupsCount(height, 8), 1);
+    }
+    else if (rayMarcherData.Interleave >= INTERLEAVE_CHECKER)
+    {
+        CD3DX12_RESOURCE_BARRIER historyBarrier = CD3DX12_RESOURCE_BARRIER::UAV(historyTexture);
+
+        commandList->ResourceBarrier(1, &historyBarrier);
+
+        commandList->SetPipelineState(m_reconstructPipelineState.Get());
+        commandList->Dispatch(GetComputerShaderGroupsCount(width, 8), GetComputerShaderGroupsCount(height, 8), 1);
+    }
+
+    // Adaptive supersampling counts the edges of the G-buffer the march wrote, then adds jittered rays to the strongest
+    // ones that fit in the budget, overwriting their output and accumulated colors.
+    if (rayMarcherData.SupersampleBudget > 0.0f)
+    {
+        CD3DX12_RESOURCE_BARRIER edgeBarriers[] =
+        {
+            CD3DX12_RESOURCE_BARRIER::UAV(m_colorTexture.Get()),
+            CD3DX12_RESOURCE_BARRIER::UAV(m_geometryTexture.Get()),
+            CD3DX12_RESOURCE_BARRIER::UAV(m_edgeHistogramBuffer.Get())
+        };
+
+        commandList->ResourceBarrier(_countof(edgeBarriers), edgeBarriers);
+
+        commandList->SetPipelineState(m_edgeHistogramPipelineState.Get());
+        commandList->Dispatch(GetComputerShaderGroupsCount(width, 8), GetComputerShaderGroupsCount(height, 8), 1);
+
+        CD3DX12_RESOURCE_BARRIER supersampleBarriers[] =
+        {
+            CD3DX12_RESOURCE_BARRIER::UAV(m_edgeHistogramBuffer.Get()),
+            CD3DX12_RESOURCE_BARRIER::UAV(m_fractalsTexture.Get()),
+            CD3DX12_RESOURCE_BARRIER::UAV(m_accumulationTexture.Get())
+        };
+
+        commandList->ResourceBarrier(_countof(supersampleBarriers), supersampleBarriers);
+
+        commandList->SetPipelineState(m_supersamplePipelineState.Get());
+        commandList->Dispatch(GetComputerShaderGroupsCount(width, 8), GetComputerShaderGroupsCount(height, 8), 1);
+    }
+
+    CD3DX12_RESOURCE_BARRIER barriers2[] =
+    {
+        CD3DX12_RESOURCE_BARRIER::Transition(m_fractalsTexture.Get(),
+            D3D12_RESOURCE_STATE_UNORDERED_ACCESS, D3D12_RESOURCE_STATE_COMMON),
+        CD3DX12_RESOURCE_BARRIER::Transition(depthTexture,
+            D3D12_RESOURCE_STATE_UNORDERED_ACCESS, D3D12_RESOURCE_STATE_COMMON),
+        CD3DX12_RESOURCE_BARRIER::Transition(m_accumulationTexture.Get(),
+            D3D12_RESOURCE_STATE_UNORDERED_ACCESS, D3D12_RESOURCE_STATE_COMMON),
+        CD3DX12_RESOURCE_BARRIER::Transition(m_halfColorTexture.Get(),
+            D3D12_RESOURCE_STATE_UNORDERED_ACCESS, D3D12_RESOURCE_STATE_COMMON),
+        CD3DX12_RESOURCE_BARRIER::Transition(m_halfGeometryTexture.Get(),
+            D3D12_RESOURCE_STATE_UNORDERED_ACCESS, D3D12_RESOURCE_STATE_COMMON),
+        CD3DX12_RESOURCE_BARRIER::Transition(historyTexture,
+            D3D12_RESOURCE_STATE_UNORDERED_ACCESS, D3D12_RESOURCE_STATE_COMMON),
+        CD3DX12_RESOURCE_BARRIER::Transition(m_colorTexture.Get(),
+            D3D12_RESOURCE_STATE_UNORDERED_ACCESS, D3D12_RESOURCE_STATE_COMMON),
+        CD3DX12_RESOURCE_BARRIER::Transition(m_geometryTexture.Get(),
+            D3D12_RESOURCE_STATE_UNORDERED_ACCESS, D3D12_RESOURCE_STATE_COMMON),
+        CD3DX12_RESOURCE_BARRIER::Transition(m_edgeHistogramBuffer.Get(),
+            D3D12_RESOURCE_STATE_UNORDERED_ACCESS, D3D12_RESOURCE_STATE_COMMON),
+        CD3DX12_RESOURCE_BARRIER::Transition(m_gBufferTexture.Get(),
+            D3D12_RESOURCE_STATE_UNORDERED_ACCESS, D3D12_RESOURCE_STATE_COMMON),
+        CD3DX12_RESOURCE_BARRIER::Transition(previousDepthTexture,
+            D3D12_RESOURCE_STATE_NON_PIXEL_SHADER_RESOURCE, D3D12_RESOURCE_STATE_COMMON),
+        CD3DX12_RESOURCE_BARRIER::Transition(previousHistoryTexture,
+            D3D12_RESOURCE_STATE_NON_PIXEL_SHADER_RESOURCE, D3D12_RESOURCE_STATE_COMMON),
+        CD3DX12_RESOURCE_BARRIER::Transition(m_shadowCacheTexture.Get(),
+            D3D12_RESOURCE_STATE_NON_PIXEL_SHADER_RESOURCE, D3D12_RESOURCE_STATE_COMMON)
+    };
+
+    commandList->ResourceBarrier(_countof(barriers2), barriers2);
 }
 
 void FractalRadio::CreateRayMarcherPipeline(ComPtr<ID3D12Device2> device)
@@ -196,12 +452,17 @@ void FractalRadio::CreateRayMarcherPipeline(ComPtr<ID3D12Device2> device)
     ComPtr<ID3DBlob> computeShaderBlob;
     ThrowIfFailed(D3DReadFileToBlob(L"RayMarcher.cso", &computeShaderBlob));
 
-    CD3DX12_DESCRIPTOR_RANGE1 textureUav(D3D12_DESCRIPTOR_RANGE_TYPE_UAV, 1, 0, 0,
-                                         D3D12_DESCRIPTOR_RANGE_FLAG_DESCRIPTORS_VOLATILE);
+    CD3DX12_DESCRIPTOR_RANGE1 textureRanges[2];
+    textureRanges[0].Init(D3D12_DESCRIPTOR_RANGE_TYPE_UAV, 10, 0, 0, D3D12_DESCRIPTOR_RANGE_FLAG_DESCRIPTORS_VOLATILE);
+    textureRanges[1].Init(D3D12_DESCRIPTOR_RANGE_TYPE_SRV, 3, 0, 0, D3D12_DESCRIPTOR_RANGE_FLAG_DESCRIPTORS_VOLATILE);
+
+    // Root constants cost a DWORD each and the descriptor table one more, out of the 64 of a root signature.
+    static_assert(sizeof(RayMarcherBuffer) / 4 + 1 <= D3D12_MAX_ROOT_COST,
+                  "RayMarcherBuffer does not fit in the root signature");
 
     CD3DX12_ROOT_PARAMETER1 rootParameters[2] = {};
     rootParameters[0].InitAsConstants(sizeof RayMarcherBuffer / 4, 0, 0, D3D12_SHADER_VISIBILITY_ALL);
-    rootParameters[1].InitAsDescriptorTable(1, &textureUav);
+    rootParameters[1].InitAsDescriptorTable(_countof(textureRanges), textureRanges);
 
     CD3DX12_VERSIONED_ROOT_SIGNATURE_DESC rootSignatureDesc(
         2, rootParameters,
@@ -210,11 +471,14 @@ void FractalRadio::CreateRayMarcherPipeline(ComPtr<ID3D12Device2> device)
 
     ComPtr<ID3DBlob> rootSignatureBlob;
     ComPtr<ID3DBlob> errorBlob;
-    D3DX12SerializeVersionedRootSignature(&rootSignatureDesc,
+    const HRESULT serializeResult = D3DX12SerializeVersionedRootSignature(&rootSignatureDesc,
         D3D_ROOT_SIGNATURE_VERSION_1_1, &rootSignatureBlob, &errorBlob);
+    if (FAILED(serializeResult) && errorBlob)
+        OutputDebugStringA(static_cast<const char*>(errorBlob->GetBufferPointer()));
+    ThrowIfFailed(serializeResult);
 
-    device->CreateRootSignature(0, rootSignatureBlob->GetBufferPointer(),
-        rootSignatureBlob->GetBufferSize(), IID_PPV_ARGS(&m_fractalRootSignature));
+    ThrowIfFailed(device->CreateRootSignature(0, rootSignatureBlob->GetBufferPointer(),
+        rootSignatureBlob->GetBufferSize(), IID_PPV_ARGS(&m_fractalRootSignature)));
 
     struct PipelineStateStream
     {
@@ -231,14 +495,74 @@ void FractalRadio::CreateRayMarcherPipeline(ComPtr<ID3D12Device2> device)
 
     ThrowIfFailed(device->CreatePipelineState(&pipelineStateStreamDesc, IID_PPV_ARGS(&m_fractalPipelineState)));
 
+    // The upsampling pass shares the root signature and descriptor tables of the ray marcher.
+    ComPtr<ID3DBlob> upsampleShaderBlob;
+    ThrowIfFailed(D3DReadFileToBlob(L"Upsample.cso", &upsampleShaderBlob));
+
+    pipelineStateStream.Cs = CD3DX12_SHADER_BYTECODE(upsampleShaderBlob.Get());
+
+    ThrowIfFailed(device->CreatePipelineState(&pipelineStateStreamDesc, IID_PPV_ARGS(&m_upsamplePipelineState)));
+
+    // So does the reconstruction of the interleaved modes.
+    ComPtr<ID3DBlob> reconstructShaderBlob;
+    ThrowIfFailed(D3DReadFileToBlob(L"Reconstruct.cso", &reconstructShaderBlob));
+
+    pipelineStateStream.Cs = CD3DX12_SHADER_BYTECODE(reconstructShaderBlob.Get());
+
+    ThrowIfFailed(device->CreatePipelineState(&pipelineStateStreamDesc, IID_PPV_ARGS(&m_reconstructPipelineState)));
+
+    // And the two passes of the adaptive supersampling.
+    ComPtr<ID3DBlob> edgeHistogramShaderBlob;
+    ThrowIfFailed(D3DReadFileToBlob(L"EdgeHistogram.cso", &edgeHistogramShaderBlob));
+
+    pipelineStateStream.Cs = CD3DX12_SHADER_BYTECODE(edgeHistogramShaderBlob.Get());
+
+    ThrowIfFailed(device->CreatePipelineState(&pipelineStateStreamDesc, IID_PPV_ARGS(&m_edgeHistogramPipelineState)));
+
+    ComPtr<ID3DBlob> supersampleShaderBlob;
+    ThrowIfFailed(D3DReadFileToBlob(L"Supersample.cso", &supersampleShaderBlob));
+
+    pipelineStateStream.Cs = CD3DX12_SHADER_BYTECODE(supersampleShaderBlob.Get());
+
+    ThrowIfFailed(device->CreatePipelineState(&pipelineStateStreamDesc, IID_PPV_ARGS(&m_supersamplePipelineState)));
+
+    // And the lighting pass of the deferred shading.
+    ComPtr<ID3DBlob> lightingShaderBlob;
+    ThrowIfFailed(D3DReadFileToBlob(L"Lighting.cso", &lightingShaderBlob));
+
+    pipelineStateStream.Cs = CD3DX12_SHADER_BYTECODE(lightingShaderBlob.Get());
+
+    ThrowIfFailed(device->CreatePipelineState(&pipelineStateStreamDesc, IID_PPV_ARGS(&m_lightingPipelineState)));
+
     D3D12_DESCRIPTOR_HEAP_DESC descriptorHeapDesc = {};
     descriptorHeapDesc.Type = D3D12_DESCRIPTOR_HEAP_TYPE_CBV_SRV_UAV;
     descriptorHeapDesc.NumDescriptors = 1;
     descriptorHeapDesc.Flags = D3D12_DESCRIPTOR_HEAP_FLAG_SHADER_VISIBLE;
 
-    device->CreateDescriptorHeap(&descriptorHeapDesc, IID_PPV_ARGS(&m_fractalTextureDescriptorUavHeap));
     device->CreateDescriptorHeap(&descriptorHeapDesc, IID_PPV_ARGS(&m_fractalTextureDescriptorSrvHeap));
 
+    // One descriptor table per depth texture parity.
+    descriptorHeapDesc.NumDescriptors = 2 * RAY_MARCHER_DESCRIPTORS;
+    device->CreateDescriptorHeap(&descriptorHeapDesc, IID_PPV_ARGS(&m_fractalTextureDescriptorUavHeap));
+
+    const auto edgeHistogramDesc = CD3DX12_RESOURCE_DESC::Buffer(EDGE_BUCKETS * sizeof(uint32_t),
+                                                                 D3D12_RESOURCE_FLAG_ALLOW_UNORDERED_ACCESS);
+    const auto heapProperties = CD3DX12_HEAP_PROPERTIES(D3D12_HEAP_TYPE_DEFAULT);
+    ThrowIfFailed(device->CreateCommittedResource(&heapProperties, D3D12_HEAP_FLAG_NONE, &edgeHistogramDesc,
+        D3D12_RESOURCE_STATE_COMMON, nullptr, IID_PPV_ARGS(&m_edgeHistogramBuffer)));
+
+    // The shadow cache does not depend on the window size. It stays bound while off, when the shader does not read it.
+    const auto shadowCacheDesc = CD3DX12_RESOURCE_DESC::Tex3D(DXGI_FORMAT_R8_UNORM, SHADOW_CACHE_CELLS,
+                                                              SHADOW_CACHE_LAYERS, SHADOW_CACHE_CELLS, 1);
+    ThrowIfFailed(device->CreateCommittedResource(&heapProperties, D3D12_HEAP_FLAG_NONE, &shadowCacheDesc,
+        D3D12_RESOURCE_STATE_COMMON, nullptr, IID_PPV_ARGS(&m_shadowCacheTexture)));
+
+    const auto uploadHeapProperties = CD3DX12_HEAP_PROPERTIES(D3D12_HEAP_TYPE_UPLOAD);
+    const auto uploadDesc = CD3DX12_RESOURCE_DESC::Buffer(GetRequiredIntermediateSize(m_shadowCacheTexture.Get(), 0,
+                                                                                      1));
+    ThrowIfFailed(device->CreateCommittedResource(&uploadHeapProperties, D3D12_HEAP_FLAG_NONE, &uploadDesc,
+        D3D12_RESOURCE_STATE_GENERIC_READ, nullptr, IID_PPV_ARGS(&m_shadowCacheUploadBuffer)));
+
     CreateRayMarcherTexture(device);
 }
 
@@ -267,8 +591,113 @@ void FractalRadio::CreateRayMarcherTexture(ComPtr<ID3D12Device2> device)
     srvDesc.Shader4ComponentMapping = D3D12_DEFAULT_SHADER_4_COMPONENT_MAPPING;
     srvDesc.Texture2D.MipLevels = 1;
 
-    m_graphics->GetDevice()->CreateUnorderedAccessView(m_fractalsTexture.Get(), nullptr, &uavDesc, m_fractalTextureDescriptorUavHeap->GetCPUDescriptorHandleForHeapStart());
-    m_graphics->GetDevice()->CreateShaderResourceView(m_fractalsTexture.Get(), &srvDesc, m_fractalTextureDescriptorSrvHeap->GetCPUDescriptorHandleForHeapStart());
+    m_d3d12Graphics->GetDevice()->CreateShaderResourceView(m_fractalsTexture.Get(), &srvDesc, m_fractalTextureDescriptorSrvHeap->GetCPUDescriptorHandleForHeapStart());
+
+    auto depthDesc = textureDesc;
+    depthDesc.Format = DXGI_FORMAT_R32G32_FLOAT;
+
+    for (auto& depthTexture : m_depthTextures)
+        device->CreateCommittedResource(&heapProperties, D3D12_HEAP_FLAG_NONE, &depthDesc,
+            D3D12_RESOURCE_STATE_COMMON, nullptr, IID_PPV_ARGS(&depthTexture));
+
+    D3D12_UNORDERED_ACCESS_VIEW_DESC depthUavDesc = {};
+    depthUavDesc.Format = DXGI_FORMAT_R32G32_FLOAT;
+    depthUavDesc.ViewDimension = D3D12_UAV_DIMENSION_TEXTURE2D;
+
+    D3D12_SHADER_RESOURCE_VIEW_DESC depthSrvDesc = srvDesc;
+    depthSrvDesc.Format = DXGI_FORMAT_R32G32_FLOAT;
+
+    auto accumulationDesc = textureDesc;
+    accumulationDesc.Format = DXGI_FORMAT_R32G32B32A32_FLOAT;
+
+    device->CreateCommittedResource(&heapProperties, D3D12_HEAP_FLAG_NONE, &accumulationDesc,
+        D3D12_RESOURCE_STATE_COMMON, nullptr, IID_PPV_ARGS(&m_accumulationTexture));
+
+    D3D12_UNORDERED_ACCESS_VIEW_DESC accumulationUavDesc = {};
+    accumulationUavDesc.Format = DXGI_FORMAT_R32G32B32A32_FLOAT;
+    accumulationUavDesc.ViewDimension = D3D12_UAV_DIMENSION_TEXTURE2D;
+
+    // The half resolution G-buffer: color and step count, normal and depth.
+    auto halfDesc = accumulationDesc;
+    halfDesc.Width = (Window::GetInstance()->GetClientWidth() + 1) / 2;
+    halfDesc.Height = (Window::GetInstance()->GetClientHeight() + 1) / 2;
+
+    device->CreateCommittedResource(&heapProperties, D3D12_HEAP_FLAG_NONE, &halfDesc,
+        D3D12_RESOURCE_STATE_COMMON, nullptr, IID_PPV_ARGS(&m_halfColorTexture));
+    device->CreateCommittedResource(&heapProperties, D3D12_HEAP_FLAG_NONE, &halfDesc,
+        D3D12_RESOURCE_STATE_COMMON, nullptr, IID_PPV_ARGS(&m_halfGeometryTexture));
+
+    // The color and depth of the last two frames, for the interleaved modes.
+    for (auto& historyTexture : m_historyTextures)
+        device->CreateCommittedResource(&heapProperties, D3D12_HEAP_FLAG_NONE, &accumulationDesc,
+            D3D12_RESOURCE_STATE_COMMON, nullptr, IID_PPV_ARGS(&historyTexture));
+
+    D3D12_SHADER_RESOURCE_VIEW_DESC historySrvDesc = srvDesc;
+    historySrvDesc.Format = DXGI_FORMAT_R32G32B32A32_FLOAT;
+
+    // The full resolution G-buffer of the supersampling: color and step count, normal and depth.
+    device->CreateCommittedResource(&heapProperties, D3D12_HEAP_FLAG_NONE, &accumulationDesc,
+        D3D12_RESOURCE_STATE_COMMON, nullptr, IID_PPV_ARGS(&m_colorTexture));
+    device->CreateCommittedResource(&heapProperties, D3D12_HEAP_FLAG_NONE, &accumulationDesc,
+        D3D12_RESOURCE_STATE_COMMON, nullptr, IID_PPV_ARGS(&m_geometryTexture));
+
+    D3D12_UNORDERED_ACCESS_VIEW_DESC edgeHistogramUavDesc = {};
+    edgeHistogramUavDesc.Format = DXGI_FORMAT_UNKNOWN;
+    edgeHistogramUavDesc.ViewDimension = D3D12_UAV_DIMENSION_BUFFER;
+    edgeHistogramUavDesc.Buffer.NumElements = EDGE_BUCKETS;
+    edgeHistogramUavDesc.Buffer.StructureByteStride = sizeof(uint32_t);
+
+    // The compact G-buffer of the deferred shading: depth, then the packed normal, step count and material.
+    auto gBufferDesc = textureDesc;
+    gBufferDesc.Format = DXGI_FORMAT_R32G32_UINT;
+
+    device->CreateCommittedResource(&heapProperties, D3D12_HEAP_FLAG_NONE, &gBufferDesc,
+        D3D12_RESOURCE_STATE_COMMON, nullptr, IID_PPV_ARGS(&m_gBufferTexture));
+
+    D3D12_UNORDERED_ACCESS_VIEW_DESC gBufferUavDesc = {};
+    gBufferUavDesc.Format = DXGI_FORMAT_R32G32_UINT;
+    gBufferUavDesc.ViewDimension = D3D12_UAV_DIMENSION_TEXTURE2D;
+
+    D3D12_SHADER_RESOURCE_VIEW_DESC shadowCacheSrvDesc = {};
+    shadowCacheSrvDesc.Format = DXGI_FORMAT_R8_UNORM;
+    shadowCacheSrvDesc.ViewDimension = D3D12_SRV_DIMENSION_TEXTURE3D;
+    shadowCacheSrvDesc.Shader4ComponentMapping = D3D12_DEFAULT_SHADER_4_COMPONENT_MAPPING;
+    shadowCacheSrvDesc.Texture3D.MipLevels = 1;
+
+    const auto descriptorSize = device->GetDescriptorHandleIncrementSize(D3D12_DESCRIPTOR_HEAP_TYPE_CBV_SRV_UAV);
+    for (uint32_t depthIndex = 0; depthIndex < 2; depthIndex++)
+    {
+        CD3DX12_CPU_DESCRIPTOR_HANDLE descriptor(m_fractalTextureDescriptorUavHeap->GetCPUDescriptorHandleForHeapStart(),
+                                                 depthIndex * RAY_MARCHER_DESCRIPTORS, descriptorSize);
+        device->CreateUnorderedAccessView(m_fractalsTexture.Get(), nullptr, &uavDesc, descriptor);
+        descriptor.Offset(1, descriptorSize);
+        device->CreateUnorderedAccessView(m_depthTextures[depthIndex].Get(), nullptr, &depthUavDesc, descriptor);
+        descriptor.Offset(1, descriptorSize);
+        device->CreateUnorderedAccessView(m_accumulationTexture.Get(), nullptr, &accumulationUavDesc, descriptor);
+        descriptor.Offset(1, descriptorSize);
+        device->CreateUnorderedAccessView(m_halfColorTexture.Get(), nullptr, &accumulationUavDesc, descriptor);
+        descriptor.Offset(1, descriptorSize);
+        device->CreateUnorderedAccessView(m_halfGeometryTexture.Get(), nullptr, &accumulationUavDesc, descriptor);
+        descriptor.Offset(1, descriptorSize);
+        device->CreateUnorderedAccessView(m_historyTextures[depthIndex].Get(), nullptr, &accumulationUavDesc,
+                                          descriptor);
+        descriptor.Offset(1, descriptorSize);
+        device->CreateUnorderedAccessView(m_colorTexture.Get(), nullptr, &accumulationUavDesc, descriptor);
+        descriptor.Offset(1, descriptorSize);
+        device->CreateUnorderedAccessView(m_geometryTexture.Get(), nullptr, &accumulationUavDesc, descriptor);
+        descriptor.Offset(1, descriptorSize);
+        device->CreateUnorderedAccessView(m_edgeHistogramBuffer.Get(), nullptr, &edgeHistogramUavDesc, descriptor);
+        descriptor.Offset(1, descriptorSize);
+        device->CreateUnorderedAccessView(m_gBufferTexture.Get(), nullptr, &gBufferUavDesc, descriptor);
+        descriptor.Offset(1, descriptorSize);
+        device->CreateShaderResourceView(m_depthTextures[depthIndex ^ 1].Get(), &depthSrvDesc, descriptor);
+        descriptor.Offset(1, descriptorSize);
+        device->CreateShaderResourceView(m_historyTextures[depthIndex ^ 1].Get(), &historySrvDesc, descriptor);
+        descriptor.Offset(1, descriptorSize);
+        device->CreateShaderResourceView(m_shadowCacheTexture.Get(), &shadowCacheSrvDesc, descriptor);
+    }
+
+    m_frameState.Reset();
 }
 
 void FractalRadio::CreateFullscreenQuadPipeline(ComPtr<ID3D12Device2> device)
@@ -306,13 +735,15 @@ void FractalRadio::CreateFullscreenQuadPipeline(ComPtr<ID3D12Device2> device)
         
     CD3DX12_DESCRIPTOR_RANGE1 textureSrv(D3D12_DESCRIPTOR_RANGE_TYPE_SRV, 1, 0, 0, D3D12_DESCRIPTOR_RANGE_FLAG_DESCRIPTORS_VOLATILE);
 
-    CD3DX12_ROOT_PARAMETER1 rootParameters[1] = {};
+    CD3DX12_ROOT_PARAMETER1 rootParameters[2] = {};
 
     rootParameters[0].InitAsDescriptorTable(1, &textureSrv, D3D12_SHADER_VISIBILITY_PIXEL);
+    rootParameters[1].InitAsConstants(2, 0, 0, D3D12_SHADER_VISIBILITY_PIXEL);
     CD3DX12_STATIC_SAMPLER_DESC pointClampSampler(0, D3D12_FILTER_COMPARISON_MIN_MAG_MIP_POINT, D3D12_TEXTURE_ADDRESS_MODE_CLAMP, D3D12_TEXTURE_ADDRESS_MODE_CLAMP, D3D12_TEXTURE_ADDRESS_MODE_CLAMP);
 
     CD3DX12_VERSIONED_ROOT_SIGNATURE_DESC rootSignatureDescription;
-    rootSignatureDescription.Init_1_1(1, rootParameters, 1, &pointClampSampler, rootSignatureFlags);
+    rootSignatureDescription.Init_1_1(_countof(rootParameters), rootParameters, 1, &pointClampSampler,
+                                      rootSignatureFlags);
 
     ComPtr<ID3DBlob> rootSignatureBlob;
     ComPtr<ID3DBlob> errorBlob;
@@ -1,15 +1,12 @@
 #pragma once
 #include "Camera.h"
+#include "D3D12Graphics.h"
 #include "Demo.h"
+#include "FrameState.h"
+#include "ShadowCacheBuilder.h"
 
 class FractalRadio final : public Demo
 {
-    struct RayMarcherBuffer
-    {
-        DirectX::XMFLOAT2 WindowSize;
-        DirectX::XMMATRIX CameraMatrix;
-    };
-
 public:
 
     struct Vertex
@@ -18,17 +15,21 @@ public:
         DirectX::XMFLOAT2 Uv;
     };
 
-    explicit FractalRadio(std::shared_ptr<Graphics>);
+    explicit FractalRadio(std::shared_ptr<D3D12Graphics>);
 
     void Resize(uint32_t, uint32_t) override;
     void MouseMoved(float, float)   override;
+    void KeyPressed(uint32_t)       override;
 
     void Update(float)              override;
     void Render()                   override;
 
 private:
     
-    void                                         RenderFractal(Microsoft::WRL::ComPtr<ID3D12GraphicsCommandList2>);
+    void                                         RenderFractal(Microsoft::WRL::ComPtr<ID3D12GraphicsCommandList2>,
+                                                               const RayMarcherBuffer&);
+    void                                         UploadShadowCache(Microsoft::WRL::ComPtr<ID3D12GraphicsCommandList2>,
+                                                                   const RayMarcherBuffer&);
 
     void                                         CreateRayMarcherPipeline(Microsoft::WRL::ComPtr<ID3D12Device2>);
     void                                         CreateRayMarcherTexture(Microsoft::WRL::ComPtr<ID3D12Device2>);
@@ -36,14 +37,32 @@ private:
 
     static uint32_t                              GetComputerShaderGroupsCount(uint32_t, uint32_t);
 
+    std::shared_ptr<D3D12Graphics>               m_d3d12Graphics;
+
     Microsoft::WRL::ComPtr<ID3D12Resource>       m_vertexBuffer;
     Microsoft::WRL::ComPtr<ID3D12Resource>       m_indexBuffer;
                                                  
     Microsoft::WRL::ComPtr<ID3D12Resource>       m_fractalsTexture;
+    Microsoft::WRL::ComPtr<ID3D12Resource>       m_depthTextures[2];
+    Microsoft::WRL::ComPtr<ID3D12Resource>       m_accumulationTexture;
+    Microsoft::WRL::ComPtr<ID3D12Resource>       m_halfColorTexture;
+    Microsoft::WRL::ComPtr<ID3D12Resource>       m_halfGeometryTexture;
+    Microsoft::WRL::ComPtr<ID3D12Resource>       m_historyTextures[2];
+    Microsoft::WRL::ComPtr<ID3D12Resource>       m_colorTexture;
+    Microsoft::WRL::ComPtr<ID3D12Resource>       m_geometryTexture;
+    Microsoft::WRL::ComPtr<ID3D12Resource>       m_edgeHistogramBuffer;
+    Microsoft::WRL::ComPtr<ID3D12Resource>       m_gBufferTexture;
+    Microsoft::WRL::ComPtr<ID3D12Resource>       m_shadowCacheTexture;
+    Microsoft::WRL::ComPtr<ID3D12Resource>       m_shadowCacheUploadBuffer;
     Microsoft::WRL::ComPtr<ID3D12DescriptorHeap> m_fractalTextureDescriptorUavHeap;
     Microsoft::WRL::ComPtr<ID3D12DescriptorHeap> m_fractalTextureDescriptorSrvHeap;
     Microsoft::WRL::ComPtr<ID3D12RootSignature>  m_fractalRootSignature;
     Microsoft::WRL::ComPtr<ID3D12PipelineState>  m_fractalPipelineState;
+    Microsoft::WRL::ComPtr<ID3D12PipelineState>  m_upsamplePipelineState;
+    Microsoft::WRL::ComPtr<ID3D12PipelineState>  m_reconstructPipelineState;
+    Microsoft::WRL::ComPtr<ID3D12PipelineState>  m_edgeHistogramPipelineState;
+    Microsoft::WRL::ComPtr<ID3D12PipelineState>  m_supersamplePipelineState;
+    Microsoft::WRL::ComPtr<ID3D12PipelineState>  m_lightingPipelineState;
 
     Microsoft::WRL::ComPtr<ID3D12RootSignature>  m_drawRootSignature;
     Microsoft::WRL::ComPtr<ID3D12PipelineState>  m_drawPipelineState;
@@ -52,4 +71,7 @@ private:
     D3D12_INDEX_BUFFER_VIEW                      m_indexBufferView{};
 
     std::unique_ptr<Camera>                      m_camera;
+
+    FrameState                                   m_frameState;
+    ShadowCacheBuilder                           m_shadowCacheBuilder;
 };
@@ -0,0 +1,287 @@
+#include "pch.h"
+
+#include "FrameState.h"
+#include "CpuRayMarcher.h"
+
+#include <cmath>
+#include <cstring>
+
+using namespace std;
+
+FrameState::FrameState(const Settings& settings) :
+    m_settings(settings),
+    m_lightAngle(0.0f),
+    m_dynamicResolution(settings.FrameBudget),
+    m_depthIndex(0),
+    m_hasPreviousDepth(false),
+    m_hasHistory(false),
+    m_previousCameraMatrix(MatrixIdentity()),
+    m_frameIndex(0),
+    m_lastRayMarcherData(),
+    m_hasFractal(false),
+    m_isInterleavedFractal(false),
+    m_skippedFrames(0),
+    m_accumulatedSamples(0),
+    m_gBufferRayMarcherData(),
+    m_hasGBuffer(false),
+    m_shadowCacheRayMarcherData(),
+    m_hasShadowCache(false)
+{
+}
+
+// Changing the reprojection, the interleaving or the frame budget drops the history they kept, and switching the
+// deferred shading the G-buffer.
+void FrameState::SetSettings(const Settings& settings)
+{
+    if (settings.Reprojection != m_settings.Reprojection)
+        m_hasPreviousDepth = false;
+    if (settings.Interleave != m_settings.Interleave)
+        m_hasHistory = false;
+    if (settings.Deferred != m_settings.Deferred)
+        m_hasGBuffer = false;
+    if (settings.FrameBudget != m_settings.FrameBudget)
+    {
+        m_dynamicResolution.SetBudget(settings.FrameBudget);
+        m_hasPreviousDepth = false;
+        m_hasHistory = false;
+    }
+    m_settings = settings;
+}
+
+void FrameState::Update(const float deltaTime)
+{
+    m_lightAngle += m_settings.LightSpeed * deltaTime;
+}
+
+// Forgets what the textures held, after the backend recreated them.
+void FrameState::Reset()
+{
+    m_hasGBuffer = false;
+    m_hasPreviousDepth = false;
+    m_hasHistory = false;
+    m_hasFractal = false;
+}
+
+// When nothing that reaches the ray marcher changed, the fractal texture already holds this frame and only the
+// composite runs. With accumulation a still view instead adds one jittered sample per frame until
+// MAX_ACCUMULATED_SAMPLES; those rays are off the pixel centres, so they neither reuse nor record the depth, and march
+// every pixel without supersampling. An interleaved frame reconstructed half of its pixels, so a still view first
+// replaces it with a whole one.
+FrameState::Frame FrameState::BeginFrame(const uint32_t clientWidth, const uint32_t clientHeight,
+                                         const Float4x4& cameraMatrix)
+{
+    Frame frame = {};
+    frame.RayMarcherData = GetRayMarcherData(clientWidth, clientHeight, cameraMatrix);
+    RayMarcherBuffer& rayMarcherData = frame.RayMarcherData;
+
+    frame.IsStill = m_hasFractal && IsSameFractal(rayMarcherData, m_lastRayMarcherData);
+    if (frame.IsStill && !m_isInterleavedFractal &&
+        !(m_settings.Accumulation && m_accumulatedSamples < MAX_ACCUMULATED_SAMPLES))
+    {
+        frame.IsSkipped = true;
+        m_skippedFrames++;
+        return frame;
+    }
+
+    if (frame.IsStill)
+    {
+        rayMarcherData.Reprojection = 0;
+        rayMarcherData.HalfResolution = 0;
+        rayMarcherData.Interleave = 0;
+        rayMarcherData.SupersampleBudget = 0.0f;
+        rayMarcherData.SampleIndex = m_isInterleavedFractal ? 0 : m_accumulatedSamples;
+    }
+    else
+    {
+        m_lastRayMarcherData = rayMarcherData;
+        m_hasFractal = true;
+    }
+
+    // When only the light changed since the last deferred march, the G-buffer already holds the primary hits and the
+    // frame is just relit. It neither reuses nor records the depth.
+    frame.IsRelit = rayMarcherData.Deferred && m_hasGBuffer &&
+        IsSameGeometry(rayMarcherData, m_gBufferRayMarcherData);
+    if (frame.IsRelit)
+    {
+        rayMarcherData.Deferred = DEFERRED_RELIGHT;
+        rayMarcherData.Reprojection = 0;
+    }
+
+    // The shadow cache is built before the frame that first needs it, and kept while the shadows stay the same.
+    frame.BuildShadowCache = rayMarcherData.ShadowCacheCellSize > 0.0f &&
+        !(m_hasShadowCache && IsSameShadowCache(rayMarcherData, m_shadowCacheRayMarcherData));
+    if (frame.BuildShadowCache)
+    {
+        m_shadowCacheRayMarcherData = rayMarcherData;
+        m_hasShadowCache = true;
+    }
+    return frame;
+}
+
+// Records what the marched frame left in the textures. Only new views drive the resolution, so that it stays put while
+// a still view accumulates or is relit; the previous depth is at the old one.
+void FrameState::EndFrame(const Frame& frame, const double renderSeconds)
+{
+    const RayMarcherBuffer& rayMarcherData = frame.RayMarcherData;
+
+    // The depth and history textures alternate between frames: the ones written this frame are read by the next.
+    if (rayMarcherData.Reprojection || rayMarcherData.Interleave)
+    {
+        m_previousCameraMatrix = rayMarcherData.CameraMatrix;
+        m_hasPreviousDepth = rayMarcherData.Reprojection != 0;
+        m_hasHistory = rayMarcherData.Interleave != 0;
+        m_depthIndex ^= 1;
+    }
+
+    m_frameIndex++;
+
+    m_isInterleavedFractal = rayMarcherData.Interleave >= INTERLEAVE_CHECKER;
+    m_accumulatedSamples = rayMarcherData.SampleIndex + 1;
+
+    if (rayMarcherData.Deferred == DEFERRED_MARCH)
+    {
+        m_gBufferRayMarcherData = rayMarcherData;
+        m_hasGBuffer = true;
+    }
+
+    if (!frame.IsStill && !frame.IsRelit && m_dynamicResolution.Update(renderSeconds))
+    {
+        m_hasPreviousDepth = false;
+        m_hasHistory = false;
+    }
+}
+
+const FrameState::Settings& FrameState::GetSettings() const
+{
+    return m_settings;
+}
+
+// The constants the fractal texture was last marched with; its top left WindowSize holds the view.
+const RayMarcherBuffer& FrameState::GetLastRayMarcherData() const
+{
+    return m_lastRayMarcherData;
+}
+
+// Which of the two depth and history textures the next frame writes.
+uint32_t FrameState::GetDepthIndex() const
+{
+    return m_depthIndex;
+}
+
+uint64_t FrameState::GetSkippedFrames() const
+{
+    return m_skippedFrames;
+}
+
+// Samples averaged into the current fractal texture, one without accumulation.
+uint32_t FrameState::GetAccumulatedSamples() const
+{
+    return m_accumulatedSamples;
+}
+
+const DynamicResolution& FrameState::GetDynamicResolution() const
+{
+    return m_dynamicResolution;
+}
+
+RayMarcherBuffer FrameState::GetRayMarcherData(const uint32_t clientWidth, const uint32_t clientHeight,
+                                               const Float4x4& cameraMatrix) const
+{
+    // Value initialized, so the padding compares equal in IsSameFractal.
+    RayMarcherBuffer rayMarcherData = {};
+    rayMarcherData.WindowSize = Float2{
+        static_cast<float>(m_dynamicResolution.GetScaledSize(clientWidth)),
+        static_cast<float>(m_dynamicResolution.GetScaledSize(clientHeight))
+    };
+    rayMarcherData.CameraMatrix = cameraMatrix;
+    rayMarcherData.AnalyticNormals = m_settings.AnalyticNormals;
+    rayMarcherData.OverRelaxation = m_settings.OverRelaxation;
+    rayMarcherData.HitTolerance = m_settings.HitTolerance;
+    rayMarcherData.ConeScale = m_settings.ConeScale;
+    rayMarcherData.Prepass = m_settings.Prepass;
+
+    // The first frame after enabling reprojection or resizing has nothing to reproject and only records its depth.
+    rayMarcherData.Reprojection = 0;
+    if (m_settings.Reprojection)
+        rayMarcherData.Reprojection = m_hasPreviousDepth ? REPROJECTION_REUSE : REPROJECTION_RECORD;
+    rayMarcherData.FrameIndex = m_frameIndex;
+    rayMarcherData.PreviousCameraMatrix = m_previousCameraMatrix;
+    rayMarcherData.Accumulation = m_settings.Accumulation;
+    rayMarcherData.SampleIndex = 0;
+    rayMarcherData.HalfResolution = m_settings.HalfResolution;
+
+    // Interleaving needs the previous frame whole; the half resolution mode takes precedence.
+    rayMarcherData.Interleave = 0;
+    if (m_settings.Interleave && !m_settings.HalfResolution)
+        rayMarcherData.Interleave = m_hasHistory ? m_settings.Interleave : INTERLEAVE_RECORD;
+
+    // Supersampling needs every pixel centre marched.
+    rayMarcherData.SupersampleBudget = 0.0f;
+    if (!m_settings.HalfResolution && !m_settings.Interleave)
+        rayMarcherData.SupersampleBudget = m_settings.SupersampleBudget;
+
+    // LIGHT_DIRECTION turned around the vertical axis.
+    const float cosine = cos(m_lightAngle);
+    const float sine = sin(m_lightAngle);
+    rayMarcherData.LightDirection = Float3{
+        LIGHT_DIRECTION.X * cosine - LIGHT_DIRECTION.Z * sine,
+        LIGHT_DIRECTION.Y,
+        LIGHT_DIRECTION.X * sine + LIGHT_DIRECTION.Z * cosine
+    };
+
+    // The lighting pass shades whole frames of pixel centres, which the other modes leave partly to their own passes.
+    rayMarcherData.Deferred = 0;
+    if (m_settings.Deferred && !m_settings.HalfResolution && !m_settings.Interleave)
+        rayMarcherData.Deferred = DEFERRED_MARCH;
+    rayMarcherData.ShadowSoftness = m_settings.ShadowSoftness;
+
+    // The shadow cache follows the eye over the floor.
+    rayMarcherData.ShadowCacheCellSize = 0.0f;
+    rayMarcherData.ShadowCacheCells = m_settings.ShadowCacheCells;
+    rayMarcherData.ShadowCacheOrigin = Float3{ 0.0f, 0.0f, 0.0f };
+    if (m_settings.ShadowCacheCells)
+    {
+        const Float3 eye = TransformPoint(Float3{ 0.0f, 0.0f, 0.0f }, rayMarcherData.CameraMatrix);
+        rayMarcherData.ShadowCacheCellSize = m_settings.ShadowCacheCellSize;
+        rayMarcherData.ShadowCacheOrigin = CpuRayMarcher::GetShadowCacheOrigin(eye, m_settings.ShadowCacheCells,
+                                                                               m_settings.ShadowCacheCellSize);
+    }
+    return rayMarcherData;
+}
+
+// The scene itself is fixed in the ray marcher, so the constants decide the image. FrameIndex only rotates the
+// reprojection refresh and is left out.
+bool FrameState::IsSameFractal(const RayMarcherBuffer& a, const RayMarcherBuffer& b)
+{
+    RayMarcherBuffer c = b;
+    c.FrameIndex = a.FrameIndex;
+    return !memcmp(&a, &c, sizeof(RayMarcherBuffer));
+}
+
+// Whether the G-buffer marched with b holds the primary hits of a: the constants that only light, post-process or
+// record the frame are left out.
+bool FrameState::IsSameGeometry(const RayMarcherBuffer& a, const RayMarcherBuffer& b)
+{
+    RayMarcherBuffer c = b;
+    c.Reprojection = a.Reprojection;
+    c.FrameIndex = a.FrameIndex;
+    c.PreviousCameraMatrix = a.PreviousCameraMatrix;
+    c.Accumulation = a.Accumulation;
+    c.SupersampleBudget = a.SupersampleBudget;
+    c.LightDirection = a.LightDirection;
+    c.Deferred = a.Deferred;
+    c.ShadowSoftness = a.ShadowSoftness;
+    c.ShadowCacheCellSize = a.ShadowCacheCellSize;
+    c.ShadowCacheCells = a.ShadowCacheCells;
+    c.ShadowCacheOrigin = a.ShadowCacheOrigin;
+    return !memcmp(&a, &c, sizeof(RayMarcherBuffer));
+}
+
+// Whether the shadow cache built with b holds the shadows of a: only the constants that MarchShadow reads count.
+bool FrameState::IsSameShadowCache(const RayMarcherBuffer& a, const RayMarcherBuffer& b)
+{
+    return a.OverRelaxation == b.OverRelaxation && a.ShadowSoftness == b.ShadowSoftness &&
+        !memcmp(&a.LightDirection, &b.LightDirection, sizeof(Float3)) &&
+        a.ShadowCacheCellSize == b.ShadowCacheCellSize && a.ShadowCacheCells == b.ShadowCacheCells &&
+        !memcmp(&a.ShadowCacheOrigin, &b.ShadowCacheOrigin, sizeof(Float3));
+}
@@ -0,0 +1,95 @@
+#pragma once
+
+#include <cstdint>
+
+#include "DynamicResolution.h"
+#include "RayMarcherBuffer.h"
+#include "RayMarcherConstants.h"
+
+// Per-frame state of the ray marcher shared by FractalRadio and HeadlessFractalRadio. It fills each frame's
+// RayMarcherBuffer from the settings and decides whether the frame is skipped, accumulated or relit and whether the
+// shadow cache needs building; the backends march what it hands them and report back the time it took.
+class FrameState
+{
+public:
+
+    // Rendering options. Interleave is INTERLEAVE_CHECKER or INTERLEAVE_ROWS, zero for off. SupersampleBudget is in
+    // extra rays per pixel, zero for off. LightSpeed turns the light around the vertical axis, in radians per second.
+    // ShadowSoftness is the penumbra factor of the soft shadows, zero for hard ones. ShadowCacheCells is the size of
+    // the shadow cache along x and z, zero for off, and ShadowCacheCellSize the world distance between its texels.
+    // FrameBudget is the ray marching time per frame that dynamic resolution aims for, zero for off.
+    struct Settings
+    {
+        bool     AnalyticNormals     = false;
+        float    OverRelaxation      = 1.0f;
+        float    HitTolerance        = MINIMUM_DISTANCE;
+        float    ConeScale           = 0.0f;
+        bool     Prepass             = false;
+        bool     Reprojection        = false;
+        bool     Accumulation        = false;
+        bool     HalfResolution      = false;
+        uint32_t Interleave          = 0;
+        float    SupersampleBudget   = 0.0f;
+        bool     Deferred            = false;
+        float    LightSpeed          = 0.0f;
+        float    ShadowSoftness      = 0.0f;
+        uint32_t ShadowCacheCells    = 0;
+        float    ShadowCacheCellSize = 0.125f;
+        double   FrameBudget         = 0.0;
+    };
+
+    // What the backend does with a frame. A skipped frame only composites the last one; otherwise RayMarcherData is
+    // marched, after building the shadow cache of it when BuildShadowCache is set.
+    struct Frame
+    {
+        RayMarcherBuffer RayMarcherData;
+        bool             IsSkipped;
+        bool             IsStill;
+        bool             IsRelit;
+        bool             BuildShadowCache;
+    };
+
+    explicit FrameState(const Settings&);
+
+    void                     SetSettings(const Settings&);
+    void                     Update(float);
+    void                     Reset();
+
+    Frame                    BeginFrame(uint32_t, uint32_t, const Float4x4&);
+    void                     EndFrame(const Frame&, double);
+
+    const Settings&          GetSettings()           const;
+    const RayMarcherBuffer&  GetLastRayMarcherData() const;
+    uint32_t                 GetDepthIndex()         const;
+    uint64_t                 GetSkippedFrames()      const;
+    uint32_t                 GetAccumulatedSamples() const;
+    const DynamicResolution& GetDynamicResolution()  const;
+
+private:
+
+    RayMarcherBuffer         GetRayMarcherData(uint32_t, uint32_t, const Float4x4&) const;
+
+    static bool              IsSameFractal(const RayMarcherBuffer&, const RayMarcherBuffer&);
+    static bool              IsSameGeometry(const RayMarcherBuffer&, const RayMarcherBuffer&);
+    static bool              IsSameShadowCache(const RayMarcherBuffer&, const RayMarcherBuffer&);
+
+    Settings                 m_settings;
+    float                    m_lightAngle;
+    DynamicResolution        m_dynamicResolution;
+
+    uint32_t                 m_depthIndex;
+    bool                     m_hasPreviousDepth;
+    bool                     m_hasHistory;
+    Float4x4                 m_previousCameraMatrix;
+    uint32_t                 m_frameIndex;
+
+    RayMarcherBuffer         m_lastRayMarcherData;
+    bool                     m_hasFractal;
+    bool                     m_isInterleavedFractal;
+    uint64_t                 m_skippedFrames;
+    uint32_t                 m_accumulatedSamples;
+    RayMarcherBuffer         m_gBufferRayMarcherData;
+    bool                     m_hasGBuffer;
+    RayMarcherBuffer         m_shadowCacheRayMarcherData;
+    bool                     m_hasShadowCache;
+};
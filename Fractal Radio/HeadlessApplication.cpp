@@ -0,0 +1,16 @@
+#include "pch.h"
+
+#include "HeadlessApplication.h"
+
+using namespace std;
+
+HeadlessApplication::HeadlessApplication(const uint32_t clientWidth, const uint32_t clientHeight,
+                                         const uint8_t numFrames, const uint32_t numThreads)
+{
+    m_graphics = make_shared<CpuGraphics>(clientWidth, clientHeight, numFrames, numThreads);
+}
+
+shared_ptr<CpuGraphics> HeadlessApplication::GetGraphics() const
+{
+    return m_graphics;
+}
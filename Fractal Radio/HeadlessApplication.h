@@ -0,0 +1,39 @@
+#pragma once
+
+#include <chrono>
+#include <memory>
+
+#include "CpuGraphics.h"
+
+// Headless counterpart of Application: renders a fixed number of frames without a window.
+class HeadlessApplication
+{
+public:
+
+    HeadlessApplication(uint32_t, uint32_t, uint8_t, uint32_t);
+
+    template <class T, class... Args>
+    std::shared_ptr<T> Run(uint32_t, float, const Args&...) const;
+
+    std::shared_ptr<CpuGraphics> GetGraphics() const;
+
+private:
+
+    std::shared_ptr<CpuGraphics> m_graphics{};
+};
+
+// The frames are advanced by a fixed time step so that runs are reproducible; wall time is measured by the demo.
+// Extra arguments are passed on to the demo's constructor.
+template <class T, class... Args>
+std::shared_ptr<T> HeadlessApplication::Run(const uint32_t numFrames, const float deltaTime, const Args&... args) const
+{
+    std::shared_ptr<T> demo = std::make_shared<T>(m_graphics, args...);
+
+    for (uint32_t frame = 0; frame < numFrames; frame++)
+    {
+        demo->Update(deltaTime);
+        demo->Render();
+    }
+
+    return demo;
+}
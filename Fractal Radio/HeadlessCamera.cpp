@@ -0,0 +1,36 @@
+#include "pch.h"
+
+#include "HeadlessCamera.h"
+
+constexpr auto MOVE_SPEED    = 2.0f;
+constexpr auto TURN_SPEED    = 0.25f;
+constexpr auto TURN_ANGLE    = 0.35f;
+constexpr auto PITCH_ANGLE   = 0.1f;
+
+HeadlessCamera::HeadlessCamera() :
+    m_position{ 0.0f, 0.0f, -5.0f },
+    m_rotation{ 0.0f, 0.0f },
+    m_time(0.0f)
+{
+}
+
+void HeadlessCamera::Update(const float deltaTime)
+{
+    m_time += deltaTime;
+
+    m_rotation.X = PITCH_ANGLE * std::sin(m_time * TURN_SPEED * 2.0f);
+    m_rotation.Y = TURN_ANGLE * std::sin(m_time * TURN_SPEED);
+
+    const Float4x4 rotationMatrix = MatrixMultiply(MatrixRotationX(m_rotation.X), MatrixRotationY(m_rotation.Y));
+    const Float3 forward = TransformDirection(Float3{ 0.0f, 0.0f, 1.0f }, rotationMatrix);
+
+    m_position += forward * (MOVE_SPEED * deltaTime);
+}
+
+Float4x4 HeadlessCamera::GetMatrix() const
+{
+    Float4x4 result = MatrixRotationX(m_rotation.X);
+    result = MatrixMultiply(result, MatrixRotationY(m_rotation.Y));
+    result = MatrixMultiply(result, MatrixTranslation(m_position.X, m_position.Y, m_position.Z));
+    return result;
+}
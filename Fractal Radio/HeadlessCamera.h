@@ -0,0 +1,22 @@
+#pragma once
+
+#include "CpuMath.h"
+
+// Counterpart of Camera for the headless backend. Instead of keyboard and mouse input it follows a fixed flythrough,
+// so consecutive runs render the same frames and can be compared against each other.
+class HeadlessCamera
+{
+public:
+
+    HeadlessCamera();
+
+    void     Update(float);
+
+    Float4x4 GetMatrix() const;
+
+private:
+
+    Float3 m_position;
+    Float2 m_rotation;
+    float  m_time;
+};
@@ -0,0 +1,219 @@
+#include "pch.h"
+
+#include "HeadlessFractalRadio.h"
+
+#include <chrono>
+#include <cstdio>
+
+using namespace std;
+using namespace std::chrono;
+
+HeadlessFractalRadio::HeadlessFractalRadio(const shared_ptr<CpuGraphics> graphics, const Settings& settings) :
+    Demo(graphics),
+    m_cpuGraphics(graphics),
+    m_rayMarcher(graphics->GetTaskScheduler(), graphics->GetMarchKernels()),
+    m_frameState(settings),
+    m_relitFrames(0),
+    m_relightSeconds(0.0),
+    m_shadowCacheBuilds(0),
+    m_shadowCacheSeconds(0.0),
+    m_stillCamera(settings.StillCamera),
+    m_renderSeconds(0.0),
+    m_frameCounter(0),
+    m_elapsedSeconds(0.0),
+    m_lastTimePoint(high_resolution_clock::now()),
+    m_lastRays(0)
+{
+    CreateRayMarcherTexture();
+
+    m_camera = make_unique<HeadlessCamera>();
+}
+
+void HeadlessFractalRadio::Resize(uint32_t, uint32_t)
+{
+    CreateRayMarcherTexture();
+}
+
+void HeadlessFractalRadio::Update(const float deltaTime)
+{
+    // The camera advances by the fixed deltaTime, while the FPS printout uses wall time.
+    m_frameCounter++;
+    const auto crtTimePoint = high_resolution_clock::now();
+    m_elapsedSeconds += duration<double>(crtTimePoint - m_lastTimePoint).count();
+    m_lastTimePoint = crtTimePoint;
+
+    if (m_elapsedSeconds > 1.0)
+    {
+        const auto statistics = m_rayMarcher.GetStatistics();
+        const auto fps = m_frameCounter / m_elapsedSeconds;
+        const auto raysPerSecond = (statistics.Rays - m_lastRays) / m_elapsedSeconds;
+        printf("FPS: %f, rays/s: %.0f, skipped frames: %llu, resolution scale: %.2f\n", fps, raysPerSecond,
+               static_cast<unsigned long long>(m_frameState.GetSkippedFrames()),
+               m_frameState.GetDynamicResolution().GetScale());
+
+        m_frameCounter = 0;
+        m_elapsedSeconds = 0.0;
+        m_lastRays = statistics.Rays;
+    }
+
+    if (!m_stillCamera)
+        m_camera->Update(deltaTime);
+    m_frameState.Update(deltaTime);
+}
+
+void HeadlessFractalRadio::Render()
+{
+    float clearColor[] = { 0.4f, 0.6f, 0.9f, 1.0f };
+
+    const FrameState::Frame frame = m_frameState.BeginFrame(m_cpuGraphics->GetClientWidth(),
+                                                            m_cpuGraphics->GetClientHeight(), m_camera->GetMatrix());
+    if (!frame.IsSkipped)
+    {
+        const double renderSeconds = RenderFractal(frame);
+        if (frame.IsRelit)
+        {
+            m_relitFrames++;
+            m_relightSeconds += renderSeconds;
+        }
+        m_frameState.EndFrame(frame, renderSeconds);
+    }
+
+    auto& backBuffer = m_cpuGraphics->BeginFrame();
+
+    m_cpuGraphics->ClearRenderTarget(clearColor);
+
+    CompositeFractal(backBuffer);
+
+    m_cpuGraphics->EndFrame();
+}
+
+CpuRayMarcher::Statistics HeadlessFractalRadio::GetStatistics() const
+{
+    return m_rayMarcher.GetStatistics();
+}
+
+double HeadlessFractalRadio::GetRenderSeconds() const
+{
+    return m_renderSeconds;
+}
+
+uint64_t HeadlessFractalRadio::GetSkippedFrames() const
+{
+    return m_frameState.GetSkippedFrames();
+}
+
+// Samples averaged into the current fractal texture, one without accumulation.
+uint32_t HeadlessFractalRadio::GetAccumulatedSamples() const
+{
+    return m_frameState.GetAccumulatedSamples();
+}
+
+// Deferred frames that only the light changed, which skipped the march, and the time they took.
+uint64_t HeadlessFractalRadio::GetRelitFrames() const
+{
+    return m_relitFrames;
+}
+
+double HeadlessFractalRadio::GetRelightSeconds() const
+{
+    return m_relightSeconds;
+}
+
+// Times the shadow cache was built, the time that took and the memory it holds.
+uint64_t HeadlessFractalRadio::GetShadowCacheBuilds() const
+{
+    return m_shadowCacheBuilds;
+}
+
+double HeadlessFractalRadio::GetShadowCacheSeconds() const
+{
+    return m_shadowCacheSeconds;
+}
+
+size_t HeadlessFractalRadio::GetShadowCacheBytes() const
+{
+    return m_shadowCacheTexture.GetTexels().size();
+}
+
+const DynamicResolution& HeadlessFractalRadio::GetDynamicResolution() const
+{
+    return m_frameState.GetDynamicResolution();
+}
+
+// Returns the time the ray marcher took, which is what dynamic resolution budgets.
+double HeadlessFractalRadio::RenderFractal(const FrameState::Frame& frame)
+{
+    const RayMarcherBuffer& rayMarcherData = frame.RayMarcherData;
+
+    // The time of the shadow cache is counted apart from the frame's.
+    if (frame.BuildShadowCache)
+    {
+        const auto buildStartTime = high_resolution_clock::now();
+        m_rayMarcher.BuildShadowCache(rayMarcherData, m_shadowCacheTexture);
+        m_shadowCacheSeconds += duration<double>(high_resolution_clock::now() - buildStartTime).count();
+        m_shadowCacheBuilds++;
+    }
+
+    const auto startTime = high_resolution_clock::now();
+
+    const uint32_t depthIndex = m_frameState.GetDepthIndex();
+    const CpuRayMarcher::RenderTargets renderTargets = {
+        &m_fractalsTexture, &m_depthTextures[depthIndex ^ 1], &m_depthTextures[depthIndex], &m_accumulationTexture,
+        &m_halfColorTexture, &m_halfGeometryTexture, &m_historyTextures[depthIndex ^ 1],
+        &m_historyTextures[depthIndex], &m_colorTexture, &m_geometryTexture, &m_gBufferTexture,
+        &m_shadowCacheTexture
+    };
+    m_rayMarcher.Render(rayMarcherData, renderTargets);
+
+    const double renderSeconds = duration<double>(high_resolution_clock::now() - startTime).count();
+    m_renderSeconds += renderSeconds;
+    return renderSeconds;
+}
+
+// Software version of the fullscreen quad drawn with PixelShader.hlsl. The fractal texture holds the last rendered
+// view in its top left corner, which is stretched over the whole target. When the view fills the texture and the
+// target is the same size, the point sampling picks every texel once and the quad reduces to detiling the texture.
+void HeadlessFractalRadio::CompositeFractal(CpuTexture& renderTarget) const
+{
+    const uint32_t width = renderTarget.GetWidth();
+    const uint32_t height = renderTarget.GetHeight();
+    const Float2& windowSize = m_frameState.GetLastRayMarcherData().WindowSize;
+    const float uScale = windowSize.X / static_cast<float>(m_fractalsTexture.GetWidth());
+    const float vScale = windowSize.Y / static_cast<float>(m_fractalsTexture.GetHeight());
+
+    if (uScale == 1.0f && vScale == 1.0f && width == m_fractalsTexture.GetWidth() &&
+        height == m_fractalsTexture.GetHeight() && !renderTarget.IsTiled())
+    {
+        m_fractalsTexture.Detile(renderTarget);
+        return;
+    }
+
+    for (uint32_t y = 0; y < height; y++)
+    {
+        const float v = (static_cast<float>(y) + 0.5f) / static_cast<float>(height);
+        for (uint32_t x = 0; x < width; x++)
+        {
+            const float u = (static_cast<float>(x) + 0.5f) / static_cast<float>(width);
+            renderTarget.GetPixels()[static_cast<size_t>(y) * width + x] =
+                m_fractalsTexture.Sample(u * uScale, v * vScale);
+        }
+    }
+}
+
+void HeadlessFractalRadio::CreateRayMarcherTexture()
+{
+    const uint32_t width = m_cpuGraphics->GetClientWidth();
+    const uint32_t height = m_cpuGraphics->GetClientHeight();
+    m_fractalsTexture.Resize(width, height, true);
+    for (auto& depthTexture : m_depthTextures)
+        depthTexture.Resize(width, height);
+    m_accumulationTexture.Resize(width, height);
+    m_halfColorTexture.Resize((width + 1) / 2, (height + 1) / 2);
+    m_halfGeometryTexture.Resize((width + 1) / 2, (height + 1) / 2);
+    for (auto& historyTexture : m_historyTextures)
+        historyTexture.Resize(width, height);
+    m_colorTexture.Resize(width, height);
+    m_geometryTexture.Resize(width, height);
+    m_gBufferTexture.Resize(width, height);
+    m_frameState.Reset();
+}
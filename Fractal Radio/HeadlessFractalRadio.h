@@ -0,0 +1,76 @@
+#pragma once
+
+#include <chrono>
+
+#include "CpuGraphics.h"
+#include "CpuRayMarcher.h"
+#include "Demo.h"
+#include "FrameState.h"
+#include "HeadlessCamera.h"
+
+// FractalRadio running on the CPU ray marcher. Both take their frames from FrameState; this one marches them with
+// CpuRayMarcher into the fractal texture, then composites it into the back buffer.
+class HeadlessFractalRadio final : public Demo
+{
+public:
+
+    // StillCamera keeps the flythrough at its start.
+    struct Settings : FrameState::Settings
+    {
+        bool StillCamera = false;
+    };
+
+    HeadlessFractalRadio(std::shared_ptr<CpuGraphics>, const Settings&);
+
+    void                                           Resize(uint32_t, uint32_t) override;
+
+    void                                           Update(float)              override;
+    void                                           Render()                   override;
+
+    CpuRayMarcher::Statistics                      GetStatistics()            const;
+    double                                         GetRenderSeconds()         const;
+    uint64_t                                       GetSkippedFrames()         const;
+    uint32_t                                       GetAccumulatedSamples()    const;
+    uint64_t                                       GetRelitFrames()           const;
+    double                                         GetRelightSeconds()        const;
+    uint64_t                                       GetShadowCacheBuilds()     const;
+    double                                         GetShadowCacheSeconds()    const;
+    size_t                                         GetShadowCacheBytes()      const;
+    const DynamicResolution&                       GetDynamicResolution()     const;
+
+private:
+
+    double                                         RenderFractal(const FrameState::Frame&);
+    void                                           CompositeFractal(CpuTexture&) const;
+
+    void                                           CreateRayMarcherTexture();
+
+    std::shared_ptr<CpuGraphics>                   m_cpuGraphics;
+    CpuRayMarcher                                  m_rayMarcher;
+    CpuTexture                                     m_fractalsTexture;
+    CpuDepthTexture                                m_depthTextures[2];
+    CpuFloat4Texture                               m_accumulationTexture;
+    CpuFloat4Texture                               m_halfColorTexture;
+    CpuFloat4Texture                               m_halfGeometryTexture;
+    CpuFloat4Texture                               m_historyTextures[2];
+    CpuFloat4Texture                               m_colorTexture;
+    CpuFloat4Texture                               m_geometryTexture;
+    CpuGBufferTexture                              m_gBufferTexture;
+    CpuShadowCacheTexture                          m_shadowCacheTexture;
+
+    FrameState                                     m_frameState;
+    uint64_t                                       m_relitFrames;
+    double                                         m_relightSeconds;
+    uint64_t                                       m_shadowCacheBuilds;
+    double                                         m_shadowCacheSeconds;
+
+    std::unique_ptr<HeadlessCamera>                m_camera;
+    bool                                           m_stillCamera;
+
+    double                                         m_renderSeconds;
+
+    uint64_t                                       m_frameCounter;
+    double                                         m_elapsedSeconds;
+    std::chrono::high_resolution_clock::time_point m_lastTimePoint;
+    uint64_t                                       m_lastRays;
+};
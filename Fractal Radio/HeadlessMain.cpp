@@ -0,0 +1,526 @@
+#include "pch.h"
+
+#include "HeadlessApplication.h"
+#include "HeadlessFractalRadio.h"
+
+#include <algorithm>
+#include <cctype>
+#include <cerrno>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <functional>
+#include <random>
+
+using namespace std;
+using namespace std::chrono;
+
+constexpr auto DEFAULT_CLIENT_WIDTH  = 800;
+constexpr auto DEFAULT_CLIENT_HEIGHT = 600;
+constexpr auto DEFAULT_FRAMES        = 60;
+constexpr auto NUM_FRAMES            = 3;
+constexpr auto FRAME_TIME            = 1.0f / 60.0f;
+constexpr auto BENCHMARK_POINTS      = 4096;
+constexpr auto BENCHMARK_SECONDS     = 0.5;
+
+static const char* GetInterleaveName(const uint32_t interleave)
+{
+    if (interleave == INTERLEAVE_CHECKER)
+        return "checkerboard";
+    if (interleave == INTERLEAVE_ROWS)
+        return "rows";
+    return "off";
+}
+
+static void PrintReport(const HeadlessApplication& app, const HeadlessFractalRadio& demo,
+                        const HeadlessFractalRadio::Settings& settings, const uint32_t frames)
+{
+    const auto graphics = app.GetGraphics();
+    const auto taskScheduler = graphics->GetTaskScheduler();
+    const auto statistics = demo.GetStatistics();
+    const double seconds = demo.GetRenderSeconds();
+    const double pixels = static_cast<double>(graphics->GetClientWidth()) * graphics->GetClientHeight() *
+        (frames - demo.GetSkippedFrames());
+
+    printf("Rendered %u frames at %ux%u in %.3f s (%.2f ms/frame)\n", frames, graphics->GetClientWidth(),
+           graphics->GetClientHeight(), seconds, frames ? seconds * 1000.0 / frames : 0.0);
+    printf("Kernels: %s, threads: %u, stolen tiles: %llu\n", graphics->GetMarchKernels()->Name,
+           taskScheduler->GetNumThreads(), static_cast<unsigned long long>(taskScheduler->GetStolenTasks()));
+    printf("Normals: %s, over-relaxation: %.2f, hit tolerance: %g, cone scale: %g\n",
+           settings.AnalyticNormals ? "analytic (dual numbers)" : "central differences", settings.OverRelaxation,
+           settings.HitTolerance, settings.ConeScale);
+    printf("Prepass: %s, prepass steps/frame: %.0f\n", settings.Prepass ? "on" : "off",
+           frames ? static_cast<double>(statistics.PrepassSteps) / frames : 0.0);
+    printf("Reprojection: %s, reprojected primary rays: %.1f%%\n", settings.Reprojection ? "on" : "off",
+           statistics.PrimaryRays ? 100.0 * statistics.ReprojectedRays / statistics.PrimaryRays : 0.0);
+    printf("Accumulation: %s, samples in the last frame: %u\n", settings.Accumulation ? "on" : "off",
+           demo.GetAccumulatedSamples());
+    printf("Half resolution: %s, upsampled pixels: %.1f%%\n", settings.HalfResolution ? "on" : "off",
+           pixels ? 100.0 * statistics.UpsampledPixels / pixels : 0.0);
+    printf("Interleave: %s, pixels reconstructed from the previous frame: %.1f%%\n",
+           GetInterleaveName(settings.Interleave), pixels ? 100.0 * statistics.ReconstructedPixels / pixels : 0.0);
+    printf("Supersampling: %.2f extra rays per pixel, edge pixels: %.1f%%, supersampled pixels: %.1f%%\n",
+           settings.SupersampleBudget, pixels ? 100.0 * statistics.EdgePixels / pixels : 0.0,
+           pixels ? 100.0 * statistics.SupersampledPixels / pixels : 0.0);
+    const uint64_t relitFrames = demo.GetRelitFrames();
+    printf("Deferred shading: %s, G-buffer: %u bytes/pixel, light speed: %g rad/s, relit frames: %llu, %.2f ms/frame\n",
+           settings.Deferred ? "on" : "off", static_cast<uint32_t>(sizeof(Uint2)), settings.LightSpeed,
+           static_cast<unsigned long long>(relitFrames),
+           relitFrames ? demo.GetRelightSeconds() * 1000.0 / relitFrames : 0.0);
+    printf("Shadows: %s, softness: %g, shadow rays: %llu, steps per shadow ray: %.2f\n",
+           settings.ShadowSoftness > 0.0f ? "soft" : "hard", settings.ShadowSoftness,
+           static_cast<unsigned long long>(statistics.ShadowRays),
+           statistics.ShadowRays ? static_cast<double>(statistics.ShadowSteps) / statistics.ShadowRays : 0.0);
+    const uint64_t shadowLookups = statistics.ShadowCacheHits + statistics.ShadowRays;
+    printf("Shadow cache: %ux%ux%u texels (%.2f MB), cell size: %g, builds: %llu, %.2f ms and %llu steps each, "
+           "shadows from the cache: %.1f%%\n", settings.ShadowCacheCells,
+           settings.ShadowCacheCells ? SHADOW_CACHE_LAYERS : 0, settings.ShadowCacheCells,
+           demo.GetShadowCacheBytes() / (1024.0 * 1024.0), settings.ShadowCacheCellSize,
+           static_cast<unsigned long long>(demo.GetShadowCacheBuilds()),
+           demo.GetShadowCacheBuilds() ? demo.GetShadowCacheSeconds() * 1000.0 / demo.GetShadowCacheBuilds() : 0.0,
+           static_cast<unsigned long long>(demo.GetShadowCacheBuilds() ?
+                                           statistics.ShadowCacheSteps / demo.GetShadowCacheBuilds() : 0),
+           shadowLookups ? 100.0 * statistics.ShadowCacheHits / shadowLookups : 0.0);
+    const auto& dynamicResolution = demo.GetDynamicResolution();
+    if (dynamicResolution.GetBudget() > 0.0)
+        printf("Dynamic resolution: %.1f ms budget, last scale %.4g (%ux%u)\n", dynamicResolution.GetBudget() * 1000.0,
+               dynamicResolution.GetScale(), dynamicResolution.GetScaledSize(graphics->GetClientWidth()),
+               dynamicResolution.GetScaledSize(graphics->GetClientHeight()));
+    else
+        printf("Dynamic resolution: off\n");
+    printf("Skipped frames: %llu of %u\n", static_cast<unsigned long long>(demo.GetSkippedFrames()), frames);
+    printf("Primary rays per pixel: %.2f\n", pixels ? static_cast<double>(statistics.PrimaryRays) / pixels : 0.0);
+    printf("Primary rays/s: %.0f\n", seconds > 0.0 ? statistics.PrimaryRays / seconds : 0.0);
+    printf("Rays/s: %.0f\n", seconds > 0.0 ? statistics.Rays / seconds : 0.0);
+    printf("Steps per ray: %.2f\n", statistics.Rays ? static_cast<double>(statistics.Steps) / statistics.Rays : 0.0);
+    printf("Distance evaluations/s: %.0f\n", seconds > 0.0 ? statistics.DistanceEvaluations / seconds : 0.0);
+    printf("Lane utilization: %.1f%%\n",
+           statistics.LaneSlots ? 100.0 * statistics.Steps / statistics.LaneSlots : 0.0);
+}
+
+// Largest per-channel difference between two frames of the same size, and the number of pixels that differ.
+static uint32_t GetMaxDifference(const CpuTexture& a, const CpuTexture& b, uint64_t& differentPixels)
+{
+    uint32_t maxDifference = 0;
+    differentPixels = 0;
+
+    for (size_t i = 0; i < a.GetPixels().size(); i++)
+    {
+        const uint32_t pixelA = a.GetPixels()[i];
+        const uint32_t pixelB = b.GetPixels()[i];
+        if (pixelA == pixelB)
+            continue;
+
+        differentPixels++;
+        for (uint32_t shift = 0; shift < 24; shift += 8)
+        {
+            const auto channelA = static_cast<int>((pixelA >> shift) & 0xFF);
+            const auto channelB = static_cast<int>((pixelB >> shift) & 0xFF);
+            maxDifference = max(maxDifference, static_cast<uint32_t>(abs(channelA - channelB)));
+        }
+    }
+
+    return maxDifference;
+}
+
+// Sum of the squared differences of the color channels of a and b.
+static double GetSquaredError(const CpuTexture& a, const CpuTexture& b)
+{
+    double squaredError = 0.0;
+
+    for (size_t i = 0; i < a.GetPixels().size(); i++)
+        for (uint32_t shift = 0; shift < 24; shift += 8)
+        {
+            const auto channelA = static_cast<int>((a.GetPixels()[i] >> shift) & 0xFF);
+            const auto channelB = static_cast<int>((b.GetPixels()[i] >> shift) & 0xFF);
+            squaredError += static_cast<double>((channelA - channelB) * (channelA - channelB));
+        }
+
+    return squaredError;
+}
+
+// Peak signal to noise ratio, in dB, of 8-bit channels with the given mean squared error.
+static double GetPsnr(const double meanSquaredError)
+{
+    return meanSquaredError > 0.0 ? 10.0 * log10(255.0 * 255.0 / meanSquaredError) : INFINITY;
+}
+
+// Share of b that a takes, in percent.
+static double GetPercentage(const double a, const double b)
+{
+    return b > 0.0 ? 100.0 * a / b : 0.0;
+}
+
+// Renders the flythrough with settings and with the reference that mutateReference makes of them in lock step, one
+// frame of each in turn, and reports the rays, steps and time the settings take against the reference and the error of
+// their frames over the whole flythrough and in the worst frame.
+static void CompareRenders(const HeadlessApplication& app, const HeadlessFractalRadio::Settings& settings,
+                           const uint32_t frames, const char* name,
+                           const function<void(HeadlessFractalRadio::Settings&)>& mutateReference)
+{
+    HeadlessFractalRadio::Settings referenceSettings = settings;
+    mutateReference(referenceSettings);
+
+    const auto graphics = app.GetGraphics();
+    HeadlessFractalRadio demo(graphics, settings);
+    HeadlessFractalRadio referenceDemo(graphics, referenceSettings);
+
+    const double channels = 3.0 * graphics->GetClientWidth() * graphics->GetClientHeight();
+    double squaredError = 0.0;
+    double worstSquaredError = 0.0;
+    uint32_t worstFrame = 0;
+    uint32_t maxDifference = 0;
+    for (uint32_t frame = 0; frame < frames; frame++)
+    {
+        demo.Update(FRAME_TIME);
+        demo.Render();
+        const CpuTexture presentedFrame = graphics->GetPresentedBuffer();
+
+        referenceDemo.Update(FRAME_TIME);
+        referenceDemo.Render();
+        const CpuTexture& referenceFrame = graphics->GetPresentedBuffer();
+
+        const double frameSquaredError = GetSquaredError(presentedFrame, referenceFrame);
+        squaredError += frameSquaredError;
+        if (frameSquaredError > worstSquaredError)
+        {
+            worstSquaredError = frameSquaredError;
+            worstFrame = frame;
+        }
+
+        uint64_t differentPixels;
+        maxDifference = max(maxDifference, GetMaxDifference(presentedFrame, referenceFrame, differentPixels));
+    }
+
+    const auto statistics = demo.GetStatistics();
+    const auto referenceStatistics = referenceDemo.GetStatistics();
+
+    printf("%s: primary rays %.1f%%, steps %.1f%%, shadow steps %.1f%%, render time %.1f%%", name,
+           GetPercentage(statistics.PrimaryRays, referenceStatistics.PrimaryRays),
+           GetPercentage(statistics.Steps, referenceStatistics.Steps),
+           GetPercentage(statistics.ShadowSteps, referenceStatistics.ShadowSteps),
+           GetPercentage(demo.GetRenderSeconds(), referenceDemo.GetRenderSeconds()));
+    if (demo.GetShadowCacheBuilds() || referenceDemo.GetShadowCacheBuilds())
+        printf(", with the shadow cache builds %.1f%%",
+               GetPercentage(demo.GetRenderSeconds() + demo.GetShadowCacheSeconds(),
+                             referenceDemo.GetRenderSeconds() + referenceDemo.GetShadowCacheSeconds()));
+    printf("\n");
+    printf("%s: PSNR %.2f dB, worst frame %u at %.2f dB, max difference %u\n", name,
+           GetPsnr(frames ? squaredError / (channels * frames) : 0.0), worstFrame,
+           GetPsnr(worstSquaredError / channels), maxDifference);
+}
+
+// Renders the same flythrough with the classic tracer (no over-relaxation, hits at MINIMUM_DISTANCE, no cone) and
+// reports the steps saved by the step reduction options for this scene, along with how much the last frame changed.
+static void CompareWithClassicTracer(const HeadlessApplication& app, const HeadlessFractalRadio& demo,
+                                     HeadlessFractalRadio::Settings settings, const uint32_t frames)
+{
+    const CpuTexture frame = app.GetGraphics()->GetPresentedBuffer();
+    const auto statistics = demo.GetStatistics();
+
+    settings.OverRelaxation = 1.0f;
+    settings.HitTolerance = MINIMUM_DISTANCE;
+    settings.ConeScale = 0.0f;
+    settings.Prepass = false;
+    settings.Reprojection = false;
+    settings.Accumulation = false;
+    settings.HalfResolution = false;
+    settings.Interleave = 0;
+    settings.SupersampleBudget = 0.0f;
+    settings.Deferred = false;
+    settings.FrameBudget = 0.0;
+    const auto classicDemo = app.Run<HeadlessFractalRadio>(frames, FRAME_TIME, settings);
+    const auto classicStatistics = classicDemo->GetStatistics();
+
+    uint64_t differentPixels;
+    const uint32_t maxDifference = GetMaxDifference(frame, app.GetGraphics()->GetPresentedBuffer(), differentPixels);
+
+    const double stepsPerRay = statistics.Rays ? static_cast<double>(statistics.Steps) / statistics.Rays : 0.0;
+    const double classicStepsPerRay =
+        classicStatistics.Rays ? static_cast<double>(classicStatistics.Steps) / classicStatistics.Rays : 0.0;
+
+    printf("Steps per ray: %.2f, classic %.2f (%.1f%% saved), rays: %llu, classic %llu\n", stepsPerRay,
+           classicStepsPerRay, classicStepsPerRay > 0.0 ? 100.0 - 100.0 * stepsPerRay / classicStepsPerRay : 0.0,
+           static_cast<unsigned long long>(statistics.Rays), static_cast<unsigned long long>(classicStatistics.Rays));
+    printf("Relaxation fallbacks: %llu, refinement steps: %llu\n",
+           static_cast<unsigned long long>(statistics.RelaxationFallbacks),
+           static_cast<unsigned long long>(statistics.RefinementSteps));
+    printf("Steps/frame saved including the prepass: %.0f\n",
+           frames ? (static_cast<double>(classicStatistics.Steps) - static_cast<double>(statistics.Steps) -
+                     static_cast<double>(statistics.PrepassSteps)) / frames : 0.0);
+    printf("Last frame vs classic: %llu pixels differ, max difference %u\n",
+           static_cast<unsigned long long>(differentPixels), maxDifference);
+}
+
+// Raw DistanceEstimator throughput of one kernel build on a fixed set of points around the default scene.
+static double BenchmarkDistanceEstimator(const CpuMarchKernels& kernels)
+{
+    vector<float> xs(BENCHMARK_POINTS);
+    vector<float> ys(BENCHMARK_POINTS);
+    vector<float> zs(BENCHMARK_POINTS);
+    vector<float> distances(BENCHMARK_POINTS);
+
+    mt19937 generator(42);
+    uniform_real_distribution<float> horizontal(-10.0f, 10.0f);
+    uniform_real_distribution<float> vertical(-1.5f, 3.0f);
+    for (int i = 0; i < BENCHMARK_POINTS; i++)
+    {
+        xs[i] = horizontal(generator);
+        ys[i] = vertical(generator);
+        zs[i] = horizontal(generator);
+    }
+
+    uint64_t evaluations = 0;
+    const auto startTime = high_resolution_clock::now();
+    double seconds = 0.0;
+
+    while (seconds < BENCHMARK_SECONDS)
+    {
+        kernels.EvaluateDistances(xs.data(), ys.data(), zs.data(), distances.data(), BENCHMARK_POINTS);
+        evaluations += BENCHMARK_POINTS;
+        seconds = duration<double>(high_resolution_clock::now() - startTime).count();
+    }
+
+    return evaluations / seconds;
+}
+
+// Renders the flythrough once per available instruction set and prints a comparison table.
+static void RunBenchmark(const HeadlessApplication& app, const HeadlessFractalRadio::Settings& settings,
+                         const uint32_t frames)
+{
+    printf("%-8s %5s %16s %16s %10s %8s\n", "isa", "width", "DE/s", "rays/s", "lanes", "speedup");
+
+    double scalarRaysPerSecond = 0.0;
+
+    for (const auto& kernels : CpuMarchKernels::GetAvailable())
+    {
+        app.GetGraphics()->SetMarchKernels(&kernels);
+
+        const double distanceEvaluationsPerSecond = BenchmarkDistanceEstimator(kernels);
+        const auto demo = app.Run<HeadlessFractalRadio>(frames, FRAME_TIME, settings);
+        const auto statistics = demo->GetStatistics();
+        const double raysPerSecond = demo->GetRenderSeconds() > 0.0 ? statistics.Rays / demo->GetRenderSeconds() : 0.0;
+
+        if (kernels.Width == 1)
+            scalarRaysPerSecond = raysPerSecond;
+
+        printf("%-8s %5u %16.0f %16.0f %9.1f%% %7.2fx\n", kernels.Name, kernels.Width, distanceEvaluationsPerSecond,
+               raysPerSecond, statistics.LaneSlots ? 100.0 * statistics.Steps / statistics.LaneSlots : 0.0,
+               scalarRaysPerSecond > 0.0 ? raysPerSecond / scalarRaysPerSecond : 0.0);
+    }
+}
+
+static const char* const USAGE =
+    "Usage: FractalRadioHeadless [--width W] [--height H] [--frames N] [--threads N] [--isa NAME] [--benchmark]\n"
+    "                            [--analytic-normals] [--over-relaxation W] [--hit-tolerance T]\n"
+    "                            [--cone-scale S] [--prepass] [--reprojection] [--accumulation]\n"
+    "                            [--half-resolution] [--interleave checkerboard|rows]\n"
+    "                            [--supersample RAYS_PER_PIXEL] [--deferred]\n"
+    "                            [--light-speed RADIANS_PER_SECOND] [--soft-shadows SOFTNESS]\n"
+    "                            [--shadow-cache CELLS] [--shadow-cache-cell SIZE]\n"
+    "                            [--frame-budget MS] [--still-camera]\n"
+    "                            [--output frame.ppm]\n";
+
+// Parses the value of an option that counts something, a whole number above zero.
+static bool ParseOption(const char* option, const char* text, uint32_t& value)
+{
+    char* end;
+    errno = 0;
+    const unsigned long long number = strtoull(text, &end, 10);
+    if (!isdigit(static_cast<unsigned char>(*text)) || *end || errno == ERANGE || !number || number > UINT32_MAX)
+    {
+        fprintf(stderr, "%s takes a whole number above zero, not %s\n", option, text);
+        return false;
+    }
+    value = static_cast<uint32_t>(number);
+    return true;
+}
+
+static bool ParseOption(const char* option, const char* text, double& value)
+{
+    char* end;
+    errno = 0;
+    const double number = strtod(text, &end);
+    if (end == text || *end || errno == ERANGE || !isfinite(number))
+    {
+        fprintf(stderr, "%s takes a number, not %s\n", option, text);
+        return false;
+    }
+    value = number;
+    return true;
+}
+
+static bool ParseOption(const char* option, const char* text, float& value)
+{
+    double number;
+    if (!ParseOption(option, text, number))
+        return false;
+    value = static_cast<float>(number);
+    return true;
+}
+
+// Entry point of the headless build: renders a fixed flythrough with the CPU ray marcher and reports throughput. See
+// USAGE for the options; --help prints it.
+int main(const int argc, char** argv)
+{
+    uint32_t clientWidth = DEFAULT_CLIENT_WIDTH;
+    uint32_t clientHeight = DEFAULT_CLIENT_HEIGHT;
+    uint32_t frames = DEFAULT_FRAMES;
+    uint32_t threads = 0;
+    const char* isa = nullptr;
+    bool benchmark = false;
+    const char* outputFile = nullptr;
+    HeadlessFractalRadio::Settings settings{};
+
+    for (int i = 1; i < argc; i++)
+    {
+        const char* option = argv[i];
+        const bool hasValue = i + 1 < argc;
+        bool isValid = true;
+
+        if (!strcmp(option, "--help") || !strcmp(option, "-h"))
+        {
+            printf("%s", USAGE);
+            return 0;
+        }
+        else if (!strcmp(option, "--width") && hasValue)
+            isValid = ParseOption(option, argv[++i], clientWidth);
+        else if (!strcmp(option, "--height") && hasValue)
+            isValid = ParseOption(option, argv[++i], clientHeight);
+        else if (!strcmp(option, "--frames") && hasValue)
+            isValid = ParseOption(option, argv[++i], frames);
+        else if (!strcmp(option, "--threads") && hasValue)
+            isValid = ParseOption(option, argv[++i], threads);
+        else if (!strcmp(option, "--isa") && hasValue)
+            isa = argv[++i];
+        else if (!strcmp(option, "--benchmark"))
+            benchmark = true;
+        else if (!strcmp(option, "--analytic-normals"))
+            settings.AnalyticNormals = true;
+        else if (!strcmp(option, "--over-relaxation") && hasValue)
+            isValid = ParseOption(option, argv[++i], settings.OverRelaxation);
+        else if (!strcmp(option, "--hit-tolerance") && hasValue)
+            isValid = ParseOption(option, argv[++i], settings.HitTolerance);
+        else if (!strcmp(option, "--cone-scale") && hasValue)
+            isValid = ParseOption(option, argv[++i], settings.ConeScale);
+        else if (!strcmp(option, "--prepass"))
+            settings.Prepass = true;
+        else if (!strcmp(option, "--reprojection"))
+            settings.Reprojection = true;
+        else if (!strcmp(option, "--accumulation"))
+            settings.Accumulation = true;
+        else if (!strcmp(option, "--half-resolution"))
+            settings.HalfResolution = true;
+        else if (!strcmp(option, "--interleave") && hasValue)
+        {
+            const char* mode = argv[++i];
+            if (!strcmp(mode, "checkerboard"))
+                settings.Interleave = INTERLEAVE_CHECKER;
+            else if (!strcmp(mode, "rows"))
+                settings.Interleave = INTERLEAVE_ROWS;
+            else
+            {
+                fprintf(stderr, "Unknown interleave mode: %s\n", mode);
+                return 1;
+            }
+        }
+        else if (!strcmp(option, "--supersample") && hasValue)
+            isValid = ParseOption(option, argv[++i], settings.SupersampleBudget);
+        else if (!strcmp(option, "--deferred"))
+            settings.Deferred = true;
+        else if (!strcmp(option, "--light-speed") && hasValue)
+            isValid = ParseOption(option, argv[++i], settings.LightSpeed);
+        else if (!strcmp(option, "--soft-shadows") && hasValue)
+            isValid = ParseOption(option, argv[++i], settings.ShadowSoftness);
+        else if (!strcmp(option, "--shadow-cache") && hasValue)
+            isValid = ParseOption(option, argv[++i], settings.ShadowCacheCells);
+        else if (!strcmp(option, "--shadow-cache-cell") && hasValue)
+            isValid = ParseOption(option, argv[++i], settings.ShadowCacheCellSize);
+        else if (!strcmp(option, "--frame-budget") && hasValue)
+        {
+            isValid = ParseOption(option, argv[++i], settings.FrameBudget);
+            settings.FrameBudget /= 1000.0;
+        }
+        else if (!strcmp(option, "--still-camera"))
+            settings.StillCamera = true;
+        else if (!strcmp(option, "--output") && hasValue)
+            outputFile = argv[++i];
+        else
+        {
+            fprintf(stderr, "Unknown argument: %s\n%s", option, USAGE);
+            return 1;
+        }
+
+        if (!isValid)
+            return 1;
+    }
+
+    const auto app = make_unique<HeadlessApplication>(clientWidth, clientHeight, NUM_FRAMES, threads);
+
+    if (isa)
+    {
+        const auto kernels = CpuMarchKernels::Find(isa);
+        if (!kernels)
+        {
+            fprintf(stderr, "Instruction set %s is not supported by this CPU\n", isa);
+            return 1;
+        }
+        app->GetGraphics()->SetMarchKernels(kernels);
+    }
+
+    printf("March kernels: %s (%u lanes%s), supported:", app->GetGraphics()->GetMarchKernels()->Name,
+           app->GetGraphics()->GetMarchKernels()->Width, isa ? ", forced by --isa" : "");
+    for (const auto& kernels : CpuMarchKernels::GetAvailable())
+        printf(" %s", kernels.Name);
+    printf("\n");
+
+    if (benchmark)
+    {
+        RunBenchmark(*app, settings, frames);
+        return 0;
+    }
+
+    const auto demo = app->Run<HeadlessFractalRadio>(frames, FRAME_TIME, settings);
+
+    PrintReport(*app, *demo, settings, frames);
+
+    if (outputFile && !app->GetGraphics()->GetPresentedBuffer().SavePpm(outputFile))
+    {
+        fprintf(stderr, "Could not write %s\n", outputFile);
+        return 1;
+    }
+
+    if (settings.OverRelaxation > 1.0f || settings.HitTolerance > MINIMUM_DISTANCE ||
+        settings.ConeScale > 0.0f || settings.Prepass || settings.Reprojection ||
+        settings.HalfResolution)
+        CompareWithClassicTracer(*app, *demo, settings, frames);
+
+    if (settings.Interleave)
+        CompareRenders(*app, settings, frames, "Interleaved vs full rendering",
+                       [](HeadlessFractalRadio::Settings& reference) { reference.Interleave = 0; });
+
+    if (settings.SupersampleBudget > 0.0f)
+    {
+        CompareRenders(*app, settings, frames, "Adaptive vs full supersampling",
+                       [](HeadlessFractalRadio::Settings& reference)
+                       { reference.SupersampleBudget = static_cast<float>(SUPERSAMPLES - 1); });
+        CompareRenders(*app, settings, frames, "Adaptive vs no supersampling",
+                       [](HeadlessFractalRadio::Settings& reference) { reference.SupersampleBudget = 0.0f; });
+    }
+
+    if (settings.Deferred)
+        CompareRenders(*app, settings, frames, "Deferred vs forward shading",
+                       [](HeadlessFractalRadio::Settings& reference) { reference.Deferred = false; });
+
+    if (settings.ShadowSoftness > 0.0f)
+        CompareRenders(*app, settings, frames, "Soft vs hard shadows",
+                       [](HeadlessFractalRadio::Settings& reference) { reference.ShadowSoftness = 0.0f; });
+
+    if (settings.ShadowCacheCells)
+        CompareRenders(*app, settings, frames, "Shadow cache vs marching",
+                       [](HeadlessFractalRadio::Settings& reference) { reference.ShadowCacheCells = 0; });
+
+    return 0;
+}
@@ -0,0 +1,15 @@
+// Shades the deferred G-buffer and stores each pixel like a forward sample.
+#define RAY_MARCHER_LIBRARY
+#include "RayMarcher.hlsl"
+
+[numthreads(BLOCK_SIZE, BLOCK_SIZE, 1)]
+void main(ComputeShaderInput IN)
+{
+    ClearEdgeHistogram(IN.DispatchThreadId.xy);
+
+    uint2 pixel = IN.DispatchThreadId.xy;
+    if (pixel.x >= uint(g_windowSize.x) || pixel.y >= uint(g_windowSize.y))
+        return;
+
+    StoreSample(pixel, LightPixel(pixel), false);
+}
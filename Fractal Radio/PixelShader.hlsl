@@ -4,10 +4,16 @@ struct PixelShaderInput
     float2 Uv       : TEXCOORD0;
 };
 
+// Fraction of g_texture the ray marcher rendered, which dynamic resolution stretches over the whole window.
+cbuffer CompositeConstantBuffer : register(b0)
+{
+    float2 g_uvScale;
+}
+
 Texture2D<float4> g_texture : register(t0);
 SamplerState g_pointClampSampler : register(s0);
 
 float4 main(const PixelShaderInput IN) : SV_Target
 {
-    return g_texture.Sample(g_pointClampSampler, IN.Uv);
+    return g_texture.Sample(g_pointClampSampler, IN.Uv * g_uvScale);
 }
\ No newline at end of file
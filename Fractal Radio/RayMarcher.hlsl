@@ -5,9 +5,40 @@
 #define SIERPINSKI_ITERATIONS 10
 #define MAX_CAMERA_DEPTH 100.0f
 #define GLOW_FACTOR 0.5f
-#define MAX_RAYS_DEPTH 5
-
-#define LIGHT_DIRECTION float3(-0.5f, -0.5f, 0.5f)
+#define MAX_RAYS_DEPTH 1
+#define MAX_REFINEMENT_STEPS 16
+#define CAMERA_PLANE_DISTANCE 5.0f
+#define REFLECTION_SPREAD 2.0f
+#define PREPASS_CELL_SIZE 4
+#define PREPASS_CELLS (BLOCK_SIZE / PREPASS_CELL_SIZE)
+#define REPROJECTION_RECORD 1
+#define REPROJECTION_REUSE 2
+#define REPROJECTION_PASSES 2
+#define REPROJECTION_REFRESH 4
+#define REPROJECTION_MARGIN 0.05f
+#define REPROJECTION_SLACK 2.0f
+#define UPSAMPLE_DEPTH_RATIO 0.05f
+#define UPSAMPLE_NORMAL_DOT 0.95f
+#define UPSAMPLE_COLOR_STEP 0.1f
+#define INTERLEAVE_RECORD 1
+#define INTERLEAVE_CHECKER 2
+#define INTERLEAVE_ROWS 3
+#define SUPERSAMPLES 4
+#define EDGE_DEPTH_RATIO 0.05f
+#define EDGE_NORMAL_DOT 0.95f
+#define EDGE_STEP_DIFFERENCE 4.0f
+#define EDGE_COLOR_STEP 0.1f
+#define EDGE_BUCKETS 32
+#define DEFERRED_MARCH 1
+#define DEFERRED_RELIGHT 2
+#define GBUFFER_NORMAL_BITS 12
+#define GBUFFER_STEPS_BITS 6
+#define GBUFFER_NORMAL_MAX float((1 << GBUFFER_NORMAL_BITS) - 1)
+#define MATERIAL_NONE 0
+#define MATERIAL_SPHERES 1
+#define MATERIAL_PLANE 2
+#define SHADOW_OPAQUE 0.01f
+#define SHADOW_CACHE_LAYERS 32
 
 struct ComputeShaderInput
 {
@@ -21,10 +52,91 @@ cbuffer RayMarcherContrantBuffer : register(b0)
 {
     float2 g_windowSize;
     matrix g_cameraMatrix;
+    uint g_analyticNormals;
+    float g_overRelaxation;
+    float g_hitTolerance;
+    float g_coneScale;
+    uint g_prepass;
+    uint g_reprojection;
+    uint g_frameIndex;
+    matrix g_previousCameraMatrix;
+    uint g_accumulation;
+    uint g_sampleIndex;
+    uint g_halfResolution;
+    uint g_interleave;
+    float g_supersampleBudget;
+    float3 g_lightDirection;
+    uint g_deferred;
+    float g_shadowSoftness;
+    float g_shadowCacheCellSize;
+    uint g_shadowCacheCells;
+    float3 g_shadowCacheOrigin;
 }
 
 RWTexture2D<float4> g_outputTexture : register(u0);
 
+// Depth and ambient occlusion steps of the primary hits; swaps with g_previousDepth every frame.
+RWTexture2D<float2> g_depth : register(u1);
+Texture2D<float2> g_previousDepth : register(t0);
+
+// Sum of the jittered samples of a still view.
+RWTexture2D<float4> g_accumulatedColor : register(u2);
+
+// Half resolution G-buffer for Upsample.hlsl.
+RWTexture2D<float4> g_halfColor : register(u3);
+RWTexture2D<float4> g_halfGeometry : register(u4);
+
+// Color and depth of the last interleaved frame for Reconstruct.hlsl; swaps with g_previousHistory.
+RWTexture2D<float4> g_history : register(u5);
+Texture2D<float4> g_previousHistory : register(t1);
+
+// Full resolution G-buffer for Supersample.hlsl.
+RWTexture2D<float4> g_color : register(u6);
+RWTexture2D<float4> g_geometry : register(u7);
+
+// Pixel count of each GetEdgeBucket, cleared by main and filled by EdgeHistogram.hlsl.
+RWStructuredBuffer<uint> g_edgeHistogram : register(u8);
+
+// Deferred G-buffer for Lighting.hlsl, see PackGBuffer.
+RWTexture2D<uint2> g_gBuffer : register(u9);
+
+// Light visibility over a grid of the scene, built on the CPU, see LookUpShadowCache.
+Texture3D<float> g_shadowCache : register(t2);
+
+// Empty space distance of each prepass cell of the group.
+groupshared float g_prepassDistances[PREPASS_CELLS * PREPASS_CELLS];
+
+// Forward-mode dual number: a value and its gradient.
+struct DualFloat
+{
+    float Value;
+    float3 Gradient;
+};
+
+// Dual counterpart of float3; the rows of Jacobian are the gradients of x, y and z.
+struct DualFloat3
+{
+    float3 Value;
+    float3x3 Jacobian;
+};
+
+struct MarchState
+{
+    float TotalDistance;
+    float StepLength;
+    float PreviousDistance;
+    float Relaxation;
+};
+
+// Depth and Steps are zero for misses.
+struct PixelSample
+{
+    float3 Color;
+    float3 Normal;
+    float Depth;
+    float Steps;
+};
+
 struct TraceResult
 {
     float AmbientOcclusion;
@@ -32,7 +144,8 @@ struct TraceResult
     float3 Normal;
     float3 Color;
     int NumSteps;
-    bool Blocked;
+    float Visibility;
+    float Distance;
 };
 
 float SphereEstimator(float3 crtPosition, float3 spherePosition, float radius)
@@ -75,77 +188,465 @@ float DistanceEstimator(float3 position)
     return min(SpheresEstimator(position, float3(0.0f, 1.0f, 3.0f)), YPlane(position, -1.0f));
 }
 
+DualFloat3 DualVariable(float3 position)
+{
+    DualFloat3 result;
+    result.Value = position;
+    result.Jacobian = float3x3(1.0f, 0.0f, 0.0f, 0.0f, 1.0f, 0.0f, 0.0f, 0.0f, 1.0f);
+    return result;
+}
+
+DualFloat DualLength(DualFloat3 z)
+{
+    DualFloat result;
+    result.Value = length(z.Value);
+    result.Gradient = mul(z.Value, z.Jacobian) / result.Value;
+    return result;
+}
+
+DualFloat SphereEstimatorDual(DualFloat3 crtPosition, float3 spherePosition, float radius)
+{
+    crtPosition.Value -= spherePosition;
+    DualFloat result = DualLength(crtPosition);
+    result.Value -= radius;
+    return result;
+}
+
+// fmod only shifts the value, so the repetition leaves the Jacobian untouched.
+DualFloat SpheresEstimatorDual(DualFloat3 crtPosition, float3 spherePosition)
+{
+    DualFloat3 z = crtPosition;
+    z.Value -= spherePosition;
+    z.Value.xz = fmod((z.Value.xz), 1.0f) - float2(0.5f, 0.5f);
+    DualFloat result = DualLength(z);
+    result.Value -= 0.3f;
+    return result;
+}
+
+// The folds are reflections, so they permute and negate the rows of the Jacobian along with the components.
+DualFloat SierpinskiDual(DualFloat3 crtPosition, float3 tetrahedronPosition)
+{
+    DualFloat3 z = crtPosition;
+    z.Value -= tetrahedronPosition;
+
+    int n = 0;
+    float scale = 2.0f;
+    while (n < SIERPINSKI_ITERATIONS) {
+        if (z.Value.x + z.Value.y < 0) // fold 1
+        {
+            z.Value.xy = -z.Value.yx;
+            z.Jacobian = float3x3(-z.Jacobian[1], -z.Jacobian[0], z.Jacobian[2]);
+        }
+        if (z.Value.x + z.Value.z < 0) // fold 2
+        {
+            z.Value.xz = -z.Value.zx;
+            z.Jacobian = float3x3(-z.Jacobian[2], z.Jacobian[1], -z.Jacobian[0]);
+        }
+        if (z.Value.y + z.Value.z < 0) // fold 3
+        {
+            z.Value.zy = -z.Value.yz;
+            z.Jacobian = float3x3(z.Jacobian[0], -z.Jacobian[2], -z.Jacobian[1]);
+        }
+        z.Value = z.Value * scale - float3(1.0f, 1.0f, 1.0f) * (scale - 1.0);
+        z.Jacobian *= scale;
+        n++;
+    }
+    DualFloat result = DualLength(z);
+    result.Value *= pow(scale, -float(n));
+    result.Gradient *= pow(scale, -float(n));
+    return result;
+}
+
+DualFloat YPlaneDual(DualFloat3 crtPosition, float y)
+{
+    DualFloat result;
+    result.Value = crtPosition.Value.y - y;
+    result.Gradient = crtPosition.Jacobian[1];
+    return result;
+}
+
+// DistanceEstimator on dual numbers: the distance and its gradient in one pass.
+DualFloat DistanceEstimatorDual(float3 position)
+{
+    DualFloat3 dualPosition = DualVariable(position);
+    DualFloat spheres = SpheresEstimatorDual(dualPosition, float3(0.0f, 1.0f, 3.0f));
+    DualFloat plane = YPlaneDual(dualPosition, -1.0f);
+    return plane.Value < spheres.Value ? plane : spheres;
+}
+
+// Bisection steps that shrink a 2 * tolerance bracket below MINIMUM_DISTANCE.
+int GetRefinementSteps(float tolerance)
+{
+    int steps = 0;
+    if (tolerance <= MINIMUM_DISTANCE)
+        return steps;
+
+    for (float width = 2.0f * tolerance; width > MINIMUM_DISTANCE && steps < MAX_REFINEMENT_STEPS; width *= 0.5f)
+        steps++;
+    return steps;
+}
+
+// Bisects the crossing down to MINIMUM_DISTANCE and returns the end of the bracket in front of the surface.
+float3 RefineHit(float3 from, float3 direction, float hitDistance, float distance)
+{
+    float3 hitPoint = from + hitDistance * direction;
+
+    int refinementSteps = GetRefinementSteps(g_hitTolerance);
+    if (refinementSteps == 0 || distance < 0.0f)
+        return hitPoint;
+
+    float nearDistance = hitDistance;
+    float farDistance = hitDistance + 2.0f * g_hitTolerance;
+
+    if (!(DistanceEstimator(from + farDistance * direction) < 0.0f))
+        return hitPoint;
+
+    for (int step = 0; step < refinementSteps; step++)
+    {
+        float middleDistance = (nearDistance + farDistance) * 0.5f;
+        if (DistanceEstimator(from + middleDistance * direction) < 0.0f)
+            farDistance = middleDistance;
+        else
+            nearDistance = middleDistance;
+    }
+
+    return from + nearDistance * direction;
+}
+
+float3 EstimateNormal(float3 crtPoint)
+{
+    if (g_analyticNormals)
+        return normalize(DistanceEstimatorDual(crtPoint).Gradient);
+
+    float3 xyy = float3(1.0f, -1.0f, -1.0f);
+    float3 xyx = float3(-1.0f, 1.0f, -1.0f);
+    float3 yyx = float3(-1.0f, -1.0f, 1.0f);
+    float3 xxx = float3(1.0f, 1.0f, 1.0f);
+
+    float3 normal = xyy * DistanceEstimator(crtPoint + xyy * NORMAL_THRESHOLD) +
+        xyx * DistanceEstimator(crtPoint + xyx * NORMAL_THRESHOLD) +
+        yyx * DistanceEstimator(crtPoint + yyx * NORMAL_THRESHOLD) +
+        xxx * DistanceEstimator(crtPoint + xxx * NORMAL_THRESHOLD);
+
+    return normalize(normal);
+}
+
 float3 Reflect(const float3 I, const float3 N)
 {
     return I - 2 * dot(I, N) * N;
 }
 
-bool IsBlocked(float3 from, float3 direction)
+MarchState InitMarchState()
+{
+    MarchState state;
+    state.TotalDistance = 0.0f;
+    state.StepLength = 0.0f;
+    state.PreviousDistance = 0.0f;
+    state.Relaxation = g_overRelaxation;
+    return state;
+}
+
+// Undoes the relaxed step when the unbounding spheres stop overlapping and takes a plain one instead.
+bool Advance(float distance, inout MarchState state)
 {
-    float totalDistance = 0.0f;
-    int steps;
-    float resultTone = 0.0f;
-    for (steps = 0; steps < MAX_STEPS; steps++)
+    if (state.Relaxation > 1.0f && abs(distance) + state.PreviousDistance < state.StepLength)
     {
-        float3 crtPoint = from + totalDistance * direction;
+        state.TotalDistance = state.TotalDistance - state.StepLength + state.PreviousDistance;
+        state.StepLength = state.PreviousDistance;
+        state.Relaxation = 1.0f;
+        return false;
+    }
+
+    state.StepLength = distance * state.Relaxation;
+    state.PreviousDistance = distance;
+    state.TotalDistance += state.StepLength;
+    return true;
+}
+
+// Zero in shadow; with g_shadowSoftness the closest miss lets part of the light through.
+float TraceShadow(float3 from, float3 direction)
+{
+    MarchState state = InitMarchState();
+    float visibility = 1.0f;
+    for (int steps = 0; steps < MAX_STEPS; steps++)
+    {
+        float crtDistance = state.TotalDistance;
+        float3 crtPoint = from + crtDistance * direction;
         float distance = DistanceEstimator(crtPoint);
-        totalDistance += distance;
+        if (!Advance(distance, state))
+            continue;
         if (distance < MINIMUM_DISTANCE)
-            return true;
+            return 0.0f;
         if (distance > MAX_CAMERA_DEPTH)
-            return false;
+            return visibility;
+        if (g_shadowSoftness > 0.0f && crtDistance > 0.0f)
+        {
+            visibility = min(visibility, g_shadowSoftness * distance / crtDistance);
+            if (visibility < SHADOW_OPAQUE)
+                return 0.0f;
+        }
+    }
+
+    return visibility;
+}
+
+// Only the x component of the light direction survives the conversion to float.
+float MarchShadow(float3 hitPoint)
+{
+    float lightDirection = normalize(-g_lightDirection);
+    return TraceShadow(hitPoint + lightDirection * 1.0f, lightDirection);
+}
+
+// Trilinear lookup of MarchShadow in g_shadowCache, -1 where the cache does not cover hitPoint.
+float LookUpShadowCache(float3 hitPoint)
+{
+    if (g_shadowCacheCellSize <= 0.0f)
+        return -1.0f;
+
+    float3 texel = (hitPoint - g_shadowCacheOrigin) / g_shadowCacheCellSize;
+    float3 lastTexel = float3(g_shadowCacheCells, SHADOW_CACHE_LAYERS, g_shadowCacheCells) - 1.0f;
+    if (any(texel < 0.0f) || any(texel >= lastTexel))
+        return -1.0f;
+
+    int3 base = int3(texel);
+    float3 weight = texel - float3(base);
+    float4 lower = float4(g_shadowCache.Load(int4(base, 0)),
+                          g_shadowCache.Load(int4(base + int3(1, 0, 0), 0)),
+                          g_shadowCache.Load(int4(base + int3(0, 1, 0), 0)),
+                          g_shadowCache.Load(int4(base + int3(1, 1, 0), 0)));
+    float4 upper = float4(g_shadowCache.Load(int4(base + int3(0, 0, 1), 0)),
+                          g_shadowCache.Load(int4(base + int3(1, 0, 1), 0)),
+                          g_shadowCache.Load(int4(base + int3(0, 1, 1), 0)),
+                          g_shadowCache.Load(int4(base + int3(1, 1, 1), 0)));
+    float4 row = lower + (upper - lower) * weight.z;
+    float2 column = row.xy + (row.zw - row.xy) * weight.y;
+    return column.x + (column.y - column.x) * weight.x;
+}
+
+float ShadowVisibility(float3 hitPoint)
+{
+    float cached = LookUpShadowCache(hitPoint);
+    return cached >= 0.0f ? cached : MarchShadow(hitPoint);
+}
+
+// The index-th element of the Halton sequence of base.
+float Halton(uint index, uint base)
+{
+    float result = 0.0f;
+    float fraction = 1.0f;
+    while (index > 0)
+    {
+        fraction /= float(base);
+        result += fraction * float(index % base);
+        index /= base;
+    }
+    return result;
+}
+
+// The pixel centre first, then the (2, 3) Halton sequence.
+float2 GetSampleOffset(uint sampleIndex)
+{
+    if (sampleIndex == 0)
+        return float2(0.0f, 0.0f);
+
+    return float2(Halton(sampleIndex, 2), Halton(sampleIndex, 3)) - 0.5f;
+}
+
+// Distance in pixels between the primary rays of neighbouring threads.
+uint2 GetPixelSpacing()
+{
+    if (g_halfResolution)
+        return uint2(2, 2);
+    if (g_interleave == INTERLEAVE_CHECKER)
+        return uint2(2, 1);
+    if (g_interleave == INTERLEAVE_ROWS)
+        return uint2(1, 2);
+    return uint2(1, 1);
+}
+
+// Every other pixel of every other row at half resolution, half of the pixels when interleaved.
+uint2 GetThreadPixel(uint2 thread)
+{
+    uint2 pixel = thread * GetPixelSpacing();
+    if (g_interleave == INTERLEAVE_CHECKER)
+        pixel.x += (thread.y + g_frameIndex) & 1;
+    else if (g_interleave == INTERLEAVE_ROWS)
+        pixel.y += g_frameIndex & 1;
+    return pixel;
+}
+
+bool IsMarchedPixel(uint2 pixel)
+{
+    if (g_interleave == INTERLEAVE_CHECKER)
+        return ((pixel.x + pixel.y + g_frameIndex) & 1) == 0;
+    if (g_interleave == INTERLEAVE_ROWS)
+        return ((pixel.y + g_frameIndex) & 1) == 0;
+    return true;
+}
+
+float3 GetRayDirection(float2 pixel, matrix cameraMatrix)
+{
+    float2 normalizedCoords = ((pixel / g_windowSize) * 2.0f) - float2(1.0f, 1.0f);
+    normalizedCoords.x *= g_windowSize.x / g_windowSize.y;
+    normalizedCoords.y *= -1.0f;
+
+    return normalize(mul(cameraMatrix,
+                         float4(normalizedCoords.x, normalizedCoords.y, CAMERA_PLANE_DISTANCE, 0.0f)).xyz);
+}
+
+// The cone contains the rays of every pixel of the cell, jittered and checkerboard ones included.
+float ConeMarch(float2 pixel)
+{
+    float3 eye = mul(g_cameraMatrix, float4(0.0f, 0.0f, 0.0f, 1.0f)).xyz;
+    float3 direction = GetRayDirection(pixel, g_cameraMatrix);
+
+    uint2 pixelSpacing = GetPixelSpacing();
+    float cellSpread = float((PREPASS_CELL_SIZE - 1) * max(pixelSpacing.x, pixelSpacing.y) +
+                             (g_interleave == INTERLEAVE_CHECKER ? 1 : 0) + (g_sampleIndex ? 1 : 0));
+    float coneAngle = cellSpread * 1.41421356f / (CAMERA_PLANE_DISTANCE * g_windowSize.y);
+
+    float totalDistance = CAMERA_PLANE_DISTANCE;
+    for (int steps = 0; steps < MAX_STEPS; steps++)
+    {
+        float distance = DistanceEstimator(eye + totalDistance * direction);
+        float freeDistance = distance - coneAngle * totalDistance;
+        if (freeDistance < MINIMUM_DISTANCE || distance > MAX_CAMERA_DEPTH)
+            break;
+        totalDistance += freeDistance / (1.0f + coneAngle);
     }
 
-    return false;
+    return totalDistance;
 }
 
-TraceResult IterativeTrace(float3 from, float3 direction)
+// Fails behind the camera and without a whole 2 x 2 footprint in the previous frame.
+bool ProjectToPreviousFrame(float3 position, out float2 previousPixel)
+{
+    // Inverse of the pixel to camera plane mapping of MarchPixel, in the previous camera.
+    float3 previousEye = mul(g_previousCameraMatrix, float4(0.0f, 0.0f, 0.0f, 1.0f)).xyz;
+    float3 local = mul(position - previousEye, (float3x3)g_previousCameraMatrix);
+    previousPixel = float2(0.0f, 0.0f);
+    if (local.z <= 0.0f)
+        return false;
+
+    previousPixel = float2(
+        (local.x * CAMERA_PLANE_DISTANCE / local.z * (g_windowSize.y / g_windowSize.x) + 1.0f) * 0.5f * g_windowSize.x,
+        (1.0f - local.y * CAMERA_PLANE_DISTANCE / local.z) * 0.5f * g_windowSize.y);
+    return previousPixel.x >= 0.0f && previousPixel.y >= 0.0f &&
+        previousPixel.x < g_windowSize.x - 1.0f && previousPixel.y < g_windowSize.y - 1.0f;
+}
+
+// Zero, for a full march, on silhouettes, wrong guesses and one group in REPROJECTION_REFRESH.
+float Reproject(uint2 pixel, out float steps)
+{
+    steps = -1.0f;
+    uint2 group = pixel / BLOCK_SIZE;
+    if (g_reprojection != REPROJECTION_REUSE || (group.x + 2 * group.y + g_frameIndex) % REPROJECTION_REFRESH == 0)
+        return 0.0f;
+
+    float3 eye = mul(g_cameraMatrix, float4(0.0f, 0.0f, 0.0f, 1.0f)).xyz;
+    float3 direction = GetRayDirection(pixel, g_cameraMatrix);
+    float3 previousEye = mul(g_previousCameraMatrix, float4(0.0f, 0.0f, 0.0f, 1.0f)).xyz;
+
+    float2 nearest = g_previousDepth[pixel];
+    if (nearest.x <= 0.0f)
+        return 0.0f;
+
+    float distance = nearest.x;
+    float previousSteps = nearest.y;
+    float3 previousHit = eye + distance * direction;
+
+    for (int pass = 0; pass < REPROJECTION_PASSES; pass++)
+    {
+        float2 previousPixel;
+        if (!ProjectToPreviousFrame(eye + distance * direction, previousPixel))
+            return 0.0f;
+
+        uint2 footprint = uint2(previousPixel);
+        nearest = float2(0.0f, 0.0f);
+        uint2 nearestPixel = footprint;
+        for (uint corner = 0; corner < 4; corner++)
+        {
+            uint2 cornerPixel = footprint + uint2(corner % 2, corner / 2);
+            float2 depth = g_previousDepth[cornerPixel];
+            if (depth.x <= 0.0f)
+                return 0.0f;
+            if (nearest.x <= 0.0f || depth.x < nearest.x)
+            {
+                nearest = depth;
+                nearestPixel = cornerPixel;
+            }
+        }
+
+        previousSteps = g_previousDepth[uint2(previousPixel + 0.5f)].y;
+        previousHit = previousEye + nearest.x * GetRayDirection(nearestPixel, g_previousCameraMatrix);
+        distance = dot(previousHit - eye, direction);
+    }
+
+    float slack = REPROJECTION_SLACK * 2.0f * distance / (CAMERA_PLANE_DISTANCE * g_windowSize.y);
+    if (length(previousHit - (eye + distance * direction)) > slack)
+        return 0.0f;
+
+    float startDistance = distance * (1.0f - REPROJECTION_MARGIN);
+    if (DistanceEstimator(eye + startDistance * direction) < g_hitTolerance)
+        return 0.0f;
+
+    steps = previousSteps;
+    return startDistance;
+}
+
+// With g_coneScale > 0 the hit threshold grows with the radius of the pixel's cone.
+TraceResult IterativeTrace(float3 from, float3 direction, float startDistance, float reprojectedSteps,
+                           float coneDistance, bool deferred)
 {
     TraceResult intersectionsStack[MAX_RAYS_DEPTH];
     int stackLength = 0;
     bool stillGoing = true;
 
+    float coneAngle = g_coneScale / (CAMERA_PLANE_DISTANCE * g_windowSize.y);
+
     for (int depth = 0; depth < MAX_RAYS_DEPTH && stillGoing; depth++)
     {
         int steps;
-        float totalDistance = 0.0f;
+        MarchState state = InitMarchState();
+        state.TotalDistance = startDistance;
         bool stopped = false;
 
         for (steps = 0; steps < MAX_STEPS; steps++)
         {
-            float3 crtPoint = from + totalDistance * direction;
+            float crtDistance = state.TotalDistance;
+            float3 crtPoint = from + crtDistance * direction;
             float distance = DistanceEstimator(crtPoint);
-            totalDistance += distance;
-            if (distance < MINIMUM_DISTANCE)
+            if (!Advance(distance, state))
+                continue;
+            if (distance < max(g_hitTolerance, coneAngle * (coneDistance + crtDistance)))
             {
-                const float ambientOcclusion = 1.0 - float(steps) / float(MAX_STEPS);
-
-                float3 xyy = float3(1.0f, -1.0f, -1.0f);
-                float3 xyx = float3(-1.0f, 1.0f, -1.0f);
-                float3 yyx = float3(-1.0f, -1.0f, 1.0f);
-                float3 xxx = float3(1.0f, 1.0f, 1.0f);
-
-                float3 normal = xyy * DistanceEstimator(crtPoint + xyy * NORMAL_THRESHOLD) +
-                    xyx * DistanceEstimator(crtPoint + xyx * NORMAL_THRESHOLD) +
-                    yyx * DistanceEstimator(crtPoint + yyx * NORMAL_THRESHOLD) +
-                    xxx * DistanceEstimator(crtPoint + xxx * NORMAL_THRESHOLD);
+                const float ambientSteps = reprojectedSteps < 0.0f ? float(steps) : reprojectedSteps;
+                const float ambientOcclusion = 1.0 - ambientSteps / float(MAX_STEPS);
 
-                normal = normalize(normal);
+                float3 hitPoint = RefineHit(from, direction, crtDistance, distance);
+                float3 normal = EstimateNormal(hitPoint);
 
                 TraceResult crtResult;
                 crtResult.Hit = true;
                 crtResult.Normal = normal;
                 crtResult.AmbientOcclusion = ambientOcclusion;
                 crtResult.Color = float3(1.0f, 1.0f, 1.0f);
-                crtResult.NumSteps = steps;
+                crtResult.NumSteps = int(ambientSteps);
+                crtResult.Distance = crtDistance;
 
                 
                 float3 reflected = Reflect(direction, normal);
-                from = crtPoint + reflected * 0.1f;
+                from = hitPoint + reflected * 0.1f;
                 direction = reflected;
-                float lightDirection = normalize(-LIGHT_DIRECTION);
-                float3 toLight = crtPoint + lightDirection * 1.0f;
-                crtResult.Blocked = IsBlocked(toLight, lightDirection);
+                coneDistance += crtDistance + 0.1f;
+                coneAngle *= REFLECTION_SPREAD;
+                startDistance = 0.0f;
+                reprojectedSteps = -1.0f;
+                crtResult.Visibility = 1.0f;
+                if (deferred)
+                    stillGoing = false;
+                else
+                    crtResult.Visibility = ShadowVisibility(hitPoint);
 
                 intersectionsStack[stackLength++] = crtResult;
 
@@ -162,7 +663,8 @@ TraceResult IterativeTrace(float3 from, float3 direction)
                 crtResult.Normal = direction;
                 crtResult.Color = float3(0.0f, 0.0f, 0.0f);
                 crtResult.NumSteps = steps;
-                crtResult.Blocked = false;
+                crtResult.Visibility = 1.0f;
+                crtResult.Distance = 0.0f;
                 intersectionsStack[stackLength++] = crtResult;
                 stillGoing = false;
 
@@ -180,7 +682,8 @@ TraceResult IterativeTrace(float3 from, float3 direction)
             crtResult.Normal = direction;
             crtResult.Color = float3(0.0f, 0.0f, 0.0f);
             crtResult.NumSteps = steps;
-            crtResult.Blocked = false;
+            crtResult.Visibility = 1.0f;
+            crtResult.Distance = 0.0f;
             intersectionsStack[stackLength++] = crtResult;
             stillGoing = false;
         }
@@ -193,20 +696,21 @@ TraceResult IterativeTrace(float3 from, float3 direction)
     {
         TraceResult crtResult = intersectionsStack[i];
 
-        float3 lightDirection = normalize(-LIGHT_DIRECTION);
+        float3 lightDirection = normalize(-g_lightDirection);
         float lightIntensity = max(0.1f, dot(crtResult.Normal, lightDirection));
         float color = crtResult.AmbientOcclusion * lightIntensity;
 
         crtResult.Color = color;
 
-        if (crtResult.Blocked)
-            crtResult.Color *= 0.5f;
+        // The shadow halves the color, the penumbra less.
+        crtResult.Color *= 0.5f + 0.5f * crtResult.Visibility;
 
         finalResult.Color += crtResult.Color;
         finalResult.Hit = crtResult.Hit;
         finalResult.Normal = crtResult.Normal;
         finalResult.AmbientOcclusion = crtResult.AmbientOcclusion;
         finalResult.NumSteps = crtResult.NumSteps;
+        finalResult.Distance = crtResult.Distance;
 
         intersectionsStack[i] = crtResult;
     }
@@ -217,10 +721,11 @@ TraceResult IterativeTrace(float3 from, float3 direction)
     return finalResult;
 }
 
-[numthreads(BLOCK_SIZE, BLOCK_SIZE, 1)]
-void main(ComputeShaderInput IN)
+// Only the rays through the pixel centres reproject.
+PixelSample MarchSample(uint2 pixel, uint sampleIndex, float prepassDistance, bool deferred)
 {
-    float2 normalizedCoords = ((IN.DispatchThreadId.xy / g_windowSize) * 2.0f) - float2(1.0f, 1.0f);
+    float2 samplePosition = pixel + GetSampleOffset(sampleIndex);
+    float2 normalizedCoords = ((samplePosition / g_windowSize) * 2.0f) - float2(1.0f, 1.0f);
     normalizedCoords.x *= g_windowSize.x / g_windowSize.y;
     normalizedCoords.y *= -1.0f;
     
@@ -233,9 +738,237 @@ void main(ComputeShaderInput IN)
     rayDirection = mul(g_cameraMatrix, float4(rayDirection, 0.0f)).xyz;
     onCameraPoint = eye + rayDirection;
 
+    float coneDistance = length(rayDirection);
     rayDirection = normalize(rayDirection);
 
-    TraceResult result = IterativeTrace(onCameraPoint, rayDirection);
+    float reprojectedSteps = -1.0f;
+    float reprojectedDistance = 0.0f;
+    if (sampleIndex == 0)
+        reprojectedDistance = Reproject(pixel, reprojectedSteps);
+    float startDistance = max(0.0f, max(prepassDistance, reprojectedDistance) - coneDistance);
+
+    TraceResult result = IterativeTrace(onCameraPoint, rayDirection, startDistance, reprojectedSteps, coneDistance,
+                                        deferred);
+
+    PixelSample pixelSample;
+    pixelSample.Color = result.Color;
+    pixelSample.Normal = result.Normal;
+    pixelSample.Depth = result.Hit ? coneDistance + result.Distance : 0.0f;
+    pixelSample.Steps = result.Hit ? result.NumSteps : 0.0f;
+    return pixelSample;
+}
+
+PixelSample MarchPixel(uint2 pixel, float prepassDistance)
+{
+    return MarchSample(pixel, g_sampleIndex, prepassDistance, false);
+}
+
+float3 GetSampleDirection(uint2 pixel, uint sampleIndex)
+{
+    return GetRayDirection(pixel + GetSampleOffset(sampleIndex), g_cameraMatrix);
+}
+
+uint GetMaterial(float3 position)
+{
+    return YPlane(position, -1.0f) < SpheresEstimator(position, float3(0.0f, 1.0f, 3.0f)) ? MATERIAL_PLANE
+                                                                                           : MATERIAL_SPHERES;
+}
+
+// Octahedral mapping of a unit vector to the [-1, 1] square.
+float2 EncodeOctahedral(float3 normal)
+{
+    normal /= abs(normal.x) + abs(normal.y) + abs(normal.z);
+    if (normal.z >= 0.0f)
+        return normal.xy;
+    return float2((1.0f - abs(normal.y)) * (normal.x >= 0.0f ? 1.0f : -1.0f),
+                  (1.0f - abs(normal.x)) * (normal.y >= 0.0f ? 1.0f : -1.0f));
+}
+
+float3 DecodeOctahedral(float2 octahedral)
+{
+    float3 normal = float3(octahedral, 1.0f - abs(octahedral.x) - abs(octahedral.y));
+    if (normal.z < 0.0f)
+        normal.xy = float2((1.0f - abs(octahedral.y)) * (octahedral.x >= 0.0f ? 1.0f : -1.0f),
+                           (1.0f - abs(octahedral.x)) * (octahedral.y >= 0.0f ? 1.0f : -1.0f));
+    return normalize(normal);
+}
+
+// G-buffer texel of a deferred sample; the step counts stay below MAX_STEPS, which fits in GBUFFER_STEPS_BITS.
+uint2 PackGBuffer(PixelSample pixelSample, uint material)
+{
+    uint2 normal = uint2((EncodeOctahedral(pixelSample.Normal) * 0.5f + 0.5f) * GBUFFER_NORMAL_MAX + 0.5f);
+    return uint2(asuint(pixelSample.Depth),
+                 normal.x | (normal.y << GBUFFER_NORMAL_BITS) | (uint(pixelSample.Steps) << (2 * GBUFFER_NORMAL_BITS)) |
+                 (material << (2 * GBUFFER_NORMAL_BITS + GBUFFER_STEPS_BITS)));
+}
+
+PixelSample UnpackGBuffer(uint2 texel)
+{
+    uint normalMask = (1u << GBUFFER_NORMAL_BITS) - 1;
+    float2 octahedral = float2(texel.y & normalMask, (texel.y >> GBUFFER_NORMAL_BITS) & normalMask);
+
+    PixelSample pixelSample;
+    pixelSample.Color = float3(0.0f, 0.0f, 0.0f);
+    pixelSample.Normal = DecodeOctahedral(octahedral / GBUFFER_NORMAL_MAX * 2.0f - 1.0f);
+    pixelSample.Depth = asfloat(texel.x);
+    pixelSample.Steps = float((texel.y >> (2 * GBUFFER_NORMAL_BITS)) & ((1u << GBUFFER_STEPS_BITS) - 1));
+    return pixelSample;
+}
+
+float3 ShadeHit(float3 hitPoint, float3 normal, float steps)
+{
+    float3 lightDirection = normalize(-g_lightDirection);
+    float lightIntensity = max(0.1f, dot(normal, lightDirection));
+    float3 color = (1.0f - steps / float(MAX_STEPS)) * lightIntensity;
+    return color * (0.5f + 0.5f * ShadowVisibility(hitPoint));
+}
+
+// The hit point is rebuilt from the coarse depth, within g_hitTolerance of the refined one.
+PixelSample LightPixel(uint2 pixel)
+{
+    PixelSample pixelSample = UnpackGBuffer(g_gBuffer[pixel]);
+    if (pixelSample.Depth > 0.0f)
+    {
+        float3 eye = mul(g_cameraMatrix, float4(0.0f, 0.0f, 0.0f, 1.0f)).xyz;
+        float3 hitPoint = eye + pixelSample.Depth * GetSampleDirection(pixel, g_sampleIndex);
+        pixelSample.Color = ShadeHit(hitPoint, pixelSample.Normal, pixelSample.Steps);
+    }
+    return pixelSample;
+}
+
+void StoreGeometry(uint2 pixel, PixelSample pixelSample)
+{
+    uint material = MATERIAL_NONE;
+    if (pixelSample.Depth > 0.0f)
+    {
+        float3 eye = mul(g_cameraMatrix, float4(0.0f, 0.0f, 0.0f, 1.0f)).xyz;
+        material = GetMaterial(eye + pixelSample.Depth * GetSampleDirection(pixel, g_sampleIndex));
+    }
+    g_gBuffer[pixel] = PackGBuffer(pixelSample, material);
+}
+
+void ClearEdgeHistogram(uint2 thread)
+{
+    if (g_supersampleBudget > 0.0f && thread.x == 0 && thread.y == 0)
+    {
+        for (uint bucket = 0; bucket < EDGE_BUCKETS; bucket++)
+            g_edgeHistogram[bucket] = 0;
+    }
+}
+
+void StoreColor(uint2 pixel, float4 color)
+{
+    if (g_accumulation)
+    {
+        float4 sum = color;
+        if (g_sampleIndex)
+            sum += g_accumulatedColor[pixel];
+        g_accumulatedColor[pixel] = sum;
+        color = sum / float(g_sampleIndex + 1);
+    }
+
+    g_outputTexture[pixel] = color;
+}
+
+void StoreSample(uint2 pixel, PixelSample pixelSample, bool halfResolution)
+{
+    if (halfResolution)
+    {
+        g_halfColor[pixel / 2] = float4(pixelSample.Color, pixelSample.Steps);
+        g_halfGeometry[pixel / 2] = float4(pixelSample.Normal, pixelSample.Depth);
+        return;
+    }
+
+    StoreColor(pixel, float4(pixelSample.Color, 1.0f));
+    if (g_reprojection)
+        g_depth[pixel] = float2(pixelSample.Depth, pixelSample.Steps);
+    if (g_interleave)
+        g_history[pixel] = float4(pixelSample.Color, pixelSample.Depth);
+    if (g_supersampleBudget > 0.0f)
+    {
+        g_color[pixel] = float4(pixelSample.Color, pixelSample.Steps);
+        g_geometry[pixel] = float4(pixelSample.Normal, pixelSample.Depth);
+    }
+}
+
+// Largest difference from the neighbours in units of the EDGE_ thresholds; 1 or more is an edge.
+float GetEdgeStrength(uint2 pixel)
+{
+    const int2 offsets[4] = { int2(0, -1), int2(0, 1), int2(-1, 0), int2(1, 0) };
+
+    float4 color = g_color[pixel];
+    float4 geometry = g_geometry[pixel];
+    float depth = geometry.w > 0.0f ? geometry.w : MAX_CAMERA_DEPTH;
+
+    float strength = 0.0f;
+    for (uint i = 0; i < 4; i++)
+    {
+        int2 neighbour = int2(pixel) + offsets[i];
+        if (neighbour.x < 0 || neighbour.y < 0 || neighbour.x >= int(g_windowSize.x) ||
+            neighbour.y >= int(g_windowSize.y))
+            continue;
+
+        float4 neighbourColor = g_color[neighbour];
+        float4 neighbourGeometry = g_geometry[neighbour];
+        float neighbourDepth = neighbourGeometry.w > 0.0f ? neighbourGeometry.w : MAX_CAMERA_DEPTH;
+
+        float3 colorStep = abs(neighbourColor.rgb - color.rgb);
+        strength = max(strength, max(colorStep.r, max(colorStep.g, colorStep.b)) / EDGE_COLOR_STEP);
+        strength = max(strength, abs(neighbourDepth - depth) / (EDGE_DEPTH_RATIO * min(depth, neighbourDepth)));
+        if (geometry.w > 0.0f && neighbourGeometry.w > 0.0f)
+        {
+            strength = max(strength, (1.0f - dot(neighbourGeometry.xyz, geometry.xyz)) / (1.0f - EDGE_NORMAL_DOT));
+            strength = max(strength, abs(neighbourColor.w - color.w) / EDGE_STEP_DIFFERENCE);
+        }
+    }
+
+    return strength;
+}
+
+// Histogram bucket of an edge strength: 0 for pixels that are not on an edge, then a quarter octave of strength each.
+uint GetEdgeBucket(float strength)
+{
+    if (strength < 1.0f)
+        return 0;
+    return 1 + min(uint(4.0f * log2(strength)), EDGE_BUCKETS - 2);
+}
+
+#ifndef RAY_MARCHER_LIBRARY
+
+[numthreads(BLOCK_SIZE, BLOCK_SIZE, 1)]
+void main(ComputeShaderInput IN)
+{
+    // Low resolution prepass: one thread per cell cone marches the group's empty space before the full rays start.
+    float prepassDistance = 0.0f;
+    if (g_prepass)
+    {
+        if (IN.GroupIndex < PREPASS_CELLS * PREPASS_CELLS)
+        {
+            uint2 cell = uint2(IN.GroupIndex % PREPASS_CELLS, IN.GroupIndex / PREPASS_CELLS);
+            // The cone follows the ray halfway between the pixels of the cell's first and last threads.
+            uint2 firstThread = IN.GroupId.xy * BLOCK_SIZE + cell * PREPASS_CELL_SIZE;
+            float2 centre = float2(GetThreadPixel(firstThread) + GetThreadPixel(firstThread + PREPASS_CELL_SIZE - 1)) *
+                0.5f;
+            g_prepassDistances[IN.GroupIndex] = ConeMarch(centre);
+        }
+        GroupMemoryBarrierWithGroupSync();
+
+        uint2 cell = IN.GroupThreadId.xy / PREPASS_CELL_SIZE;
+        prepassDistance = g_prepassDistances[cell.y * PREPASS_CELLS + cell.x];
+    }
+
+    if (!g_deferred)
+        ClearEdgeHistogram(IN.DispatchThreadId.xy);
+
+    // The textures are allocated for the whole window, while dynamic resolution may march only its top left corner.
+    uint2 pixel = GetThreadPixel(IN.DispatchThreadId.xy);
+    if (pixel.x >= uint(g_windowSize.x) || pixel.y >= uint(g_windowSize.y))
+        return;
+
+    if (g_deferred)
+        StoreGeometry(pixel, MarchSample(pixel, g_sampleIndex, prepassDistance, true));
+    else
+        StoreSample(pixel, MarchPixel(pixel, prepassDistance), g_halfResolution != 0);
+}
 
-    g_outputTexture[IN.DispatchThreadId.xy] = float4(result.Color, 1.0f);
-}
\ No newline at end of file
+#endif
@@ -0,0 +1,39 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+#include "CpuMath.h"
+
+// Root constants of RayMarcher.hlsl, filled by FrameState. FractalRadio uploads them as they are and CpuRayMarcher
+// reads them directly, so the layout follows the HLSL packing, where each matrix starts a new 16-byte register.
+struct RayMarcherBuffer
+{
+    Float2   WindowSize;
+    uint32_t Padding0[2];
+    Float4x4 CameraMatrix;
+    uint32_t AnalyticNormals;
+    float    OverRelaxation;
+    float    HitTolerance;
+    float    ConeScale;
+    uint32_t Prepass;
+    uint32_t Reprojection;
+    uint32_t FrameIndex;
+    uint32_t Padding1;
+    Float4x4 PreviousCameraMatrix;
+    uint32_t Accumulation;
+    uint32_t SampleIndex;
+    uint32_t HalfResolution;
+    uint32_t Interleave;
+    float    SupersampleBudget;
+    Float3   LightDirection;
+    uint32_t Deferred;
+    float    ShadowSoftness;
+    float    ShadowCacheCellSize;
+    uint32_t ShadowCacheCells;
+    Float3   ShadowCacheOrigin;
+};
+
+static_assert(offsetof(RayMarcherBuffer, CameraMatrix) % 16 == 0 &&
+              offsetof(RayMarcherBuffer, PreviousCameraMatrix) % 16 == 0,
+              "The matrices of RayMarcherBuffer must start HLSL registers");
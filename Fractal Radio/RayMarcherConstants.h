@@ -0,0 +1,79 @@
+#pragma once
+
+#include <cstdint>
+
+#include "CpuMath.h"
+
+// Constants of RayMarcher.hlsl. The shader cannot include this header, so the static_asserts below pin each value to
+// its #define there; change both together.
+constexpr uint32_t BLOCK_SIZE            = 8;
+constexpr int      MAX_STEPS             = 64;
+constexpr float    MINIMUM_DISTANCE      = 0.01f;
+constexpr float    NORMAL_THRESHOLD      = 0.1f;
+constexpr int      SIERPINSKI_ITERATIONS = 10;
+constexpr float    MAX_CAMERA_DEPTH      = 100.0f;
+constexpr float    GLOW_FACTOR           = 0.5f;
+constexpr int      MAX_RAYS_DEPTH        = 1;
+constexpr int      MAX_REFINEMENT_STEPS  = 16;
+constexpr float    CAMERA_PLANE_DISTANCE = 5.0f;
+constexpr float    REFLECTION_SPREAD     = 2.0f;
+constexpr uint32_t PREPASS_CELL_SIZE     = 4;
+constexpr uint32_t PREPASS_CELLS         = BLOCK_SIZE / PREPASS_CELL_SIZE;
+constexpr uint32_t REPROJECTION_RECORD   = 1;
+constexpr uint32_t REPROJECTION_REUSE    = 2;
+constexpr int      REPROJECTION_PASSES   = 2;
+constexpr uint32_t REPROJECTION_REFRESH  = 4;
+constexpr float    REPROJECTION_MARGIN   = 0.05f;
+constexpr float    REPROJECTION_SLACK    = 2.0f;
+constexpr float    UPSAMPLE_DEPTH_RATIO  = 0.05f;
+constexpr float    UPSAMPLE_NORMAL_DOT   = 0.95f;
+constexpr float    UPSAMPLE_COLOR_STEP   = 0.1f;
+constexpr uint32_t INTERLEAVE_RECORD     = 1;
+constexpr uint32_t INTERLEAVE_CHECKER    = 2;
+constexpr uint32_t INTERLEAVE_ROWS       = 3;
+constexpr uint32_t SUPERSAMPLES          = 4;
+constexpr float    EDGE_DEPTH_RATIO      = 0.05f;
+constexpr float    EDGE_NORMAL_DOT       = 0.95f;
+constexpr float    EDGE_STEP_DIFFERENCE  = 4.0f;
+constexpr float    EDGE_COLOR_STEP       = 0.1f;
+constexpr uint32_t EDGE_BUCKETS          = 32;
+constexpr uint32_t DEFERRED_MARCH        = 1;
+constexpr uint32_t DEFERRED_RELIGHT      = 2;
+constexpr uint32_t GBUFFER_NORMAL_BITS   = 12;
+constexpr uint32_t GBUFFER_STEPS_BITS    = 6;
+constexpr float    GBUFFER_NORMAL_MAX    = static_cast<float>((1 << GBUFFER_NORMAL_BITS) - 1);
+constexpr uint32_t MATERIAL_NONE         = 0;
+constexpr uint32_t MATERIAL_SPHERES      = 1;
+constexpr uint32_t MATERIAL_PLANE        = 2;
+constexpr float    SHADOW_OPAQUE         = 0.01f;
+constexpr uint32_t SHADOW_CACHE_LAYERS   = 32;
+
+static_assert(BLOCK_SIZE == 8 && MAX_STEPS == 64 && MINIMUM_DISTANCE == 0.01f && NORMAL_THRESHOLD == 0.1f &&
+              SIERPINSKI_ITERATIONS == 10 && MAX_CAMERA_DEPTH == 100.0f && GLOW_FACTOR == 0.5f,
+              "The marching constants differ from RayMarcher.hlsl");
+static_assert(MAX_RAYS_DEPTH == 1 && MAX_REFINEMENT_STEPS == 16 && CAMERA_PLANE_DISTANCE == 5.0f &&
+              REFLECTION_SPREAD == 2.0f && PREPASS_CELL_SIZE == 4,
+              "The ray constants differ from RayMarcher.hlsl");
+static_assert(REPROJECTION_RECORD == 1 && REPROJECTION_REUSE == 2 && REPROJECTION_PASSES == 2 &&
+              REPROJECTION_REFRESH == 4 && REPROJECTION_MARGIN == 0.05f && REPROJECTION_SLACK == 2.0f,
+              "The reprojection constants differ from RayMarcher.hlsl");
+static_assert(UPSAMPLE_DEPTH_RATIO == 0.05f && UPSAMPLE_NORMAL_DOT == 0.95f && UPSAMPLE_COLOR_STEP == 0.1f &&
+              INTERLEAVE_RECORD == 1 && INTERLEAVE_CHECKER == 2 && INTERLEAVE_ROWS == 3 && SUPERSAMPLES == 4,
+              "The reconstruction constants differ from RayMarcher.hlsl");
+static_assert(EDGE_DEPTH_RATIO == 0.05f && EDGE_NORMAL_DOT == 0.95f && EDGE_STEP_DIFFERENCE == 4.0f &&
+              EDGE_COLOR_STEP == 0.1f && EDGE_BUCKETS == 32,
+              "The edge constants differ from RayMarcher.hlsl");
+static_assert(DEFERRED_MARCH == 1 && DEFERRED_RELIGHT == 2 && GBUFFER_NORMAL_BITS == 12 && GBUFFER_STEPS_BITS == 6 &&
+              MATERIAL_NONE == 0 && MATERIAL_SPHERES == 1 && MATERIAL_PLANE == 2,
+              "The G-buffer constants differ from RayMarcher.hlsl");
+static_assert(SHADOW_OPAQUE == 0.01f && SHADOW_CACHE_LAYERS == 32, "The shadow constants differ from RayMarcher.hlsl");
+static_assert(MAX_STEPS <= 1 << GBUFFER_STEPS_BITS, "The G-buffer step counts do not fit in GBUFFER_STEPS_BITS");
+
+// Initial RayMarcherBuffer::LightDirection.
+constexpr Float3   LIGHT_DIRECTION       = { -0.5f, -0.5f, 0.5f };
+
+// Height of the bottom layer of the shadow cache, below the floor at -1.
+constexpr float    SHADOW_CACHE_BOTTOM   = -1.5f;
+
+// Number of jittered samples a still view accumulates before its frames are skipped.
+constexpr uint32_t MAX_ACCUMULATED_SAMPLES = 64;
@@ -0,0 +1,72 @@
+// Fills in the pixels an interleaved frame left out from the previous one, clamped to their neighbours.
+#define RAY_MARCHER_LIBRARY
+#include "RayMarcher.hlsl"
+
+[numthreads(BLOCK_SIZE, BLOCK_SIZE, 1)]
+void main(ComputeShaderInput IN)
+{
+    uint2 pixel = IN.DispatchThreadId.xy;
+    if (pixel.x >= uint(g_windowSize.x) || pixel.y >= uint(g_windowSize.y) || IsMarchedPixel(pixel))
+        return;
+
+    // The neighbours marched this frame: above and below, and in the checkerboard also left and right.
+    const int2 offsets[4] = { int2(0, -1), int2(0, 1), int2(-1, 0), int2(1, 0) };
+    uint numOffsets = g_interleave == INTERLEAVE_CHECKER ? 4 : 2;
+
+    float3 minColor = float3(0.0f, 0.0f, 0.0f);
+    float3 maxColor = float3(0.0f, 0.0f, 0.0f);
+    float3 meanColor = float3(0.0f, 0.0f, 0.0f);
+    uint count = 0;
+    float depth = 0.0f;
+    uint2 nearest = pixel;
+    for (uint i = 0; i < numOffsets; i++)
+    {
+        int2 neighbour = int2(pixel) + offsets[i];
+        if (neighbour.x < 0 || neighbour.y < 0 || neighbour.x >= int(g_windowSize.x) ||
+            neighbour.y >= int(g_windowSize.y))
+            continue;
+
+        float4 history = g_history[neighbour];
+        minColor = count ? min(minColor, history.rgb) : history.rgb;
+        maxColor = count ? max(maxColor, history.rgb) : history.rgb;
+        meanColor += history.rgb;
+        count++;
+        if (history.w > 0.0f && (depth <= 0.0f || history.w < depth))
+        {
+            depth = history.w;
+            nearest = uint2(neighbour);
+        }
+    }
+
+    // A window a single row high leaves the rows mode without neighbours.
+    if (!count)
+    {
+        StoreSample(pixel, MarchPixel(pixel, 0.0f), false);
+        return;
+    }
+
+    PixelSample pixelSample;
+    pixelSample.Color = meanColor / float(count);
+    pixelSample.Normal = float3(0.0f, 0.0f, 0.0f);
+    pixelSample.Depth = depth;
+    pixelSample.Steps = depth > 0.0f && g_reprojection ? g_depth[nearest].y : 0.0f;
+
+    float3 eye = mul(g_cameraMatrix, float4(0.0f, 0.0f, 0.0f, 1.0f)).xyz;
+    float2 previousPixel;
+    if (depth > 0.0f && ProjectToPreviousFrame(eye + depth * GetRayDirection(pixel, g_cameraMatrix), previousPixel))
+    {
+        // Bilinear filtering over the 2 x 2 footprint, written out so that the CPU port can match it exactly.
+        uint2 footprint = uint2(previousPixel);
+        float2 weights = previousPixel - float2(footprint);
+        float3 previous = float3(0.0f, 0.0f, 0.0f);
+        for (uint corner = 0; corner < 4; corner++)
+        {
+            uint2 offset = uint2(corner % 2, corner / 2);
+            float weight = (offset.x ? weights.x : 1.0f - weights.x) * (offset.y ? weights.y : 1.0f - weights.y);
+            previous += weight * g_previousHistory[footprint + offset].rgb;
+        }
+        pixelSample.Color = clamp(previous, minColor, maxColor);
+    }
+
+    StoreSample(pixel, pixelSample, false);
+}
@@ -0,0 +1,25 @@
+#include "pch.h"
+
+#include "ShadowCacheBuilder.h"
+
+#include "CpuRayMarcher.h"
+
+using namespace std;
+
+ShadowCacheBuilder::ShadowCacheBuilder() :
+    m_taskScheduler(make_shared<TaskScheduler>())
+{
+}
+
+// Marches the shadow cache of rayMarcherData. The texels are laid out for the upload of an R8_UNORM Texture3D.
+const CpuShadowCacheTexture& ShadowCacheBuilder::Build(const RayMarcherBuffer& rayMarcherData)
+{
+    const uint32_t cells = rayMarcherData.ShadowCacheCells;
+    m_texture.Resize(cells, SHADOW_CACHE_LAYERS, cells);
+    m_taskScheduler->ParallelFor(cells, [&](const uint32_t z, uint32_t)
+    {
+        CpuRayMarcher::Statistics statistics{};
+        CpuRayMarcher::BuildShadowCacheSlice(z, rayMarcherData, m_texture, statistics);
+    });
+    return m_texture;
+}
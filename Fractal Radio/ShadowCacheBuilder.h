@@ -0,0 +1,23 @@
+#pragma once
+
+#include <memory>
+
+#include "CpuShadowCacheTexture.h"
+#include "RayMarcherBuffer.h"
+#include "TaskScheduler.h"
+
+// CPU builder of the shadow cache that FractalRadio uploads to g_shadowCache, marched by the same
+// CpuRayMarcher::BuildShadowCacheSlice as the headless backend.
+class ShadowCacheBuilder
+{
+public:
+
+    ShadowCacheBuilder();
+
+    const CpuShadowCacheTexture& Build(const RayMarcherBuffer&);
+
+private:
+
+    std::shared_ptr<TaskScheduler> m_taskScheduler;
+    CpuShadowCacheTexture          m_texture;
+};
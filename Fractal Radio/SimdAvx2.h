@@ -0,0 +1,52 @@
+#pragma once
+
+#include <cstdint>
+#include <immintrin.h>
+
+// 8-wide AVX2 packet types for CpuPacketMarcher.
+
+struct Avx2Float
+{
+    __m256 V;
+};
+
+struct Avx2Mask
+{
+    __m256 V;
+};
+
+inline Avx2Float operator+(const Avx2Float a, const Avx2Float b) { return { _mm256_add_ps(a.V, b.V) }; }
+inline Avx2Float operator-(const Avx2Float a, const Avx2Float b) { return { _mm256_sub_ps(a.V, b.V) }; }
+inline Avx2Float operator*(const Avx2Float a, const Avx2Float b) { return { _mm256_mul_ps(a.V, b.V) }; }
+inline Avx2Float operator/(const Avx2Float a, const Avx2Float b) { return { _mm256_div_ps(a.V, b.V) }; }
+inline Avx2Float operator-(const Avx2Float a)                    { return { _mm256_xor_ps(a.V, _mm256_set1_ps(-0.0f)) }; }
+
+inline Avx2Mask  operator<(const Avx2Float a, const Avx2Float b) { return { _mm256_cmp_ps(a.V, b.V, _CMP_LT_OQ) }; }
+inline Avx2Mask  operator>(const Avx2Float a, const Avx2Float b) { return { _mm256_cmp_ps(a.V, b.V, _CMP_GT_OQ) }; }
+
+inline Avx2Mask  operator&(const Avx2Mask a, const Avx2Mask b)   { return { _mm256_and_ps(a.V, b.V) }; }
+inline Avx2Mask  operator|(const Avx2Mask a, const Avx2Mask b)   { return { _mm256_or_ps(a.V, b.V) }; }
+
+struct Avx2
+{
+    using Float = Avx2Float;
+    using Mask  = Avx2Mask;
+
+    enum { WIDTH = 8 };
+
+    static const char* Name()                                     { return "avx2"; }
+
+    static Float       Set1(const float value)                    { return { _mm256_set1_ps(value) }; }
+    static Float       Load(const float* values)                  { return { _mm256_loadu_ps(values) }; }
+    static void        Store(float* values, const Float a)        { _mm256_storeu_ps(values, a.V); }
+
+    static Float       Min(const Float a, const Float b)          { return { _mm256_min_ps(a.V, b.V) }; }
+    static Float       Max(const Float a, const Float b)          { return { _mm256_max_ps(a.V, b.V) }; }
+    static Float       Sqrt(const Float a)                        { return { _mm256_sqrt_ps(a.V) }; }
+    static Float       Trunc(const Float a)                       { return { _mm256_round_ps(a.V, _MM_FROUND_TO_ZERO | _MM_FROUND_NO_EXC) }; }
+    static Float       Select(const Mask m, const Float a, const Float b) { return { _mm256_blendv_ps(b.V, a.V, m.V) }; }
+
+    static Mask        None()                                     { return { _mm256_setzero_ps() }; }
+    static Mask        AndNot(const Mask a, const Mask b)         { return { _mm256_andnot_ps(b.V, a.V) }; }
+    static uint32_t    Bits(const Mask m)                         { return static_cast<uint32_t>(_mm256_movemask_ps(m.V)); }
+};
@@ -0,0 +1,52 @@
+#pragma once
+
+#include <cstdint>
+#include <immintrin.h>
+
+// 16-wide AVX-512 packet types for CpuPacketMarcher. Masks live in the k registers.
+
+struct Avx512Float
+{
+    __m512 V;
+};
+
+struct Avx512Mask
+{
+    __mmask16 V;
+};
+
+inline Avx512Float operator+(const Avx512Float a, const Avx512Float b) { return { _mm512_add_ps(a.V, b.V) }; }
+inline Avx512Float operator-(const Avx512Float a, const Avx512Float b) { return { _mm512_sub_ps(a.V, b.V) }; }
+inline Avx512Float operator*(const Avx512Float a, const Avx512Float b) { return { _mm512_mul_ps(a.V, b.V) }; }
+inline Avx512Float operator/(const Avx512Float a, const Avx512Float b) { return { _mm512_div_ps(a.V, b.V) }; }
+inline Avx512Float operator-(const Avx512Float a)                      { return { _mm512_sub_ps(_mm512_setzero_ps(), a.V) }; }
+
+inline Avx512Mask  operator<(const Avx512Float a, const Avx512Float b) { return { _mm512_cmp_ps_mask(a.V, b.V, _CMP_LT_OQ) }; }
+inline Avx512Mask  operator>(const Avx512Float a, const Avx512Float b) { return { _mm512_cmp_ps_mask(a.V, b.V, _CMP_GT_OQ) }; }
+
+inline Avx512Mask  operator&(const Avx512Mask a, const Avx512Mask b)   { return { static_cast<__mmask16>(a.V & b.V) }; }
+inline Avx512Mask  operator|(const Avx512Mask a, const Avx512Mask b)   { return { static_cast<__mmask16>(a.V | b.V) }; }
+
+struct Avx512
+{
+    using Float = Avx512Float;
+    using Mask  = Avx512Mask;
+
+    enum { WIDTH = 16 };
+
+    static const char* Name()                                     { return "avx512"; }
+
+    static Float       Set1(const float value)                    { return { _mm512_set1_ps(value) }; }
+    static Float       Load(const float* values)                  { return { _mm512_loadu_ps(values) }; }
+    static void        Store(float* values, const Float a)        { _mm512_storeu_ps(values, a.V); }
+
+    static Float       Min(const Float a, const Float b)          { return { _mm512_min_ps(a.V, b.V) }; }
+    static Float       Max(const Float a, const Float b)          { return { _mm512_max_ps(a.V, b.V) }; }
+    static Float       Sqrt(const Float a)                        { return { _mm512_sqrt_ps(a.V) }; }
+    static Float       Trunc(const Float a)                       { return { _mm512_roundscale_ps(a.V, _MM_FROUND_TO_ZERO | _MM_FROUND_NO_EXC) }; }
+    static Float       Select(const Mask m, const Float a, const Float b) { return { _mm512_mask_blend_ps(m.V, b.V, a.V) }; }
+
+    static Mask        None()                                     { return { 0 }; }
+    static Mask        AndNot(const Mask a, const Mask b)         { return { static_cast<__mmask16>(a.V & ~b.V) }; }
+    static uint32_t    Bits(const Mask m)                         { return m.V; }
+};
@@ -0,0 +1,52 @@
+#pragma once
+
+#include <cstdint>
+#include <immintrin.h>
+
+// 4-wide SSE4.1 packet types for CpuPacketMarcher.
+
+struct Sse41Float
+{
+    __m128 V;
+};
+
+struct Sse41Mask
+{
+    __m128 V;
+};
+
+inline Sse41Float operator+(const Sse41Float a, const Sse41Float b) { return { _mm_add_ps(a.V, b.V) }; }
+inline Sse41Float operator-(const Sse41Float a, const Sse41Float b) { return { _mm_sub_ps(a.V, b.V) }; }
+inline Sse41Float operator*(const Sse41Float a, const Sse41Float b) { return { _mm_mul_ps(a.V, b.V) }; }
+inline Sse41Float operator/(const Sse41Float a, const Sse41Float b) { return { _mm_div_ps(a.V, b.V) }; }
+inline Sse41Float operator-(const Sse41Float a)                     { return { _mm_xor_ps(a.V, _mm_set1_ps(-0.0f)) }; }
+
+inline Sse41Mask  operator<(const Sse41Float a, const Sse41Float b) { return { _mm_cmplt_ps(a.V, b.V) }; }
+inline Sse41Mask  operator>(const Sse41Float a, const Sse41Float b) { return { _mm_cmpgt_ps(a.V, b.V) }; }
+
+inline Sse41Mask  operator&(const Sse41Mask a, const Sse41Mask b)   { return { _mm_and_ps(a.V, b.V) }; }
+inline Sse41Mask  operator|(const Sse41Mask a, const Sse41Mask b)   { return { _mm_or_ps(a.V, b.V) }; }
+
+struct Sse41
+{
+    using Float = Sse41Float;
+    using Mask  = Sse41Mask;
+
+    enum { WIDTH = 4 };
+
+    static const char* Name()                                     { return "sse4.1"; }
+
+    static Float       Set1(const float value)                    { return { _mm_set1_ps(value) }; }
+    static Float       Load(const float* values)                  { return { _mm_loadu_ps(values) }; }
+    static void        Store(float* values, const Float a)        { _mm_storeu_ps(values, a.V); }
+
+    static Float       Min(const Float a, const Float b)          { return { _mm_min_ps(a.V, b.V) }; }
+    static Float       Max(const Float a, const Float b)          { return { _mm_max_ps(a.V, b.V) }; }
+    static Float       Sqrt(const Float a)                        { return { _mm_sqrt_ps(a.V) }; }
+    static Float       Trunc(const Float a)                       { return { _mm_round_ps(a.V, _MM_FROUND_TO_ZERO | _MM_FROUND_NO_EXC) }; }
+    static Float       Select(const Mask m, const Float a, const Float b) { return { _mm_blendv_ps(b.V, a.V, m.V) }; }
+
+    static Mask        None()                                     { return { _mm_setzero_ps() }; }
+    static Mask        AndNot(const Mask a, const Mask b)         { return { _mm_andnot_ps(b.V, a.V) }; }
+    static uint32_t    Bits(const Mask m)                         { return static_cast<uint32_t>(_mm_movemask_ps(m.V)); }
+};
@@ -0,0 +1,32 @@
+// Adds SUPERSAMPLES - 1 jittered rays to the strongest edges that fit in g_supersampleBudget.
+#define RAY_MARCHER_LIBRARY
+#include "RayMarcher.hlsl"
+
+// Lowest edge bucket whose pixels fit in the budget along with all the stronger ones.
+uint GetSupersampledBucket()
+{
+    uint budget = uint(g_supersampleBudget / float(SUPERSAMPLES - 1) * g_windowSize.x * g_windowSize.y);
+    uint pixels = 0;
+    uint bucket = EDGE_BUCKETS;
+    while (bucket > 0 && pixels + g_edgeHistogram[bucket - 1] <= budget)
+    {
+        bucket--;
+        pixels += g_edgeHistogram[bucket];
+    }
+    return bucket;
+}
+
+[numthreads(BLOCK_SIZE, BLOCK_SIZE, 1)]
+void main(ComputeShaderInput IN)
+{
+    uint2 pixel = IN.DispatchThreadId.xy;
+    if (pixel.x >= uint(g_windowSize.x) || pixel.y >= uint(g_windowSize.y) ||
+        GetEdgeBucket(GetEdgeStrength(pixel)) < GetSupersampledBucket())
+        return;
+
+    float3 color = g_color[pixel].rgb;
+    for (uint sampleIndex = 1; sampleIndex < SUPERSAMPLES; sampleIndex++)
+        color += MarchSample(pixel, sampleIndex, 0.0f, false).Color;
+
+    StoreColor(pixel, float4(color / float(SUPERSAMPLES), 1.0f));
+}
@@ -0,0 +1,164 @@
+#include "pch.h"
+
+#include "TaskScheduler.h"
+
+using namespace std;
+
+TaskScheduler::TaskScheduler(const uint32_t numThreads) :
+    m_numThreads(numThreads ? numThreads : max(1u, thread::hardware_concurrency())),
+    m_generation(0),
+    m_activeWorkers(0),
+    m_stopping(false),
+    m_task(nullptr),
+    m_stolenTasks(0)
+{
+    m_ranges = make_unique<WorkerRange[]>(m_numThreads);
+
+    // The calling thread acts as worker 0.
+    for (uint32_t i = 1; i < m_numThreads; i++)
+        m_threads.emplace_back(&TaskScheduler::WorkerLoop, this, i);
+}
+
+TaskScheduler::~TaskScheduler()
+{
+    {
+        lock_guard<mutex> lock(m_mutex);
+        m_stopping = true;
+    }
+    m_startCondition.notify_all();
+
+    for (auto& thread : m_threads)
+        thread.join();
+}
+
+// Calls task(index, workerIndex) for every index in [0, count) and returns once all of them have finished.
+void TaskScheduler::ParallelFor(const uint32_t count, const Task& task)
+{
+    if (!count)
+        return;
+
+    // The workers are asleep between the calls, and the lock below publishes the ranges to them.
+    for (uint32_t i = 0; i < m_numThreads; i++)
+        m_ranges[i].Range.store(PackRange(static_cast<uint32_t>(static_cast<uint64_t>(count) * i / m_numThreads),
+                                          static_cast<uint32_t>(static_cast<uint64_t>(count) * (i + 1) / m_numThreads)),
+                                memory_order_relaxed);
+
+    m_task = &task;
+
+    {
+        lock_guard<mutex> lock(m_mutex);
+        m_activeWorkers = m_numThreads - 1;
+        m_generation++;
+    }
+    m_startCondition.notify_all();
+
+    RunTasks(0);
+
+    unique_lock<mutex> lock(m_mutex);
+    m_doneCondition.wait(lock, [this] { return m_activeWorkers == 0; });
+
+    m_task = nullptr;
+}
+
+uint32_t TaskScheduler::GetNumThreads() const
+{
+    return m_numThreads;
+}
+
+uint64_t TaskScheduler::GetStolenTasks() const
+{
+    return m_stolenTasks;
+}
+
+void TaskScheduler::WorkerLoop(const uint32_t workerIndex)
+{
+    uint64_t lastGeneration = 0;
+
+    while (true)
+    {
+        {
+            unique_lock<mutex> lock(m_mutex);
+            m_startCondition.wait(lock, [&] { return m_stopping || m_generation != lastGeneration; });
+
+            if (m_stopping)
+                return;
+
+            lastGeneration = m_generation;
+        }
+
+        RunTasks(workerIndex);
+
+        {
+            lock_guard<mutex> lock(m_mutex);
+            m_activeWorkers--;
+        }
+        m_doneCondition.notify_one();
+    }
+}
+
+// Runs the worker's own tasks, then those it steals, until no range has any left. The tasks still running elsewhere
+// are the other workers' to finish, and ParallelFor waits for all of them on m_doneCondition.
+void TaskScheduler::RunTasks(const uint32_t workerIndex)
+{
+    const Task& task = *m_task;
+    do
+    {
+        uint32_t taskIndex;
+        while (PopTask(workerIndex, taskIndex))
+            task(taskIndex, workerIndex);
+    }
+    while (StealTasks(workerIndex));
+}
+
+uint64_t TaskScheduler::PackRange(const uint32_t begin, const uint32_t end)
+{
+    return static_cast<uint64_t>(end) << 32 | begin;
+}
+
+bool TaskScheduler::PopTask(const uint32_t workerIndex, uint32_t& taskIndex)
+{
+    auto& range = m_ranges[workerIndex].Range;
+    uint64_t packed = range.load(memory_order_relaxed);
+    while (true)
+    {
+        const auto begin = static_cast<uint32_t>(packed);
+        const auto end = static_cast<uint32_t>(packed >> 32);
+        if (begin == end)
+            return false;
+
+        if (range.compare_exchange_weak(packed, PackRange(begin + 1, end), memory_order_relaxed))
+        {
+            taskIndex = begin;
+            return true;
+        }
+    }
+}
+
+bool TaskScheduler::StealTasks(const uint32_t workerIndex)
+{
+    for (uint32_t offset = 1; offset < m_numThreads; offset++)
+    {
+        auto& victim = m_ranges[(workerIndex + offset) % m_numThreads].Range;
+        uint64_t packed = victim.load(memory_order_relaxed);
+        uint32_t begin;
+        uint32_t end;
+        do
+        {
+            const auto victimBegin = static_cast<uint32_t>(packed);
+            end = static_cast<uint32_t>(packed >> 32);
+            begin = end - (end - victimBegin + 1) / 2;
+        }
+        while (begin != end && !victim.compare_exchange_weak(packed, PackRange(static_cast<uint32_t>(packed), begin),
+                                                             memory_order_relaxed));
+        if (begin == end)
+            continue;
+
+        m_stolenTasks.fetch_add(end - begin, memory_order_relaxed);
+
+        // The worker's own range is empty, and nobody steals from an empty range.
+        m_ranges[workerIndex].Range.store(PackRange(begin, end), memory_order_relaxed);
+        return true;
+    }
+
+    return false;
+}
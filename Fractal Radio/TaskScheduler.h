@@ -0,0 +1,61 @@
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// Work-stealing thread pool used by the CPU backend to spread tiles over all cores.
+// Each worker owns a contiguous range of task indices and consumes it from the front; a worker that runs dry steals
+// the back half of another worker's remaining range, so uneven tiles do not leave cores idle at the end of a frame.
+// A range is a single atomic word, begin in the low half and end in the high half, that the owner and the thieves
+// update with compare-and-swap. Tasks only move between ranges, so a worker that finds every range empty has nothing
+// left to do in this ParallelFor and goes back to sleep until the next one.
+class TaskScheduler  // NOLINT(cppcoreguidelines-special-member-functions)
+{
+    struct WorkerRange
+    {
+        std::atomic<uint64_t> Range{};
+        char                  Padding[64]{};
+    };
+
+public:
+
+    using Task = std::function<void(uint32_t, uint32_t)>;
+
+    explicit TaskScheduler(uint32_t = 0);
+    ~TaskScheduler();
+
+    void     ParallelFor(uint32_t, const Task&);
+
+    uint32_t GetNumThreads()  const;
+    uint64_t GetStolenTasks() const;
+
+private:
+
+    void            WorkerLoop(uint32_t);
+    void            RunTasks(uint32_t);
+
+    bool            PopTask(uint32_t, uint32_t&);
+    bool            StealTasks(uint32_t);
+
+    static uint64_t PackRange(uint32_t, uint32_t);
+
+    uint32_t                                       m_numThreads;
+    std::vector<std::thread>                       m_threads;
+    std::unique_ptr<WorkerRange[]>                 m_ranges;
+
+    std::mutex                                     m_mutex;
+    std::condition_variable                        m_startCondition;
+    std::condition_variable                        m_doneCondition;
+    uint64_t                                       m_generation;
+    uint32_t                                       m_activeWorkers;
+    bool                                           m_stopping;
+
+    const Task*                                    m_task;
+    std::atomic<uint64_t>                          m_stolenTasks;
+};
@@ -0,0 +1,89 @@
+// Joint bilateral upsampling of the half resolution G-buffer; pixels across edges are marched instead.
+#define RAY_MARCHER_LIBRARY
+#include "RayMarcher.hlsl"
+
+[numthreads(BLOCK_SIZE, BLOCK_SIZE, 1)]
+void main(ComputeShaderInput IN)
+{
+    uint2 pixel = IN.DispatchThreadId.xy;
+    if (pixel.x >= uint(g_windowSize.x) || pixel.y >= uint(g_windowSize.y))
+        return;
+
+    // The marched pixels around this one, at half resolution coordinates.
+    uint2 halfSize = (uint2(g_windowSize) + 1) / 2;
+    uint2 first = pixel / 2;
+    uint2 last = min((pixel + 1) / 2, halfSize - 1);
+    float2 lastWeights = float2(first.x == last.x ? 0.0f : 0.5f, first.y == last.y ? 0.0f : 0.5f);
+
+    float weights[4];
+    float4 colors[4];
+    float4 geometries[4];
+    uint hits = 0;
+    uint count = 0;
+    float depthReference = 0.0f;
+    float weightSum = 0.0f;
+    for (uint corner = 0; corner < 4; corner++)
+    {
+        float weight = ((corner & 1) ? lastWeights.x : 1.0f - lastWeights.x) *
+            ((corner & 2) ? lastWeights.y : 1.0f - lastWeights.y);
+        if (weight <= 0.0f)
+            continue;
+
+        uint2 halfPixel = uint2((corner & 1) ? last.x : first.x, (corner & 2) ? last.y : first.y);
+        weights[count] = weight;
+        colors[count] = g_halfColor[halfPixel];
+        geometries[count] = g_halfGeometry[halfPixel];
+        if (geometries[count].w > 0.0f)
+            hits++;
+        depthReference += weight * geometries[count].w;
+        weightSum += weight;
+        count++;
+    }
+    depthReference /= weightSum;
+
+    bool remarch = hits != 0 && hits != count;
+    if (hits == count)
+    {
+        float minDepth = geometries[0].w;
+        float maxDepth = geometries[0].w;
+        for (uint i = 1; i < count; i++)
+        {
+            minDepth = min(minDepth, geometries[i].w);
+            maxDepth = max(maxDepth, geometries[i].w);
+            if (dot(geometries[i].xyz, geometries[0].xyz) < UPSAMPLE_NORMAL_DOT ||
+                abs(colors[i].x - colors[0].x) > UPSAMPLE_COLOR_STEP)
+                remarch = true;
+        }
+        if (maxDepth > minDepth * (1.0f + UPSAMPLE_DEPTH_RATIO))
+            remarch = true;
+    }
+
+    if (remarch)
+    {
+        StoreSample(pixel, MarchPixel(pixel, 0.0f), false);
+        return;
+    }
+
+    // The range weight falls with the distance of each depth from the bilinear one; misses keep the bilinear weights.
+    float4 color = float4(0.0f, 0.0f, 0.0f, 0.0f);
+    float4 geometry = float4(0.0f, 0.0f, 0.0f, 0.0f);
+    float rangeWeightSum = 0.0f;
+    for (uint j = 0; j < count; j++)
+    {
+        float weight = weights[j];
+        if (hits)
+            weight /= 1.0f + abs(geometries[j].w - depthReference) / (UPSAMPLE_DEPTH_RATIO * depthReference);
+        color += weight * colors[j];
+        geometry += weight * geometries[j];
+        rangeWeightSum += weight;
+    }
+    color /= rangeWeightSum;
+    geometry /= rangeWeightSum;
+
+    PixelSample pixelSample;
+    pixelSample.Color = color.xyz;
+    pixelSample.Normal = geometry.xyz;
+    pixelSample.Depth = geometry.w;
+    pixelSample.Steps = color.w;
+    StoreSample(pixel, pixelSample, false);
+}
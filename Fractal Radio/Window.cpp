@@ -246,7 +246,7 @@ LRESULT CALLBACK WndProc(HWND hWnd, const UINT message, const WPARAM wParam, con
                     instance->m_demo->GetGraphics()->ToggleVSync();
                     break;
                 case VK_ESCAPE:
-                    instance->m_demo->GetGraphics()->GetCommandQueue()->Flush();
+                    instance->m_demo->GetGraphics()->Flush();
                     PostQuitMessage(0);
                     break;
                 case VK_RETURN:
@@ -257,6 +257,7 @@ LRESULT CALLBACK WndProc(HWND hWnd, const UINT message, const WPARAM wParam, con
                     }
                     break;
                 default:
+                    instance->m_demo->KeyPressed(static_cast<uint32_t>(wParam));
                     break;
                 }
             }
@@ -303,7 +304,7 @@ LRESULT CALLBACK WndProc(HWND hWnd, const UINT message, const WPARAM wParam, con
             }
             break;
         case WM_DESTROY:
-            instance->m_demo->GetGraphics()->GetCommandQueue()->Flush();
+            instance->m_demo->GetGraphics()->Flush();
             PostQuitMessage(0);
             break;
         default:
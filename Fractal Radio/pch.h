@@ -5,6 +5,7 @@
 
 #pragma once
 
+#if defined(_WIN32)
 #include <winsdkver.h>
 #define _WIN32_WINNT 0x0A00
 #include <sdkddkver.h>
@@ -38,6 +39,7 @@
 #include <DirectXColors.h>
 
 #include "d3dx12.h"
+#endif
 
 #include <algorithm>
 #include <cmath>
@@ -46,11 +48,12 @@
 #include <memory>
 #include <stdexcept>
 
-#ifdef _DEBUG
+#if defined(_WIN32) && defined(_DEBUG)
 #include <dxgidebug.h>
 #include "pix3.h"
 #endif
 
+#if defined(_WIN32)
 namespace DX
 {
     inline void ThrowIfFailed(HRESULT hr)
@@ -62,3 +65,4 @@ namespace DX
         }
     }
 }
+#endif